@@ -3,6 +3,7 @@
 --
 --	PROGRAM:			TCP Client
 --						gcc -Wall -ggdb -o clnt tcp_clnt.c -lpthread
+--						./clnt [-f profile] [-p key=value] HOST [PORT] [NAME]
 --
 --	FUNCTIONS:			Berkeley Socket API
 --
@@ -19,76 +20,480 @@
 --                      * Monitors number of connections made
 --                      * Gets total bytes of data sent
 --						* Forks and executes child processes to connect to server
+--						October 2026
+--						* Children log to a shared result log, written out as
+--						  the CSV file on exit
+--						* One process runs every session on an epoll loop
+--						  instead of forking a tcp_clnt per session, and the
+--						  sessions follow a seeded workload profile given
+--						  with -f and -p, see workload.c
 --
 --
 --	PROGRAMMERS:		Jivanjot Brar & Shan Bains
 --
 --	NOTES:
---	The program will establish a TCP connection to a user specifed server.
+--	The program will establish TCP connections to a user specifed server.
 -- 	The server can be specified using a fully qualified domain name or and
---	IP address. After the connection has been established the user will be
--- 	prompted for date. The date string is then sent to the server and the
--- 	response (echo) back from the server is displayed.
+--	IP address, or a Unix socket name as in unix_sock.c. Sessions arrive
+--	as the profile's arrival curve says, each connects, sends "request N"
+--	at the profile's rate, NUL padded to the profile's payload, reads
+--	every reply before the next request, as tcp_clnt does, and sends
+--	"quit" when it is done. A session paced by the rate sends its length
+--	times the rate in requests, so the count does not depend on how fast
+--	the server answers; an unpaced one sends until its length is up. A
+--	"busy" reply of a server shedding load is counted.
+--	Every session's results go to the result log, written out as
+--	NAME.csv when the arrivals end and the last session is done, or on
+--	CTRL-c, which ends the open sessions first. The profile is printed at
+--	the start, so the run can be repeated with the same seed.
 ---------------------------------------------------------------------------------------*/
 #include "common.h"
-#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
+#include <math.h>
 
-#define EXEC 10
+#define USAGE "Usage: %s [-f profile] [-p key=value] HOST [PORT] [NAME]\n"
 
-int random_num(int, int);
+#define SESSION_RBUF 65536
+
+typedef struct {
+    int fd; /* -1 for a free slot */
+    int id; /* the session's number, which seeds its random stream */
+    uint32_t gen; /* bumped when the slot is reused, to skip stale timers */
+    uint64_t rng;
+    bool connecting;
+    bool fresh; /* no byte of the reply read yet */
+    long want; /* reply bytes still to read, 0 between requests */
+    uint64_t start_us;
+    uint64_t end_us; /* of an unpaced session */
+    int n_max; /* requests of a paced session */
+    uint64_t sent_us;
+    int n_requests;
+    int n_replies;
+    int n_busy;
+    long sent;
+    long received;
+    unsigned int *latency; /* of every reply in microseconds */
+    int cap_latency;
+} session;
+
+typedef struct {
+    uint64_t at;
+    int slot;
+    uint32_t gen;
+} timer;
+
+void session_end(int);
+void write_results(void);
 
 // Global
 FILE *fp;
+reslog *results;
+char *csv_file;
+workload wl;
+struct sockaddr_in server_addr;
+const char *unix_path; // the server's Unix socket, NULL for TCP
+char *padding; // the NULs a command is padded with to the payload
+session *sessions;
+int n_slots, *free_slots, n_free;
+timer *timers;
+int n_timers, cap_timers;
+int epfd, n_open, max_open, n_sessions, n_failed;
+unsigned long n_requests, n_replies, n_busy;
+hist latency_us;
+volatile sig_atomic_t stopping;
+
+/**
+ * now_us
+ *
+ * @return the monotonic clock in microseconds
+ */
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * timer_push
+ *
+ * Wakes a session at a time, on a binary min-heap of the timers.
+ *
+ * @param at when
+ * @param slot the session
+ */
+static void timer_push(uint64_t at, int slot) {
+    int i, up;
+    timer t = {at, slot, sessions[slot].gen};
+
+    if (n_timers == cap_timers) {
+        cap_timers = cap_timers ? 2 * cap_timers : 1024;
+        if ((timers = realloc(timers, cap_timers * sizeof (timer))) == NULL)
+            SystemFatal("realloc(): Failed");
+    }
+    for (i = n_timers++; i > 0 && timers[up = (i - 1) / 2].at > at; i = up)
+        timers[i] = timers[up];
+    timers[i] = t;
+}
+
+/**
+ * timer_pop
+ *
+ * @return the earliest timer, taken off the heap
+ */
+static timer timer_pop(void) {
+    timer top = timers[0], last = timers[--n_timers];
+    int i = 0, child;
+
+    while ((child = 2 * i + 1) < n_timers) {
+        if (child + 1 < n_timers && timers[child + 1].at < timers[child].at)
+            child++;
+        if (timers[child].at >= last.at)
+            break;
+        timers[i] = timers[child];
+        i = child;
+    }
+    timers[i] = last;
+    return top;
+}
+
+/**
+ * session_open
+ *
+ * Starts the next session: draws its length and starts connecting.
+ *
+ * @param now the time
+ */
+void session_open(uint64_t now) {
+    struct epoll_event ev;
+    double secs;
+    session *s;
+    int slot;
+
+    if (n_free == 0) {
+        slot = n_slots;
+        n_slots = n_slots ? 2 * n_slots : 256;
+        sessions = realloc(sessions, n_slots * sizeof (session));
+        free_slots = realloc(free_slots, n_slots * sizeof (int));
+        if (sessions == NULL || free_slots == NULL)
+            SystemFatal("realloc(): Failed");
+        bzero(sessions + slot, (n_slots - slot) * sizeof (session));
+        for (n_free = 0; n_free < n_slots - slot; n_free++) {
+            free_slots[n_free] = n_slots - 1 - n_free;
+            sessions[n_slots - 1 - n_free].fd = -1;
+        }
+    }
+    slot = free_slots[--n_free];
+    s = &sessions[slot];
+    s->id = n_sessions++;
+    s->rng = workload_seed(wl.seed, s->id + 1);
+    secs = dist_sample(&wl.session, &s->rng);
+    if (wl.session_max > 0 && secs > wl.session_max)
+        secs = wl.session_max;
+    s->start_us = now;
+    s->end_us = now + (uint64_t) (secs * 1e6);
+    s->n_max = wl.rate > 0 ? (int) ceil(secs * wl.rate) : 0;
+    s->connecting = true;
+    s->want = 0;
+    s->n_requests = s->n_replies = s->n_busy = 0;
+    s->sent = s->received = 0;
+
+    if (unix_path != NULL) {
+        s->fd = unix_connect_start(unix_path);
+    } else if ((s->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0)) < 0) {
+        SystemFatal("Cannot Create Socket!");
+    } else if (connect(s->fd, (struct sockaddr *) &server_addr, sizeof (server_addr)) < 0 &&
+            errno != EINPROGRESS) {
+        close(s->fd);
+        s->fd = -1;
+    }
+    if (s->fd < 0) {
+        n_failed++;
+        s->gen++;
+        free_slots[n_free++] = slot;
+        return;
+    }
+    ev.events = EPOLLOUT | EPOLLIN;
+    ev.data.u32 = slot;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, s->fd, &ev) == -1)
+        SystemFatal("epoll_ctl() error");
+    if (++n_open > max_open)
+        max_open = n_open;
+}
+
+/**
+ * session_write
+ *
+ * Writes a command padded with NULs to the profile's payload, as
+ * tcp_clnt pads its fixed size requests.
+ *
+ * @param s the session
+ * @param msg the command
+ * @param len its length
+ * @return false if the socket did not take all of it
+ */
+bool session_write(session *s, const char *msg, int len) {
+    struct iovec iov[2];
+    int pad = wl.payload > len ? wl.payload - len : 0;
+
+    iov[0].iov_base = (void *) msg;
+    iov[0].iov_len = len;
+    iov[1].iov_base = padding;
+    iov[1].iov_len = pad;
+    if (writev(s->fd, iov, 2) != len + pad)
+        return false;
+    s->sent += len + pad;
+    return true;
+}
+
+/**
+ * session_send
+ *
+ * Sends a session's next request, with a reply length drawn from the
+ * profile, or ends the session once it has sent them all.
+ *
+ * @param slot the session
+ * @param now the time
+ */
+void session_send(int slot, uint64_t now) {
+    session *s = &sessions[slot];
+    char msg[32];
+    long size;
+    int len;
+
+    if ((s->n_max > 0 ? s->n_requests >= s->n_max : now >= s->end_us) || stopping) {
+        session_end(slot);
+        return;
+    }
+    size = (long) dist_sample(&wl.size, &s->rng);
+    if (size > REPLY_MAX_LEN)
+        size = REPLY_MAX_LEN;
+    if (size > 0)
+        len = snprintf(msg, sizeof (msg), "request %ld\n", size);
+    else
+        len = snprintf(msg, sizeof (msg), "request\n");
+
+    /* one request in flight, the socket buffer always takes it */
+    if (!session_write(s, msg, len)) {
+        session_end(slot);
+        return;
+    }
+    s->want = size > 0 ? size : BUFLEN;
+    s->fresh = true;
+    s->sent_us = now;
+    s->n_requests++;
+    n_requests++;
+}
+
+/**
+ * session_read
+ *
+ * Reads a session's reply, and sends its next request once it is
+ * complete, at once or when the rate allows.
+ *
+ * @param slot the session
+ */
+void session_read(int slot) {
+    session *s = &sessions[slot];
+    char buf[SESSION_RBUF];
+    uint64_t now, next;
+    ssize_t r;
+
+    while ((r = read(s->fd, buf, sizeof (buf))) > 0) {
+        s->received += r;
+        if (s->want == 0)
+            continue;
+
+        /* a shed request is answered "busy\n", replies start with a digit */
+        if (s->fresh && buf[0] == 'b') {
+            s->want = OVERLOAD_BUSY_LEN;
+            s->n_busy++;
+            n_busy++;
+        }
+        s->fresh = false;
+        if ((s->want -= r) > 0)
+            continue;
+        s->want = 0;
+
+        now = now_us();
+        if (s->n_replies == s->cap_latency) {
+            s->cap_latency = s->cap_latency ? 2 * s->cap_latency : 64;
+            s->latency = realloc(s->latency, s->cap_latency * sizeof (unsigned int));
+            if (s->latency == NULL)
+                SystemFatal("realloc(): Failed");
+        }
+        s->latency[s->n_replies++] = now - s->sent_us;
+        hist_add(&latency_us, now - s->sent_us);
+        n_replies++;
+
+        next = wl.rate > 0 ? s->sent_us + (uint64_t) (1e6 / wl.rate) : now;
+        if (next > now)
+            timer_push(next, slot);
+        else
+            session_send(slot, now);
+        return;
+    }
+    if (r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        session_end(slot);
+}
+
+/**
+ * latency_compare
+ */
+static int latency_compare(const void *a, const void *b) {
+    unsigned int x = *(const unsigned int *) a, y = *(const unsigned int *) b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * session_end
+ *
+ * Says "quit", closes a session and logs its results as a tcp_clnt
+ * process used to, with the session's number for the process ID.
+ *
+ * @param slot the session
+ */
+void session_end(int slot) {
+    session *s = &sessions[slot];
+    reslog_rec *r;
+    double mean = 0;
+    int i;
+
+    if (s->fd < 0)
+        return;
+    if (!s->connecting)
+        session_write(s, "quit\n", 5);
+    close(s->fd);
+    s->fd = -1;
+    s->gen++;
+    n_open--;
+    free_slots[n_free++] = slot;
+
+    if (s->n_replies > 0)
+        qsort(s->latency, s->n_replies, sizeof (unsigned int), latency_compare);
+    for (i = 0; i < s->n_replies; i++)
+        mean += s->latency[i];
+    if ((r = reslog_claim(results)) != NULL) {
+        r->pid = s->id;
+        r->requests = s->n_requests;
+        r->replies = s->n_replies;
+        r->dataSent = s->sent;
+        r->dataReceived = s->received;
+        r->time = (now_us() - s->start_us) / 1e6;
+        r->meanLatency = s->n_replies > 0 ? mean / s->n_replies : 0;
+        r->p50Latency = s->n_replies > 0 ? s->latency[s->n_replies / 2] : 0;
+        r->p99Latency = s->n_replies > 0 ? s->latency[(int) (s->n_replies * 0.99)] : 0;
+        r->maxLatency = s->n_replies > 0 ? s->latency[s->n_replies - 1] : 0;
+        r->busy = s->n_busy;
+        reslog_commit(r);
+    }
+    free(s->latency);
+    s->latency = NULL;
+    s->cap_latency = 0;
+}
+
+/**
+ * session_ready
+ *
+ * Handles an event of a session's socket.
+ *
+ * @param slot the session
+ */
+void session_ready(int slot) {
+    session *s = &sessions[slot];
+    struct epoll_event ev;
+    socklen_t len = sizeof (int);
+    int err = 0;
+
+    if (s->fd < 0)
+        return;
+    if (!s->connecting) {
+        session_read(slot);
+        return;
+    }
+    if (getsockopt(s->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+        n_failed++;
+        session_end(slot);
+        return;
+    }
+    s->connecting = false;
+    ev.events = EPOLLIN;
+    ev.data.u32 = slot;
+    if (epoll_ctl(epfd, EPOLL_CTL_MOD, s->fd, &ev) == -1)
+        SystemFatal("epoll_ctl() error");
+    session_send(slot, now_us());
+}
 
 /**
  * main
- * 
+ *
  * @param argc
  * @param argv
- * @return 
+ * @return
  */
 int main(int argc, char **argv) {
-    int i = 0;
-    int pid[EXEC], status;
+    int i, n, opt, wait_ms;
+    uint64_t start, now, arrival_us;
+    double next;
+    bool arriving;
+    struct epoll_event *events;
     struct sigaction act;
-    char *data_file, *host, *interval, *port, *file;
+    struct rlimit rl;
+    struct hostent *hp;
+    char *data_file, *host, *port, *file;
+    timer t;
 
-    switch (argc) {
-        case 2:
-            host = argv[1];
-            port = TOSTRING(SERVER_TCP_PORT);
-            file = malloc(sizeof (char *));
-            sprintf(file, "./data_file.csv");
-            break;
+    workload_init(&wl);
+    while ((opt = getopt(argc, argv, "f:p:")) != -1) {
+        switch (opt) {
+            case 'f':
+                if ((n = workload_load(&wl, optarg)) != 0) { // workload profile file
+                    fprintf(stderr, n < 0 ? "Can't read %s\n" : "%s:%d: bad profile line\n",
+                            optarg, n);
+                    exit(1);
+                }
+                break;
+            case 'p':
+                if (workload_set(&wl, optarg) < 0) { // one profile line, over the file
+                    fprintf(stderr, "Bad profile line: %s\n", optarg);
+                    exit(1);
+                }
+                break;
+            default:
+                fprintf(stderr, USAGE, argv[0]);
+                exit(1);
+        }
+    }
+
+    port = TOSTRING(SERVER_TCP_PORT);
+    file = "data_file";
+    switch (argc - optind) {
         case 3:
-            host = argv[1];
-            port = argv[2];
-            file = malloc(sizeof (char *));
-            sprintf(file, "./data_file.csv");
-            break;
-        case 4:
-            host = argv[1];
-            port = argv[2];
-            file = argv[3];
+            file = argv[optind + 2];
+            /* falls through */
+        case 2:
+            port = argv[optind + 1];
+            /* falls through */
+        case 1:
+            host = argv[optind];
             break;
         default:
-            fprintf(stderr, "USAGE: %s HOST [PORT] [SERVER NAME] \n", argv[0]);
+            fprintf(stderr, USAGE, argv[0]);
             exit(1);
     }
-    interval = malloc(sizeof (char *));
-    data_file = malloc(sizeof (char *));
-    sprintf(data_file, "./%s.csv", file);
+    csv_file = malloc(strlen(file) + 8);
+    sprintf(csv_file, "./%s.csv", file);
 
-    if ((fp = fopen(data_file, "a+")) == NULL) {
-        perror("fopen(): Unable to open the file");
+    // the sessions log their results here, converted to CSV on exit
+    data_file = malloc(strlen(file) + 8);
+    sprintf(data_file, "./%s.dat", file);
+    if ((results = reslog_create(data_file, RESLOG_CAPACITY)) == NULL) {
+        perror("reslog_create(): Unable to create the result log");
         exit(EXIT_FAILURE);
     }
-    fprintf(fp, "ProcessID,Time(Seconds),Data(Bytes)\n");
-
     free(data_file);
-    fclose(fp);
 
-    // set up the signal handler to close the server socket when CTRL-c is received
+    // CTRL-c ends the open sessions and writes the results
     act.sa_handler = signal_handler;
     act.sa_flags = 0;
     if ((sigemptyset(&act.sa_mask) == -1 || sigaction(SIGINT, &act, NULL) == -1)) {
@@ -99,66 +504,133 @@ int main(int argc, char **argv) {
         perror("Failed to set AIGALRM handler");
         exit(EXIT_FAILURE);
     }
+    signal(SIGPIPE, SIG_IGN);
 
-    // run the server 10 times
-    //for (i = 0; i < EXEC; i++) {
-	while(1) {
-        sprintf(interval, "%d", random_num(1, 10));
-        printf("%s", interval);
-        pid[i] = fork();
-        if (pid[i] < 0) {
-            perror("Fork(): Failed");
-            exit(EXIT_FAILURE);
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    if (unix_name(host)) {
+        unix_path = host; // the port is ignored
+    } else {
+        bzero((char *) &server_addr, sizeof (struct sockaddr_in));
+        server_addr.sin_family = AF_INET;
+        server_addr.sin_port = htons(atoi(port));
+        if ((hp = gethostbyname(host)) == NULL) {
+            fprintf(stderr, "Unknown server address\n");
+            exit(1);
         }
-        //Child
-        if (pid[i] == 0) {
-            //connect_to_server(d, host, port);
-            execl("tcp_clnt", "tcp_clnt", host, port, interval, file, NULL);
+        bcopy(hp->h_addr, (char *) &server_addr.sin_addr, hp->h_length);
+    }
+    if ((epfd = epoll_create1(0)) < 0)
+        SystemFatal("epoll_create1(): Failed");
+    if ((events = malloc(EPOLL_MAX_EVENTS * sizeof (struct epoll_event))) == NULL)
+        SystemFatal("malloc(): Failed");
+
+    if ((padding = calloc(1, wl.payload + 1)) == NULL)
+        SystemFatal("calloc(): Failed");
+
+    workload_print(&wl, stdout);
+    fflush(stdout);
+    hist_init(&latency_us);
+    workload_start(&wl);
+    start = now_us();
+    next = workload_next_arrival(&wl);
+    arriving = next >= 0 && (wl.duration == 0 || next < wl.duration);
+    arrival_us = start + (uint64_t) (next * 1e6);
+    while (arriving || n_open > 0) {
+        if (stopping) {
+            for (i = 0; i < n_slots; i++)
+                session_end(i);
             break;
         }
-        usleep(150000);
-    }
 
-    // Parent waits for processes to end
-    for (i = 0; i < EXEC; i++) {
-        waitpid(pid[i], &status, 0);
-    }
+        /* sessions that arrived, and the ones whose time came to send */
+        now = now_us();
+        while (arriving && arrival_us <= now) {
+            session_open(now);
+            next = workload_next_arrival(&wl);
+            arriving = next >= 0 && (wl.duration == 0 || next < wl.duration);
+            arrival_us = start + (uint64_t) (next * 1e6);
+        }
+        while (n_timers > 0 && timers[0].at <= now) {
+            t = timer_pop();
+            if (t.gen == sessions[t.slot].gen)
+                session_send(t.slot, now);
+        }
+        if (!arriving && n_open == 0)
+            break;
 
-    fprintf(stderr, "\n   -------------------------------------------------------------\n");
-    fprintf(stderr, "   ############    Main(): Child Processes Ended    ############\n");
-    fprintf(stderr, "   -------------------------------------------------------------\n\n");
+        wait_ms = -1;
+        if (n_timers > 0)
+            wait_ms = (timers[0].at - now + 999) / 1000;
+        if (arriving && (wait_ms < 0 || arrival_us < now + wait_ms * 1000ULL))
+            wait_ms = arrival_us > now ? (arrival_us - now + 999) / 1000 : 0;
+        if ((n = epoll_wait(epfd, events, EPOLL_MAX_EVENTS, wait_ms)) < 0) {
+            if (errno == EINTR)
+                continue;
+            SystemFatal("epoll_wait(): Failed");
+        }
+        for (i = 0; i < n; i++)
+            session_ready(events[i].data.u32);
+    }
 
+    fprintf(stdout, "[ Sessions: %d in %.3lf s, up to %d open, %d failed to connect\n",
+            n_sessions, (now_us() - start) / 1e6, max_open, n_failed);
+    fprintf(stdout, "[ Requests: %lu, %lu replies, %lu busy\n", n_requests, n_replies, n_busy);
+    hist_print(&latency_us, "Request Latency", "us");
+    write_results();
     return EXIT_SUCCESS;
 }
 
-int random_num(int min, int max) {
-    return min + rand() / (RAND_MAX / (max - min + 1) + 1);
+/**
+ * write_results
+ *
+ * Converts the result log of the sessions to the CSV file.
+ */
+void write_results(void) {
+    if ((fp = fopen(csv_file, "w")) == NULL) {
+        perror("fopen(): Unable to open the file");
+        return;
+    }
+    reslog_to_csv(results, fp);
+    fclose(fp);
 }
 
 /**
  * signal_Handler
- * 
+ *
  * Handles signals that occur during program execution.
- * 
+ *
  * @param signo The Signal Received
  */
 void signal_handler(int signo) {
     switch (signo) {
         case SIGINT:
             fprintf(stderr, "\nReceived SIGINT signal\n");
-            exit(EXIT_FAILURE);
+            stopping = 1;
             break;
 
         case SIGSEGV:
             fprintf(stderr, "\nReceived SIGSEGV signal\n");
-            fclose(fp);
             exit(EXIT_FAILURE);
             break;
 
         default:
             fprintf(stderr, "\nUn handled signal %s\n", strsignal(signo));
-            fclose(fp);
             exit(EXIT_FAILURE);
             break;
     }
 }
+
+/**
+ * SystemFatal
+ *
+ * Displays a perror message and exits the program.
+ *
+ * @param message takes in a string message
+ */
+void SystemFatal(const char* message) {
+    perror(message);
+    exit(EXIT_FAILURE);
+}
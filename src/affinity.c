@@ -0,0 +1,174 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		affinity.c - CPU and NUMA placement of server threads
+--
+--	FUNCTIONS:			pthread_setaffinity_np, mbind
+--
+--	DATE:				October 19, 2026
+--
+--	NOTES:
+--	The servers take a CPU list such as "0-3,8" and pin their threads to the
+--	CPUs in it, in turn. A pinned thread allocates its buffers with
+--	affinity_alloc, which binds the pages to the thread's NUMA node, and its
+--	malloc arena is filled by first touch on the same node. Every step
+--	degrades to the unpinned behaviour: CPUs the process may not run on are
+--	dropped from the list, a node that cannot be found is -1 and a failed
+--	mbind leaves the pages to the first touch policy. mbind is called
+--	through syscall so the servers do not need libnuma.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+/**
+ * affinity_parse
+ *
+ * Parses a CPU list of numbers and ranges, "0-3,8". CPUs outside the
+ * process's own affinity mask are left out with a warning.
+ *
+ * @param list the CPU list
+ * @param set the CPUs parsed
+ * @return the number of usable CPUs, -1 if the list is malformed
+ */
+int affinity_parse(const char *list, cpu_set_t *set) {
+    cpu_set_t allowed;
+    const char *p = list;
+    char *end;
+    long lo, hi, cpu;
+
+    CPU_ZERO(set);
+    if (sched_getaffinity(0, sizeof (allowed), &allowed) < 0)
+        return -1;
+
+    while (*p != '\0') {
+        lo = strtol(p, &end, 10);
+        if (end == p || lo < 0)
+            return -1;
+        hi = lo;
+        if (*end == '-') {
+            p = end + 1;
+            hi = strtol(p, &end, 10);
+            if (end == p || hi < lo)
+                return -1;
+        }
+        for (cpu = lo; cpu <= hi && cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowed))
+                CPU_SET(cpu, set);
+            else
+                fprintf(stderr, "affinity: CPU %ld is not available, skipped\n", cpu);
+        }
+        if (*end == ',')
+            end++;
+        else if (*end != '\0')
+            return -1;
+        p = end;
+    }
+    return CPU_COUNT(set);
+}
+
+/**
+ * affinity_cpu
+ *
+ * @param set the CPUs
+ * @param n a thread number
+ * @return the CPU thread n runs on, the CPUs are used in turn, -1 for an
+ * empty set
+ */
+int affinity_cpu(const cpu_set_t *set, int n) {
+    int cpu, count = CPU_COUNT(set);
+
+    if (count == 0)
+        return -1;
+    n %= count;
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, set) && n-- == 0)
+            return cpu;
+    }
+    return -1;
+}
+
+/**
+ * affinity_pin
+ *
+ * Pins the calling thread to one CPU.
+ *
+ * @param cpu the CPU
+ * @return 0, -1 if the thread could not be pinned
+ */
+int affinity_pin(int cpu) {
+    cpu_set_t set;
+
+    if (cpu < 0)
+        return -1;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof (set), &set) == 0 ? 0 : -1;
+}
+
+/**
+ * affinity_node
+ *
+ * @param cpu the CPU
+ * @return the NUMA node of the CPU, -1 when the kernel does not tell
+ */
+int affinity_node(int cpu) {
+    char path[64];
+    struct dirent *e;
+    DIR *dir;
+    int node = -1;
+
+    if (cpu < 0)
+        return -1;
+    snprintf(path, sizeof (path), "/sys/devices/system/cpu/cpu%d", cpu);
+    if ((dir = opendir(path)) == NULL)
+        return -1;
+
+    /* the CPU's directory links to its node as "nodeN" */
+    while ((e = readdir(dir)) != NULL) {
+        if (strncmp(e->d_name, "node", 4) == 0 && e->d_name[4] >= '0' && e->d_name[4] <= '9') {
+            node = atoi(e->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+/**
+ * affinity_alloc
+ *
+ * Allocates zeroed memory on a NUMA node. The pages are faulted in by the
+ * caller, so they follow the first touch policy if the binding fails.
+ *
+ * @param size the number of bytes
+ * @param node the node, -1 for wherever the caller runs
+ * @return the memory, NULL on failure
+ */
+void* affinity_alloc(size_t size, int node) {
+    unsigned long mask;
+    void *p;
+
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return NULL;
+
+    if (node >= 0 && node < (int) (8 * sizeof (mask))) {
+        mask = 1UL << node;
+        syscall(SYS_mbind, p, size, MPOL_PREFERRED, &mask, 8 * sizeof (mask), 0);
+    }
+    memset(p, 0, size);
+    return p;
+}
+
+/**
+ * affinity_free
+ *
+ * @param p memory from affinity_alloc
+ * @param size the size it was allocated with
+ */
+void affinity_free(void *p, size_t size) {
+    if (p != NULL)
+        munmap(p, size);
+}
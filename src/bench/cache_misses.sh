@@ -0,0 +1,49 @@
+#!/bin/sh
+#
+# cache_misses.sh - cache misses per request of s_svr and e_svr
+#
+# usage: bench/cache_misses.sh [seconds] [clients]
+#
+# Loads each server with pipelined tcp_clnt connections and prints the
+# server's cache misses, cycles and CPU time per request and its events
+# per epoll wakeup. Run it on two builds to compare state layouts; the
+# hardware counters need perf_event_paranoid <= 1 or CAP_PERFMON, without
+# them only the CPU time is reported. Build the servers, tcp_clnt and
+# res2csv first.
+
+cd "$(dirname "$0")/.." || exit 1
+
+SECS=${1:-5}
+CLIENTS=${2:-16}
+PORT=7430
+LOG=$(mktemp)
+trap 'rm -f "$LOG" bench_cache.dat' EXIT
+
+# value of one "[ Name: value" line of the server's report
+stat() {
+    sed -n "s/^\[ $1: \([0-9.n/a]*\).*/\1/p" "$LOG"
+}
+
+printf "%-6s %12s %12s %12s %10s %14s\n" server requests/s misses/req \
+    cycles/req cpu-us/req events/wakeup
+for svr in s_svr e_svr; do
+    ./$svr -q -c 250 $PORT > "$LOG" 2>&1 &
+    pid=$!
+    sleep 0.5
+
+    rm -f bench_cache.dat
+    i=0
+    while [ $i -lt "$CLIENTS" ]; do
+        ./tcp_clnt -d 8 -r 0 127.0.0.1 $PORT "$SECS" bench_cache > /dev/null 2>&1 &
+        i=$((i + 1))
+    done
+    sleep $((SECS + 2))
+    kill -INT $pid
+    wait $pid 2> /dev/null
+
+    requests=$(stat "Requests Handled")
+    printf "%-6s %12.0f %12s %12s %10s %14s\n" $svr "$(echo "$requests $SECS" | awk '{ print $1 / $2 }')" \
+        "$(stat "Cache Misses\/Request")" "$(stat "Cycles\/Request")" \
+        "$(stat "CPU Time\/Request")" "$(stat "Events\/Wakeup")"
+    PORT=$((PORT + 1))
+done
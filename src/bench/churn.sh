@@ -0,0 +1,46 @@
+#!/bin/sh
+#
+# churn.sh - connection churn against s_svr, e_svr and t_svr
+#
+# usage: bench/churn.sh [seconds] [threads]
+#
+# Runs churn_clnt against each server started with -q, once closing with a
+# FIN and once with a RST, and prints connections per second and the p50 and
+# p99 connect and first byte latencies. Build the servers and churn_clnt
+# first.
+
+cd "$(dirname "$0")/.." || exit 1
+
+SECS=${1:-5}
+THREADS=${2:-4}
+PORT=7420
+LOG=$(mktemp)
+trap 'rm -f "$LOG"' EXIT
+
+# field value from a churn_clnt histogram line
+pct() {
+    sed -n "s/^\[ $1 (us):.* $2=\([0-9]*\).*/\1/p" "$LOG"
+}
+
+printf "%-6s %-5s %10s %12s %12s %12s %12s\n" server close conns/s \
+    conn-p50-us conn-p99-us first-p50-us first-p99-us
+for svr in s_svr e_svr t_svr; do
+    for close in FIN RST; do
+        flags=""
+        [ $close = RST ] && flags="-R"
+
+        ./$svr -q $PORT > /dev/null 2>&1 &
+        pid=$!
+        sleep 0.5
+
+        ./churn_clnt -t "$THREADS" -s "$SECS" $flags 127.0.0.1 $PORT > "$LOG" 2>&1
+        kill -INT $pid
+        wait $pid 2> /dev/null
+
+        rate=$(sed -n 's/^\[ Connections\/s: \([0-9.]*\).*/\1/p' "$LOG")
+        printf "%-6s %-5s %10s %12s %12s %12s %12s\n" $svr $close "$rate" \
+            "$(pct Connect p50)" "$(pct Connect p99)" \
+            "$(pct "Connect to First Byte" p50)" "$(pct "Connect to First Byte" p99)"
+        PORT=$((PORT + 1))
+    done
+done
@@ -0,0 +1,54 @@
+#!/bin/sh
+#
+# coro.sh - e_svr with callback and coroutine connection handlers
+#
+# usage: bench/coro.sh [seconds] [clients] [depth]
+#
+# Prints coro_bench's cost of a switch next to a plain callback, then
+# loads e_svr with pipelined tcp_clnt connections, once with the callback
+# handlers and once with -C, and prints the requests per second, the
+# server's CPU time per request and the coroutine resumes per request.
+# A shallow pipeline makes the coroutines yield on almost every request.
+# Build e_svr, tcp_clnt and coro_bench first.
+
+cd "$(dirname "$0")/.." || exit 1
+
+SECS=${1:-5}
+CLIENTS=${2:-16}
+DEPTH=${3:-1}
+PORT=7450
+LOG=$(mktemp)
+trap 'rm -f "$LOG" bench_coro.dat' EXIT
+
+# value of one "[ Name: value" line of the server's report
+stat() {
+    sed -n "s/^\[ $1: \([0-9.]*\).*/\1/p" "$LOG"
+}
+
+./coro_bench -n 1000000
+
+printf "\n%-9s %12s %10s %12s\n" handlers requests/s cpu-us/req resumes/req
+for mode in callback coro; do
+    flags=""
+    [ $mode = coro ] && flags="-C"
+    ./e_svr -q -c 250 $flags $PORT > "$LOG" 2>&1 &
+    pid=$!
+    sleep 0.5
+
+    rm -f bench_coro.dat
+    i=0
+    while [ $i -lt "$CLIENTS" ]; do
+        ./tcp_clnt -d "$DEPTH" -r 0 127.0.0.1 $PORT "$SECS" bench_coro > /dev/null 2>&1 &
+        i=$((i + 1))
+    done
+    sleep $((SECS + 2))
+    kill -INT $pid
+    wait $pid 2> /dev/null
+
+    requests=$(stat "Requests Handled")
+    resumes=$(sed -n "s/^\[ Coroutines:.* \([0-9]*\) resumes/\1/p" "$LOG")
+    printf "%-9s %12.0f %10s %12s\n" $mode "$(echo "$requests $SECS" | awk '{ print $1 / $2 }')" \
+        "$(stat "CPU Time\/Request")" \
+        "$(echo "${resumes:-0} $requests" | awk '{ if ($1 > 0 && $2 > 0) printf "%.2f", $1 / $2; else print "-" }')"
+    PORT=$((PORT + 1))
+done
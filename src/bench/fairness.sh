@@ -0,0 +1,55 @@
+#!/bin/sh
+#
+# fairness.sh - latency of light clients next to heavy ones in e_svr
+#
+# usage: bench/fairness.sh [seconds] [heavy clients] [light clients] [budget]
+#
+# Heavy tcp_clnt connections keep 64 requests in flight and light ones
+# send one request every millisecond on the same e_svr. The light
+# clients' round trips are compared with the socket drained on every
+# edge and with a -B budget of requests per turn. The spread of the
+# light clients' p99 shows how evenly they are served. Build e_svr,
+# tcp_clnt and res2csv first.
+
+cd "$(dirname "$0")/.." || exit 1
+
+SECS=${1:-5}
+HEAVY=${2:-4}
+LIGHT=${3:-16}
+BUDGET=${4:-8}
+PORT=7470
+trap 'rm -f bench_heavy.dat bench_light.dat bench_light.csv' EXIT
+
+printf "%-8s %10s %12s %12s %12s %12s\n" budget heavy-req/s light-p50-us light-p99-us \
+    p99-stddev light-max-us
+for budget in 0 "$BUDGET"; do
+    ./e_svr -q -B "$budget" $PORT > /dev/null 2>&1 &
+    pid=$!
+    sleep 0.5
+
+    rm -f bench_heavy.dat bench_light.dat
+    i=0
+    while [ $i -lt "$HEAVY" ]; do
+        ./tcp_clnt -d 64 -b 64 -r 0 127.0.0.1 $PORT "$SECS" bench_heavy > /dev/null 2>&1 &
+        i=$((i + 1))
+    done
+    i=0
+    while [ $i -lt "$LIGHT" ]; do
+        ./tcp_clnt -d 1 -r 1000 127.0.0.1 $PORT "$SECS" bench_light > /dev/null 2>&1 &
+        i=$((i + 1))
+    done
+    sleep $((SECS + 2))
+    kill -INT $pid
+    wait $pid 2> /dev/null
+
+    heavy=$(./res2csv bench_heavy.dat 2> /dev/null | awk -F, -v s="$SECS" \
+        'NR > 1 { n += $5 } END { printf "%.0f", n / s }')
+    ./res2csv bench_light.dat bench_light.csv 2> /dev/null
+    awk -F, -v b="$budget" 'NR > 1 { n++; p50 += $8; p99 += $9; sq += $9 * $9
+            if ($10 > max) max = $10 }
+        END { if (n == 0) exit
+            m = p99 / n; v = sq / n - m * m
+            printf "%12.0f %12.0f %12.1f %12d\n", p50 / n, m, sqrt(v > 0 ? v : 0), max }' \
+        bench_light.csv | sed "s/^/$(printf "%-8s %10s" "$budget" "$heavy")/"
+    PORT=$((PORT + 1))
+done
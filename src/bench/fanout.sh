@@ -0,0 +1,50 @@
+#!/bin/sh
+#
+# fanout.sh - broadcast fan out latency by subscribers and reactors
+#
+# usage: bench/fanout.sh [messages] [subscribers] [reactors]
+#
+# Runs ps_clnt against e_svr -S for each number of subscribers and
+# reactors and tabulates the time from publishing a message to the first
+# and the last subscriber receiving it, as the client sees it, and to the
+# server's last write of it. Every subscriber takes a descriptor in the
+# client and in the server, so counts above half the hard open file
+# limit are skipped. Build e_svr and ps_clnt first.
+
+cd "$(dirname "$0")/.." || exit 1
+
+MSGS=${1:-100}
+SUBS=${2:-"1000 5000 10000 20000 50000"}
+REACTORS=${3:-"1 2"}
+PORT=7590
+LOG=$(mktemp)
+OUT=$(mktemp)
+LIMIT=$(ulimit -Hn)
+trap 'rm -f "$LOG" "$OUT"' EXIT
+
+printf "%-11s %-8s %12s %12s %12s %12s %8s\n" subscribers reactors first_p50 last_p50 \
+    last_p99 write_p99 missed
+for n in $SUBS; do
+    if [ "$LIMIT" != unlimited ] && [ $((n * 2 + 64)) -gt "$LIMIT" ]; then
+        printf "%-11s skipped, the open file limit is %s\n" "$n" "$LIMIT"
+        continue
+    fi
+    for w in $REACTORS; do
+        ./e_svr -q -w "$w" -S 32 $PORT > "$LOG" 2>&1 &
+        pid=$!
+        sleep 0.5
+
+        ./ps_clnt -n "$n" -m "$MSGS" 127.0.0.1 $PORT > "$OUT" 2>&1
+        kill -INT $pid
+        wait $pid 2> /dev/null
+
+        first=$(sed -n 's/^\[ Publish to First Delivery.* p50=\([0-9]*\).*/\1/p' "$OUT")
+        last=$(sed -n 's/^\[ Publish to Last Delivery.* p50=\([0-9]*\).*/\1/p' "$OUT")
+        last99=$(sed -n 's/^\[ Publish to Last Delivery.* p99=\([0-9]*\).*/\1/p' "$OUT")
+        write99=$(sed -n 's/^\[ Publish to Last Write.* p99=\([0-9]*\).*/\1/p' "$LOG")
+        missed=$(sed -n 's/^\[ Deliveries: \([0-9]*\) missed.*/\1/p' "$OUT")
+        printf "%-11s %-8s %10sus %10sus %10sus %10sus %8s\n" "$n" "$w" "$first" "$last" \
+            "$last99" "$((${write99:-0} / 1000))" "$missed"
+        PORT=$((PORT + 1))
+    done
+done
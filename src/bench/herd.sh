@@ -0,0 +1,53 @@
+#!/bin/sh
+#
+# herd.sh - listen socket wakeups and accept spread of e_svr's accept modes
+#
+# usage: bench/herd.sh [seconds] [waiters] [churn threads]
+#
+# Runs e_svr with several reactor threads (-w) and several worker
+# processes (-P), in each accept mode, under churn_clnt, and prints the
+# connection rate, the listen socket events and the times a reactor or
+# worker was woken up (its voluntary context switches) per accepted
+# connection, the share of listen events that found no connection and the
+# number of connections each reactor or worker accepted. A herd wakeup
+# that epoll finds stale before returning reports no listen event, so it
+# only shows in the wakeups/accept column, not in listen/accept. Build
+# e_svr and churn_clnt first.
+
+cd "$(dirname "$0")/.." || exit 1
+
+SECS=${1:-3}
+WAITERS=${2:-4}
+THREADS=${3:-4}
+PORT=7450
+LOG=$(mktemp)
+CHURN=$(mktemp)
+trap 'rm -f "$LOG" "$CHURN"' EXIT
+
+printf "%-7s %-9s %10s %13s %12s %6s  %s\n" waiters mode conns/s listen/accept wakeups/accept empty accepts
+for kind in w P; do
+    for mode in share excl reuseport; do
+        ./e_svr -q -$kind "$WAITERS" -A $mode $PORT > "$LOG" 2>&1 &
+        pid=$!
+        sleep 0.5
+
+        ./churn_clnt -t "$THREADS" -s "$SECS" -R 127.0.0.1 $PORT > "$CHURN" 2>&1
+        kill -INT $pid
+        wait $pid 2> /dev/null
+        sleep 0.2
+
+        [ $kind = w ] && waiters=threads || waiters=procs
+        awk -v waiters=$waiters -v mode=$mode -v rate="$(sed -n 's/^\[ Connections\/s: \([0-9.]*\).*/\1/p' "$CHURN")" '
+            /^\[ (Reactor|CPU|Worker) .* clients/ {
+                sub(/.*\): /, ""); accepts = accepts sep $1; sep = ","
+            }
+            /^\[ Listen Wakeups:/ { wakeups = $4; empty = $5; sub(/\(/, "", empty) }
+            /^\[ Listen Wakeups\/Accept:/ { listen = $4 }
+            /^\[ (Thread|Process) Wakeups\/Accept:/ { per = $4 }
+            END {
+                printf "%-7s %-9s %10s %13s %12s %5.1f%%  %s\n", waiters, mode, rate, listen, per,
+                    wakeups ? 100 * empty / wakeups : 0, accepts
+            }' "$LOG"
+        PORT=$((PORT + 1))
+    done
+done
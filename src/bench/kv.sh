@@ -0,0 +1,28 @@
+#!/bin/sh
+#
+# kv.sh - key value cache operations per second by threads, mix and skew
+#
+# usage: bench/kv.sh [seconds] [threads] [megabytes]
+#
+# Runs kv_bench at each thread count and tabulates its runs: 100, 95 and
+# 50 percent gets over uniform and Zipf keys. Reads never take the lock,
+# so the all-get rows should grow with the threads while the write heavy
+# rows stay near the single writer's rate. A cap below the keys' size
+# shows the hit rate of the LRU. Build kv_bench first.
+
+cd "$(dirname "$0")/.." || exit 1
+
+SECS=${1:-2}
+THREADS=${2:-"1 2 4"}
+MB=${3:-64}
+LOG=$(mktemp)
+trap 'rm -f "$LOG"' EXIT
+
+printf "%-8s %-6s %-8s %12s %8s\n" threads gets keys ops/s hits
+for t in $THREADS; do
+    ./kv_bench -t "$t" -s "$SECS" -m "$MB" > "$LOG" 2>&1
+    sed -n 's/^\[ *\([0-9]*\)% gets \([a-z]*\) *\([0-9]*\) ops\/s *\([0-9.]*\)% hits.*/\1 \2 \3 \4/p' "$LOG" |
+    while read -r pct keys ops hits; do
+        printf "%-8s %-6s %-8s %12s %7s%%\n" "$t" "$pct%" "$keys" "$ops" "$hits"
+    done
+done
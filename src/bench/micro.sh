@@ -0,0 +1,43 @@
+#!/bin/sh
+#
+# micro.sh - microbenchmarks of the building blocks, compared to a baseline
+#
+# usage: bench/micro.sh [results.json] [baseline.json] [micro_bench options]
+#
+# Runs micro_bench into results.json, micro.json by default. Given the
+# results of another commit, tabulates the mean time per operation of
+# every case in both and the change, marking it "*" where the means are
+# further apart than their 95% confidence intervals together, so the
+# noise of a run is not taken for a change. Build micro_bench and the
+# servers first.
+
+cd "$(dirname "$0")/.." || exit 1
+
+OUT=${1:-micro.json}
+BASE=${2:-}
+[ $# -gt 0 ] && shift
+[ $# -gt 0 ] && shift
+
+./micro_bench -o "$OUT" "$@" || exit 1
+[ -n "$BASE" ] || exit 0
+
+# "name size mean ci95" of every case, one JSON object per line
+cases() {
+    sed -n 's/.*"name": "\([^"]*\)", "size": \([0-9]*\),.*"mean": \([0-9.]*\),.*"ci95": \([0-9.]*\),.*/\1 \2 \3 \4/p' "$1"
+}
+
+LOG=$(mktemp)
+trap 'rm -f "$LOG"' EXIT
+cases "$BASE" > "$LOG"
+
+printf "%-20s %10s %14s %14s %9s\n" case size "base ns/op" "ns/op" change
+cases "$OUT" | while read -r name size mean ci; do
+    awk -v n="$name" -v s="$size" -v m="$mean" -v c="$ci" '
+        $1 == n && $2 == s {
+            d = m - $3
+            mark = (d > c + $4 || -d > c + $4) ? "*" : ""
+            printf "%-20s %10s %14.1f %14.1f %+8.1f%%%s\n", n, s, $3, m, 100 * d / $3, mark
+            found = 1
+        }
+        END { if (!found) printf "%-20s %10s %14s %14.1f %9s\n", n, s, "-", m, "new" }' "$LOG"
+done
@@ -0,0 +1,64 @@
+#!/bin/sh
+#
+# overload.sh - latency of an existing client while the servers are overloaded
+#
+# usage: bench/overload.sh [seconds] [clients] [lag_us]
+#
+# Connects probe_clnt to each server, then floods the server with pipelined
+# tcp_clnt connections, without admission control and with each -O policy.
+# Prints the probe's round trip, the probes answered busy, the connections
+# the server reset and its loop lag. With shedding the probe, a client
+# that was served before the flood, should keep its latency. Build the
+# servers, tcp_clnt and probe_clnt first.
+
+cd "$(dirname "$0")/.." || exit 1
+
+SECS=${1:-5}
+CLIENTS=${2:-64}
+LAG=${3:-2000}
+PORT=7460
+LOG=$(mktemp)
+PROBE=$(mktemp)
+trap 'rm -f "$LOG" "$PROBE" bench_overload.dat' EXIT
+
+# field value from a histogram line of the probe or the server
+pct() {
+    sed -n "s/^\[ $2 (ns):.* $3=\([0-9]*\).*/\1/p" "$1"
+}
+
+# value of one "[ Name: value" line of the server's report
+stat() {
+    sed -n "s/^\[ $1: \([0-9]*\).*/\1/p" "$LOG"
+}
+
+printf "%-6s %-7s %12s %12s %8s %9s %12s\n" server policy rtt-p50-ns rtt-p99-ns busy rejected lag-p99-ns
+for svr in s_svr e_svr t_svr; do
+    for policy in none reject busy; do
+        flags=""
+        [ $policy != none ] && flags="-O $LAG,$policy"
+        ./$svr -q $flags $PORT > "$LOG" 2>&1 &
+        pid=$!
+        sleep 0.5
+
+        ./probe_clnt -i 2000 -n $((SECS * 400)) 127.0.0.1 $PORT > "$PROBE" 2>&1 &
+        probe=$!
+        sleep 0.5
+
+        rm -f bench_overload.dat
+        i=0
+        while [ $i -lt "$CLIENTS" ]; do
+            ./tcp_clnt -d 16 -r 0 127.0.0.1 $PORT "$SECS" bench_overload > /dev/null 2>&1 &
+            i=$((i + 1))
+        done
+        wait $probe 2> /dev/null
+        sleep 2
+        kill -INT $pid
+        wait $pid 2> /dev/null
+
+        busy=$(sed -n 's/^\[ Probes:.* \([0-9]*\) busy/\1/p' "$PROBE")
+        printf "%-6s %-7s %12s %12s %8s %9s %12s\n" $svr $policy \
+            "$(pct "$PROBE" "Round Trip" p50)" "$(pct "$PROBE" "Round Trip" p99)" "$busy" \
+            "$(stat "Rejected Connections")" "$(pct "$LOG" "Loop Lag" p99)"
+        PORT=$((PORT + 1))
+    done
+done
@@ -0,0 +1,53 @@
+#!/bin/sh
+#
+# parse.sh - parse throughput of the text and binary framings
+#
+# usage: bench/parse.sh [seconds] [clients] [depth] [size]
+#
+# Prints proto_bench's parse rates in GB/s for the text framing with each
+# newline scan kernel and for the binary framing, then loads e_svr with
+# pipelined tcp_clnt connections of size byte requests, once as text and
+# once as frames with -x, and prints the requests per second and the
+# server's CPU time per request.
+# Build e_svr, tcp_clnt and proto_bench first.
+
+cd "$(dirname "$0")/.." || exit 1
+
+SECS=${1:-5}
+CLIENTS=${2:-8}
+DEPTH=${3:-16}
+SIZE=${4:-1024}
+PORT=7500
+LOG=$(mktemp)
+trap 'rm -f "$LOG" bench_parse.dat' EXIT
+
+# value of one "[ Name: value" line of the server's report
+stat() {
+    sed -n "s/^\[ $1: \([0-9.]*\).*/\1/p" "$LOG"
+}
+
+./proto_bench -s 4096
+
+printf "\n%-9s %12s %10s\n" framing requests/s cpu-us/req
+for mode in text binary; do
+    flags=""
+    [ $mode = binary ] && flags="-x"
+    ./e_svr -q -c 250 $PORT > "$LOG" 2>&1 &
+    pid=$!
+    sleep 0.5
+
+    rm -f bench_parse.dat
+    i=0
+    while [ $i -lt "$CLIENTS" ]; do
+        ./tcp_clnt -d "$DEPTH" -r 0 -s "$SIZE" $flags 127.0.0.1 $PORT "$SECS" bench_parse > /dev/null 2>&1 &
+        i=$((i + 1))
+    done
+    sleep $((SECS + 2))
+    kill -INT $pid
+    wait $pid 2> /dev/null
+
+    requests=$(stat "Requests Handled")
+    printf "%-9s %12.0f %10s\n" $mode "$(echo "$requests $SECS" | awk '{ print $1 / $2 }')" \
+        "$(stat "CPU Time\/Request")"
+    PORT=$((PORT + 1))
+done
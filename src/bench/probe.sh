@@ -0,0 +1,51 @@
+#!/bin/sh
+#
+# probe.sh - e_svr round trip latency, idle and under load
+#
+# usage: bench/probe.sh [probe cpu] [load clients] [probes]
+#
+# Runs probe_clnt against an idle e_svr and again while tcp_clnt
+# connections load it, and prints the round trip percentiles; the
+# difference is the queueing delay the load adds. Pin the probe to a CPU
+# the server and the load do not use, on a machine with a single CPU the
+# spinning probe competes with the server itself. Build e_svr, tcp_clnt
+# and probe_clnt first.
+
+cd "$(dirname "$0")/.." || exit 1
+
+CPU=${1:--1}
+CLIENTS=${2:-8}
+PROBES=${3:-5000}
+PORT=7440
+LOG=$(mktemp)
+trap 'rm -f "$LOG" bench_probe.dat' EXIT
+
+# field value from the probe's round trip line
+pct() {
+    sed -n "s/^\[ Round Trip (ns):.* $1=\([0-9]*\).*/\1/p" "$LOG"
+}
+
+./e_svr -q $PORT > /dev/null 2>&1 &
+pid=$!
+loaders=""
+sleep 0.5
+
+printf "%-8s %10s %10s %10s %10s\n" load p50-ns p90-ns p99-ns p99.9-ns
+for load in idle loaded; do
+    if [ $load = loaded ]; then
+        i=0
+        while [ $i -lt "$CLIENTS" ]; do
+            ./tcp_clnt -d 4 -r 0 127.0.0.1 $PORT 3600 bench_probe > /dev/null 2>&1 &
+            loaders="$loaders $!"
+            i=$((i + 1))
+        done
+        sleep 1
+    fi
+
+    ./probe_clnt -a "$CPU" -i 500 -n "$PROBES" 127.0.0.1 $PORT > "$LOG" 2>&1
+    printf "%-8s %10s %10s %10s %10s\n" $load "$(pct p50)" "$(pct p90)" "$(pct p99)" "$(pct p99.9)"
+done
+
+kill -INT $loaders
+kill -INT $pid
+wait 2> /dev/null
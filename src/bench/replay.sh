@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# replay.sh - the same captured workload against several servers
+#
+# usage: bench/replay.sh TRACE [speed] [server ...]
+#
+# Replays a trace written by a server started with -R against each
+# server command in turn, "./e_svr", "./s_svr" and "./t_svr" by default,
+# and tabulates the request latency and how far the replay fell behind
+# the trace. A server command may carry options, "./e_svr -w 2", or be
+# the binary of another build, so two builds run the exact same requests
+# in the same order. Build replay_clnt and the servers first.
+
+cd "$(dirname "$0")/.." || exit 1
+
+[ $# -ge 1 ] || { echo "usage: $0 TRACE [speed] [server ...]"; exit 1; }
+TRACE=$1
+SPEED=${2:-1}
+[ $# -gt 0 ] && shift
+[ $# -gt 0 ] && shift
+[ $# -gt 0 ] || set -- ./e_svr ./s_svr ./t_svr
+PORT=7620
+LOG=$(mktemp)
+trap 'rm -f "$LOG"' EXIT
+
+# field of a histogram line of the replay
+pct() {
+    sed -n "s/^\[ $1 (us):.* $2=\([0-9.]*\).*/\1/p" "$LOG"
+}
+
+printf "%-24s %10s %10s %10s %10s %8s\n" server mean-us p50-us p99-us lag-p99 lost
+for srv in "$@"; do
+    $srv -q $PORT > /dev/null 2>&1 &
+    pid=$!
+    sleep 0.5
+    ./replay_clnt -s "$SPEED" "$TRACE" 127.0.0.1 $PORT > "$LOG" 2>&1
+    kill -INT $pid 2> /dev/null
+    wait $pid 2> /dev/null
+    lost=$(sed -n 's/^\[ Replay:.* \([0-9]*\) connections lost/\1/p' "$LOG")
+    printf "%-24s %10s %10s %10s %10s %8s\n" "$srv" "$(pct 'Request Latency' mean)" \
+        "$(pct 'Request Latency' p50)" "$(pct 'Request Latency' p99)" \
+        "$(pct 'Schedule Lag' p99)" "$lost"
+    PORT=$((PORT + 1))
+done
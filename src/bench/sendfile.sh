@@ -0,0 +1,42 @@
+#!/bin/sh
+#
+# sendfile.sh - e_svr file transfers with sendfile versus the buffered path
+#
+# usage: bench/sendfile.sh [seconds] [file MB]
+#
+# Serves one file from a temporary directory with "e_svr -f" and with
+# "e_svr -f -F", pulls it repeatedly with tcp_clnt -g and prints the
+# throughput next to the server's CPU time per transfer. Build e_svr,
+# tcp_clnt and res2csv first.
+
+cd "$(dirname "$0")/.." || exit 1
+
+SECS=${1:-3}
+MB=${2:-64}
+PORT=7410
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR" bench_sendfile.csv bench_sendfile.dat' EXIT
+
+dd if=/dev/zero of="$DIR/blob" bs=1048576 count="$MB" 2> /dev/null
+
+printf "%-10s %10s %10s %16s\n" mode files/s MB/s cpu-us/file
+for mode in sendfile buffered; do
+    flags="-f $DIR"
+    [ $mode = buffered ] && flags="$flags -F"
+
+    ./e_svr -c 250 $flags $PORT > "$DIR/svr.log" 2>&1 &
+    pid=$!
+    sleep 0.5
+
+    rm -f bench_sendfile.dat
+    ./tcp_clnt -d 2 -r 0 -g blob 127.0.0.1 $PORT "$SECS" bench_sendfile > /dev/null 2>&1
+    ./res2csv bench_sendfile.dat bench_sendfile.csv 2> /dev/null
+    kill -INT $pid
+    wait $pid 2> /dev/null
+
+    cpu=$(sed -n 's/^\[ CPU Time\/Request: \([0-9.]*\).*/\1/p' "$DIR/svr.log")
+    awk -F, -v mode=$mode -v cpu="$cpu" \
+        'NR > 1 { printf "%-10s %10.1f %10.1f %16s\n", mode, $5 / $3, $6 / $3 / 1048576, cpu }' \
+        bench_sendfile.csv
+    PORT=$((PORT + 1))
+done
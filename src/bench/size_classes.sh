@@ -0,0 +1,37 @@
+#!/bin/sh
+#
+# size_classes.sh - reply throughput of every server model per reply size class
+#
+# usage: bench/size_classes.sh [seconds] [depth]
+#
+# Runs each server on loopback and drives it with one pipelined tcp_clnt per
+# size, asking for "request N" replies. Build the servers, tcp_clnt and
+# res2csv first.
+
+cd "$(dirname "$0")/.." || exit 1
+
+SECS=${1:-3}
+DEPTH=${2:-8}
+PORT=7400
+SIZES="64 1024 16384 262144 1048576 4194304"
+
+printf "%-6s %9s %12s %10s %10s\n" server bytes req/s MB/s p50-us
+for svr in s_svr e_svr t_svr; do
+    ./$svr $PORT > /dev/null 2>&1 &
+    pid=$!
+    sleep 0.5
+
+    for size in $SIZES; do
+        rm -f bench_sizes.dat
+        ./tcp_clnt -d "$DEPTH" -r 0 -n "$size" 127.0.0.1 $PORT "$SECS" bench_sizes > /dev/null 2>&1
+        ./res2csv bench_sizes.dat bench_sizes.csv 2> /dev/null
+        awk -F, -v svr=$svr -v size="$size" \
+            'NR > 1 { printf "%-6s %9d %12.1f %10.1f %10s\n", svr, size, $5 / $3, $6 / $3 / 1048576, $8 }' \
+            bench_sizes.csv
+    done
+
+    kill -INT $pid
+    wait $pid 2> /dev/null
+    PORT=$((PORT + 1))
+done
+rm -f bench_sizes.csv bench_sizes.dat
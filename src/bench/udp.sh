@@ -0,0 +1,45 @@
+#!/bin/sh
+#
+# udp.sh - UDP request throughput and loss of e_svr at rising rates
+#
+# usage: bench/udp.sh [seconds] [start_rate] [max_rate] [size]
+#
+# Starts e_svr with -D, recvmmsg/sendmmsg batches, then with -G, the same
+# with UDP_GRO and UDP_SEGMENT, and runs udp_clnt against each, sending
+# single datagrams and then UDP_SEGMENT batches. Each row is one rate:
+# the datagrams per second sent and received and the share of requests
+# that got no reply. The server's datagrams per recvmmsg and sendmmsg
+# call follow each run. Build e_svr and udp_clnt first.
+
+cd "$(dirname "$0")/.." || exit 1
+
+SECS=${1:-2}
+RATE=${2:-20000}
+MAX=${3:-320000}
+SIZE=${4:-200}
+PORT=7550
+LOG=$(mktemp)
+SVR_LOG=$(mktemp)
+trap 'rm -f "$LOG" "$SVR_LOG"' EXIT
+
+printf "%-7s %-12s %10s %12s %12s %8s\n" server client rate sent/s received/s loss
+for mode in -D -G; do
+    for client in sendmmsg segment; do
+        ./e_svr -q $mode $PORT > "$SVR_LOG" 2>&1 &
+        pid=$!
+        sleep 0.5
+
+        opt=""
+        [ $client = segment ] && opt=-G
+        ./udp_clnt $opt -r "$RATE" -m "$MAX" -s "$SECS" -n "$SIZE" 127.0.0.1 $PORT > "$LOG" 2>&1
+        sed -n 's/^\[ Rate *\([0-9]*\)\/s: sent *\([0-9]*\)\/s, received *\([0-9]*\)\/s, loss *\([0-9.]*%\).*/\1 \2 \3 \4/p' "$LOG" |
+        while read rate sent received loss; do
+            printf "%-7s %-12s %10s %12s %12s %8s\n" "e_svr$mode" $client $rate $sent $received $loss
+        done
+
+        kill -INT $pid
+        wait $pid 2> /dev/null
+        sed -n 's/^\[ UDP Datagrams\/Call: \(.*\)/  server datagrams\/call: \1/p' "$SVR_LOG"
+        PORT=$((PORT + 1))
+    done
+done
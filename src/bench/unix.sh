@@ -0,0 +1,75 @@
+#!/bin/sh
+#
+# unix.sh - Unix domain sockets against TCP loopback for each server
+#
+# usage: bench/unix.sh [seconds] [clients] [depth] [probes]
+#
+# Starts e_svr, s_svr and t_svr in turn with -u, so each listens on a TCP
+# port and an abstract Unix socket at once, and measures both transports
+# on the same server: the idle round trip of probe_clnt, then the
+# requests per second and round trips of pipelined tcp_clnt connections.
+# The Unix rows carry the change against TCP in brackets. Build e_svr,
+# s_svr, t_svr, tcp_clnt, probe_clnt and res2csv first.
+
+cd "$(dirname "$0")/.." || exit 1
+
+SECS=${1:-5}
+CLIENTS=${2:-8}
+DEPTH=${3:-4}
+PROBES=${4:-5000}
+PORT=7530
+SOCK=@bench_unix
+LOG=$(mktemp)
+trap 'rm -f "$LOG" bench_unix.dat bench_unix.csv' EXIT
+
+# field value from the probe's round trip line
+pct() {
+    sed -n "s/^\[ Round Trip (ns):.* $1=\([0-9]*\).*/\1/p" "$LOG"
+}
+
+# the value and, on a Unix row, its change against the TCP row
+delta() {
+    if [ -z "$2" ]; then
+        printf "%s" "$1"
+    else
+        echo "$1 $2" | awk '{ printf "%s (%+.0f%%)", $1, ($2 > 0 ? ($1 - $2) * 100 / $2 : 0) }'
+    fi
+}
+
+printf "%-6s %-9s %16s %16s %16s %16s\n" server transport probe-p50-ns requests/s p50-us p99-us
+for svr in e_svr s_svr t_svr; do
+    ./$svr -q -u $SOCK $PORT > /dev/null 2>&1 &
+    pid=$!
+    sleep 0.5
+
+    base_probe="" base_rate="" base_p50="" base_p99=""
+    for transport in tcp unix; do
+        host=127.0.0.1
+        [ $transport = unix ] && host=$SOCK
+
+        ./probe_clnt -i 200 -n "$PROBES" $host $PORT > "$LOG" 2>&1
+        probe=$(pct p50)
+
+        rm -f bench_unix.dat
+        i=0
+        while [ $i -lt "$CLIENTS" ]; do
+            ./tcp_clnt -d "$DEPTH" -r 0 $host $PORT "$SECS" bench_unix > /dev/null 2>&1 &
+            i=$((i + 1))
+        done
+        sleep $((SECS + 2))
+
+        ./res2csv bench_unix.dat bench_unix.csv 2> /dev/null
+        set -- $(awk -F, -v s="$SECS" 'NR > 1 { c++; n += $5; p50 += $8; p99 += $9 }
+            END { if (c) printf "%.0f %.0f %.0f", n / s, p50 / c, p99 / c }' bench_unix.csv)
+
+        printf "%-6s %-9s %16s %16s %16s %16s\n" $svr $transport "$(delta "$probe" "$base_probe")" \
+            "$(delta "$1" "$base_rate")" "$(delta "$2" "$base_p50")" "$(delta "$3" "$base_p99")"
+        if [ $transport = tcp ]; then
+            base_probe=$probe base_rate=$1 base_p50=$2 base_p99=$3
+        fi
+    done
+
+    kill -INT $pid
+    wait $pid 2> /dev/null
+    PORT=$((PORT + 1))
+done
@@ -0,0 +1,51 @@
+#!/bin/sh
+#
+# writes.sh - reply write calls and TCP segments per request by pipeline depth
+#
+# usage: bench/writes.sh [seconds] [clients] [depths]
+#
+# Runs tcp_clnt connections against e_svr and s_svr at each pipeline depth,
+# text and binary, and reads the requests per second from the results and
+# the write calls and TCP data segments per request from the server's
+# statistics. A client that pipelines gets all the replies of a turn in
+# one sendmsg, so both counts fall as the depth grows. Build e_svr, s_svr,
+# tcp_clnt and res2csv first.
+
+cd "$(dirname "$0")/.." || exit 1
+
+SECS=${1:-3}
+CLIENTS=${2:-4}
+DEPTHS=${3:-"1 4 16 64"}
+PORT=7570
+LOG=$(mktemp)
+trap 'rm -f "$LOG" bench_writes.dat bench_writes.csv' EXIT
+
+printf "%-6s %-7s %6s %12s %14s %14s\n" server framing depth requests/s writes/request segs/request
+for svr in e_svr s_svr; do
+    for framing in text binary; do
+        opt=""
+        [ $framing = binary ] && opt=-x
+        for depth in $DEPTHS; do
+            ./$svr -q $PORT > "$LOG" 2>&1 &
+            pid=$!
+            sleep 0.5
+
+            rm -f bench_writes.dat
+            i=0
+            while [ $i -lt "$CLIENTS" ]; do
+                ./tcp_clnt $opt -d "$depth" -r 0 127.0.0.1 $PORT "$SECS" bench_writes > /dev/null 2>&1 &
+                i=$((i + 1))
+            done
+            sleep $((SECS + 2))
+            kill -INT $pid
+            wait $pid 2> /dev/null
+
+            ./res2csv bench_writes.dat bench_writes.csv 2> /dev/null
+            rate=$(awk -F, -v s="$SECS" 'NR > 1 { n += $5 } END { printf "%.0f", n / s }' bench_writes.csv)
+            writes=$(sed -n 's/^\[ Reply Writes\/Request: \([0-9.]*\).*/\1/p' "$LOG")
+            segs=$(sed -n 's/^\[ Segments\/Request: \([0-9.]*\).*/\1/p' "$LOG")
+            printf "%-6s %-7s %6s %12s %14s %14s\n" $svr $framing $depth "$rate" "$writes" "$segs"
+            PORT=$((PORT + 1))
+        done
+    done
+done
@@ -0,0 +1,190 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		churn_clnt.c - Connection churn benchmark client
+--
+--	PROGRAM:			churn_clnt
+--						./churn_clnt [-t threads] [-s seconds] [-R] HOST PORT
+--
+--	FUNCTIONS:			Berkeley Socket API
+--
+--	DATE:				October 19, 2026
+--
+--	PROGRAMMERS:		Jivanjot Brar & Shan Bains
+--
+--	NOTES:
+--	A few threads open a connection, send one "request", wait for the first
+--	byte of the reply and close the connection, as fast as they can. The
+--	program reports connections per second and the distributions of the
+--	connect time and of the time from the start of the connect to the first
+--	reply byte, which covers the server's accept and first request. -R closes
+--	with SO_LINGER 0, sending a RST instead of a FIN, so the client does not
+--	pile up TIME_WAIT sockets and run out of ephemeral ports. HOST may name
+--	a Unix socket instead, see unix_sock.c.
+--	Run the servers with -q so they do not log every connection.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+
+#define USAGE "Usage: %s [-t threads] [-s seconds] [-R] HOST PORT\n"
+
+typedef struct {
+    pthread_t tid;
+    unsigned long n_conns;
+    unsigned long n_errors;
+    hist connect_us;
+    hist first_byte_us;
+} churn_worker;
+
+struct sockaddr_in server_addr;
+const char *unix_path; // the server's Unix socket, NULL for TCP
+bool running = true;
+bool rst = false;
+
+/**
+ * now_us
+ *
+ * @return the monotonic clock in microseconds
+ */
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * churn
+ *
+ * Thread function opening and closing connections until the time is up.
+ *
+ * @param data the worker's statistics
+ */
+void* churn(void *data) {
+    churn_worker *w = (churn_worker *) data;
+    const char request[] = "request\n";
+    struct linger lg = {1, 0};
+    char rbuf[BUFLEN];
+    uint64_t start, connected;
+    int sd, n;
+
+    while (running) {
+        start = now_us();
+        if (unix_path != NULL) {
+            sd = unix_connect(unix_path);
+        } else if ((sd = socket(AF_INET, SOCK_STREAM, 0)) != -1 &&
+                connect(sd, (struct sockaddr *) &server_addr, sizeof (server_addr)) == -1) {
+            close(sd);
+            sd = -1;
+        }
+        if (sd == -1) {
+            w->n_errors++;
+            continue;
+        }
+        connected = now_us();
+
+        if (send(sd, request, sizeof (request) - 1, MSG_NOSIGNAL) != sizeof (request) - 1 ||
+                (n = recv(sd, rbuf, sizeof (rbuf), 0)) <= 0) {
+            w->n_errors++;
+            close(sd);
+            continue;
+        }
+        hist_add(&w->connect_us, connected - start);
+        hist_add(&w->first_byte_us, now_us() - start);
+
+        if (rst)
+            setsockopt(sd, SOL_SOCKET, SO_LINGER, &lg, sizeof (lg));
+        close(sd);
+        w->n_conns++;
+    }
+    return NULL;
+}
+
+/**
+ * main
+ *
+ * @param argc
+ * @param argv
+ * @return
+ */
+int main(int argc, char **argv) {
+    int i, opt, n_threads = 4, seconds = 10;
+    unsigned long n_conns = 0, n_errors = 0;
+    struct hostent *hp;
+    churn_worker *workers;
+    hist connect_us, first_byte_us;
+    uint64_t start, elapsed;
+
+    while ((opt = getopt(argc, argv, "t:s:R")) != -1) {
+        switch (opt) {
+            case 't':
+                n_threads = atoi(optarg); // connecting threads
+                break;
+            case 's':
+                seconds = atoi(optarg); // length of the run
+                break;
+            case 'R':
+                rst = true; // close with a RST
+                break;
+            default:
+                fprintf(stderr, USAGE, argv[0]);
+                exit(1);
+        }
+    }
+    if (argc - optind != 2 || n_threads < 1 || seconds < 1) {
+        fprintf(stderr, USAGE, argv[0]);
+        exit(1);
+    }
+
+    if (unix_name(argv[optind])) {
+        unix_path = argv[optind]; // the port is ignored
+    } else {
+        bzero((char *) &server_addr, sizeof (struct sockaddr_in));
+        server_addr.sin_family = AF_INET;
+        server_addr.sin_port = htons(atoi(argv[optind + 1]));
+        if ((hp = gethostbyname(argv[optind])) == NULL) {
+            fprintf(stderr, "Unknown server address\n");
+            exit(1);
+        }
+        bcopy(hp->h_addr, (char *) &server_addr.sin_addr, hp->h_length);
+    }
+
+    workers = calloc(n_threads, sizeof (churn_worker));
+    start = now_us();
+    for (i = 0; i < n_threads; i++) {
+        if (pthread_create(&workers[i].tid, NULL, churn, &workers[i]) != 0)
+            SystemFatal("pthread_create(): Failed");
+    }
+
+    sleep(seconds);
+    running = false;
+
+    hist_init(&connect_us);
+    hist_init(&first_byte_us);
+    for (i = 0; i < n_threads; i++) {
+        pthread_join(workers[i].tid, NULL);
+        n_conns += workers[i].n_conns;
+        n_errors += workers[i].n_errors;
+        hist_merge(&connect_us, &workers[i].connect_us);
+        hist_merge(&first_byte_us, &workers[i].first_byte_us);
+    }
+    elapsed = now_us() - start;
+
+    fprintf(stdout, "[ Connections: %lu (%lu errors) in %.2lf s, %d threads, %s close\n",
+            n_conns, n_errors, elapsed / 1e6, n_threads, rst ? "RST" : "FIN");
+    fprintf(stdout, "[ Connections/s: %.1lf\n", n_conns / (elapsed / 1e6));
+    hist_print(&connect_us, "Connect", "us");
+    hist_print(&first_byte_us, "Connect to First Byte", "us");
+
+    free(workers);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * SystemFatal
+ *
+ * Displays a perror message and exits the program.
+ *
+ * @param message takes in a string message
+ */
+void SystemFatal(const char* message) {
+    perror(message);
+    exit(EXIT_FAILURE);
+}
@@ -12,6 +12,10 @@
 extern "C" {
 #endif
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -28,15 +32,26 @@ extern "C" {
 #include <unistd.h>
 #include <signal.h>
 #include <pthread.h>
+#include <sched.h>
 #include <sys/time.h>
+#include <time.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 
 
 #define SERVER_TCP_PORT 7000	// Default port
 #define BUFLEN	1024		//Buffer length
-#define LISTENQ	5
+#define RECV_BUFLEN (16 * BUFLEN) //Per client receive buffer for pipelined requests
+#define REPLY_QUEUE_LEN 64      //Replies queued per client
+#define REPLY_MIN_SHIFT 6       //Smallest reply size class, 64 B
+#define REPLY_MAX_SHIFT 23      //Largest reply size class, 8 MB
+#define REPLY_CLASSES (REPLY_MAX_SHIFT - REPLY_MIN_SHIFT + 1)
+#define REPLY_CLASS_MAX (1 << REPLY_MAX_SHIFT)
+#define REPLY_MAX_LEN (8L * REPLY_CLASS_MAX) //Largest reply a client may request
+#define LISTENQ	SOMAXCONN // kernel caps it at net.core.somaxconn
 #define EPOLL_QUEUE_LEN 256
+#define EPOLL_MAX_EVENTS 4096   // upper bound of the adaptive epoll batch
 #define VAL(str) #str
 #define TOSTRING(str) VAL(str)
 
@@ -57,60 +72,619 @@ extern "C" {
         void *data;
     };
 
+    // cpu_cost.c
+    typedef struct _cpu_cost cpu_cost;
+
+    enum {
+        COST_CYCLES,
+        COST_INSTRUCTIONS,
+        COST_CACHE_MISSES,
+        COST_CTX_SWITCHES,
+        COST_SYSCALLS,
+        COST_NUM_COUNTERS
+    };
+
+    struct _cpu_cost {
+        int fd[COST_NUM_COUNTERS];
+        int interval_ms;
+        bool running;
+        pthread_t sampler;
+        pthread_mutex_t lock;
+        volatile unsigned long *requests;
+
+        /* values at the previous sample */
+        uint64_t last[COST_NUM_COUNTERS];
+        uint64_t last_cpu_us;
+        unsigned long last_requests;
+
+        /* deltas of intervals with and without requests */
+        uint64_t busy[COST_NUM_COUNTERS];
+        uint64_t idle[COST_NUM_COUNTERS];
+        uint64_t busy_cpu_us;
+        unsigned long n_samples;
+        unsigned long n_busy_samples;
+    };
+
+    // pubsub.c
+    typedef struct _ps_msg ps_msg;
+    typedef struct _ps_node ps_node;
+    typedef struct _pubsub pubsub;
+
+#define PUBSUB_MAX_NODES 256 // reactors joining the hub
+
+    enum {
+        PUBSUB_LAG, /* a slow subscriber misses messages */
+        PUBSUB_DROP /* a slow subscriber is disconnected */
+    };
+
+    // reply_cache.c
+    typedef struct _reply reply;
+    typedef struct _reply_cache reply_cache;
+
+    struct _reply {
+        const char *buf;
+        long len; /* -1 for a pipe sent until end of file */
+        int fd; /* file sent with sendfile/splice, -1 for buf */
+        bool owned; /* buf was allocated for the reply, freed once sent */
+        bool ends; /* the last entry of a traced request's reply, see client_owe */
+        ps_msg *msg; /* the broadcast buf belongs to, see pubsub.c */
+    };
+
+    struct _reply_cache {
+        const char *legacy;
+        char *buf[REPLY_CLASSES];
+        unsigned long n_replies[REPLY_CLASSES];
+        unsigned long long n_bytes[REPLY_CLASSES];
+    };
+
+    // overload.c
+    typedef struct _overload overload;
+
+#define OVERLOAD_BUSY_REPLY "busy\n" // answer to a shed request
+#define OVERLOAD_BUSY_LEN 5
+
+    /* what a loop does with work while it lags */
+    enum {
+        OVERLOAD_REJECT, /* reset new connections */
+        OVERLOAD_BUSY /* answer requests with the busy reply */
+    };
+
+    // coro.c
+    typedef struct _coro coro;
+    typedef struct _coro_pool coro_pool;
+
+#define CORO_STACK_SIZE (64 * 1024)
+
+    // tcp_sample.c
+    typedef struct _tcp_sampler tcp_sampler;
+
+#define TCP_SAMPLE_PER_ROUND 16 // connections sampled per interval
+
+    // trace.c
+    typedef struct _trace trace;
+    typedef struct _trace_hdr trace_hdr;
+    typedef struct _trace_rec trace_rec;
+
+#define TRACE_MAGIC 0x45435254 // "TRCE"
+
+    enum {
+        TRACE_CONNECT,
+        TRACE_REQUEST, /* any command, see trace_request */
+        TRACE_CLOSE,
+        TRACE_TEXT /* the text of the command before it */
+    };
+
+    // workload.c
+    typedef struct _dist dist;
+    typedef struct _workload workload;
+
+#define WORKLOAD_PAYLOAD_MAX 16384 // a request the socket buffer always takes
+
+    enum {
+        DIST_FIXED,
+        DIST_UNIFORM,
+        DIST_EXP,
+        DIST_PARETO
+    };
+
+    /* arrival rate curves, see workload.c */
+    enum {
+        CURVE_CONST,
+        CURVE_RAMP,
+        CURVE_STEP,
+        CURVE_SINE,
+        CURVE_BURST
+    };
+
+    // kv.c
+    typedef struct _kv kv;
+
+#define KV_KEY_MAX 250
+#define KV_VALUE_MAX (8 * 1024) // a "set" fits the receive buffer
+#define KV_REPLY_MAX (KV_VALUE_MAX + 16) // value and its length line
+
+    // udp.c
+    typedef struct _udp_server udp_server;
+    typedef struct _udp_stats udp_stats;
+
+#define UDP_BATCH 64 // datagrams per recvmmsg and sendmmsg
+#define UDP_MAX_SEGS 64 // datagrams coalesced by UDP_GRO or split by UDP_SEGMENT
+#define UDP_SEG_MAX 1472 // largest reply sent with UDP_SEGMENT, one Ethernet frame
+#define UDP_REPLY_MAX 65507 // largest reply datagram
+
+    struct _udp_stats {
+        unsigned long n_rx; /* request datagrams */
+        unsigned long n_tx; /* reply datagrams */
+        unsigned long n_rx_calls;
+        unsigned long n_tx_calls;
+        unsigned long n_gro; /* received buffers holding several datagrams */
+        unsigned long n_gso; /* sent buffers split into several datagrams */
+        unsigned long n_dropped; /* replies the socket had no room for */
+    };
+
+    /* a reactor's UDP socket and its batches, see udp.c */
+    struct _udp_server {
+        int fd;
+        bool gso;
+        int rx_buflen; /* a datagram, or a UDP_GRO buffer of several */
+        struct mmsghdr *rx;
+        struct iovec *rx_iov;
+        struct sockaddr_in *names; /* the senders, the replies' destinations */
+        char *rx_bufs;
+        char *rx_ctl;
+        struct mmsghdr *tx;
+        struct iovec *tx_iov;
+        char *tx_ctl;
+        int n_tx; /* replies batched for the next sendmmsg */
+        int n_tx_iov;
+        udp_stats stats;
+    };
+
     // s_svr.c
     typedef struct _client client;
+    typedef struct _client_cold client_cold;
     typedef struct _server server;
+    typedef struct _prefork_slot prefork_slot;
 
+#define CACHE_LINE 64
+
+    /* what every event on the client reads, packed into one cache line; the
+     * client is allocated as one block of this line, the reply ring, the
+     * cold state and the receive buffer, see client_new */
     struct _client {
         int fd;
-        int n_bytes_received;
-        pthread_t tid;
+        int file_fd; /* file in flight, see file_serve.c */
+        int rlen; /* partially received requests in rbuf */
+        int reply_head;
+        int n_pending;
+        bool quit;
+        bool file_pipe;
+        bool ready; /* on the server's ready list, see process_client_req */
+        bool binary; /* negotiated the binary framing, see proto.c */
+        long reply_off;
+        char *rbuf;
+        reply *replies; /* replies owed to the client, REPLY_QUEUE_LEN ring */
+        client_cold *cold;
+        coro *co; /* the client's handler with -C, see coro.c */
+    } __attribute__((aligned(CACHE_LINE)));
+
+    _Static_assert(sizeof (struct _client) == CACHE_LINE, "client hot state outgrew its cache line");
+
+    /* used when the client connects or asks for a file */
+    struct _client_cold {
         struct sockaddr_in sa;
         socklen_t sa_len;
-        bool quit;
+        char file_hdr[24];
+        server *s; /* the reactor a coroutine handler runs on */
+        client *next_ready;
+        char *frames; /* reply headers of the binary framing, one per ring slot */
+        int sub; /* place among the reactor's subscribers, -1 for none */
+        uint32_t trace_id; /* the connection's number in the trace, see trace.c */
+        int n_owed; /* traced requests with replies not all sent */
+    };
+
+    // proto.c
+    typedef struct _proto_req proto_req;
+
+    enum {
+        CMD_UNKNOWN,
+        CMD_REQUEST,
+        CMD_QUIT,
+        CMD_GET,
+        CMD_SET, /* "set KEY VALUE", with the key value cache */
+        CMD_DEL, /* "del KEY" */
+        CMD_SUBSCRIBE, /* "subscribe", with the broadcast */
+        CMD_PUBLISH, /* "publish MESSAGE" */
+        CMD_BINARY, /* "binary N", switch to the binary framing version N */
+        CMD_NONE, /* no complete request buffered */
+        CMD_INVALID /* a frame that cannot be parsed, the stream is lost */
+    };
+
+    /* binary framing: a 12 byte header in network byte order, version,
+     * opcode, 2 reserved bytes, payload length and request id, then the
+     * payload. A request's payload starts with the reply length, 0 for the
+     * BUFLEN reply, and may carry any data after it. */
+#define PROTO_BIN_VERSION 1
+#define FRAME_HDR_LEN 12
+#define FRAME_MAX_PAYLOAD (RECV_BUFLEN - FRAME_HDR_LEN)
+
+    enum {
+        OP_REQUEST = 0x01,
+        OP_QUIT = 0x02,
+        OP_REPLY = 0x81,
+        OP_BUSY = 0x82,
+        OP_ERROR = 0x83
     };
 
+    /* newline scan kernels, see proto_scan_use */
+    enum {
+        SCAN_SCALAR,
+        SCAN_SSE2,
+        SCAN_AVX2
+    };
+
+    /* one request of either framing */
+    struct _proto_req {
+        int type;
+        long arg; /* reply length, framing version or file name or key offset */
+        uint32_t id; /* echoed in the reply header, 0 for text */
+        char *cmd; /* the command text or the frame's payload */
+        int cmd_len;
+    };
+
+    /* how several reactors or workers wait for connections */
+    enum {
+        ACCEPT_SHARE, /* one listen socket in every epoll set */
+        ACCEPT_EXCL, /* one listen socket, added with EPOLLEXCLUSIVE */
+        ACCEPT_REUSEPORT /* a SO_REUSEPORT listen socket each */
+    };
+
+    /* grouped by how often the fields are written, so the counters the
+     * loop bumps on every event do not share lines with the configuration */
     struct _server {
+        /* read on every event, written at start up */
         int listen_sd;
+        int unix_sd; /* Unix stream listen socket, -1 for none */
+        int epoll_fd;
         int maxfd;
         int port;
+        int spin_us;
+        int file_dir;
+        kv *kv; /* "get", "set" and "del" use the cache, NULL for files */
+        pubsub *ps; /* "subscribe" and "publish", NULL for none */
+        tcp_sampler *tcp_samples; /* this loop's TCP_INFO samples, NULL for none */
+        trace *trace; /* what the clients do is recorded with -R, NULL for none */
+        ps_node *ps_local; /* this reactor's subscribers */
+        bool running;
+        bool quiet; /* no per-connection log lines */
+        bool incoming_cpu; /* steer connections with SO_INCOMING_CPU */
+        bool tcp; /* listen on the TCP port, not only on unix_path */
+        const char *unix_path; /* see unix_sock.c, NULL for none */
+        struct epoll_event *events;
+        reply_cache *replies;
+        server *parent; /* the server a reactor adds its requests to */
+        prefork_slot *slot; /* a prefork worker's shared counters */
+        int accept_mode; /* how reactors and workers wait on the listen socket */
+        bool coroutines; /* run each client's handler on a coroutine */
+        overload *load; /* admission control, NULL for none */
+        int budget; /* requests per client per turn, 0 to drain the socket */
+        bool udp; /* serve request datagrams on the port as well */
+        bool udp_gso; /* with UDP_GRO and UDP_SEGMENT */
+        udp_server *udp_srv; /* this reactor's UDP socket */
+        coro_pool *coros; /* this reactor's coroutine stacks */
+        cpu_cost *cost;
+        pid_t pid;
+
+        /* loop state and counters, written on every event */
+        int num_fds __attribute__((aligned(CACHE_LINE)));
+        int batch_size;
+        int max_batch_size;
         int n_clients;
         int n_max_connected;
         int n_max_bytes_received;
-        pid_t pid;
-        bool running;
-        pthread_mutex_t dataLock;
-
-        /* for epoll on client connections */
-        int epoll_fd;
-        int num_fds;
-        struct epoll_event events[EPOLL_QUEUE_LEN];
+        volatile unsigned long n_requests;
+        unsigned long n_wakeups;
+        unsigned long n_events;
+        unsigned long n_spin_wakeups;
+        unsigned long n_listen_wakeups;
+        unsigned long n_accept_misses; /* listen wakeups without a connection */
+        uint64_t wake_ns; /* when the loop last woke, with admission control */
+        unsigned long n_deferred; /* turns cut short by the budget */
+        unsigned long n_write_calls; /* sendmsg and file calls writing replies */
+        unsigned long n_segs_out; /* TCP data segments of the closed connections */
+        client *ready_head; /* clients with work left, served in turn */
+        client *ready_tail;
+        udp_stats udp_total; /* of every reactor or worker, when printing */
         struct epoll_event event;
         llist *e_client_list;
+        llist *client_list;
+
+        /* taken per connection by e_svr and per loop by s_svr */
+        pthread_mutex_t dataLock __attribute__((aligned(CACHE_LINE)));
+
+        /* reactor threads, see affinity.c */
+        cpu_set_t cpus __attribute__((aligned(CACHE_LINE))); /* CPUs the threads are pinned to, empty for none */
+        int cpu; /* this reactor's CPU, -1 when not pinned */
+        int node; /* this reactor's NUMA node, -1 when unknown */
+        int n_workers; /* reactors with their own listen socket */
+        server **workers;
+        pthread_t tid;
+        pid_t task; /* kernel thread id of the loop */
+
+        /* prefork worker processes, see prefork.c */
+        int n_procs;
+        prefork_slot *slots;
 
         /* for select on client connections*/
         fd_set allset;
-        llist *client_list;
+        fd_set writeset;
         //int clients[FD_SETSIZE];
         //client *clientConn[FD_SETSIZE];
     };
 
+    // prefork.c
+    /* one per worker in a shared mapping, written by the worker only */
+    struct _prefork_slot {
+        pid_t pid;
+        int restarts;
+        int n_active;
+        unsigned long n_connected;
+        unsigned long n_requests;
+        unsigned long n_bytes;
+        unsigned long n_wakeups;
+        unsigned long n_events;
+        unsigned long n_listen_wakeups;
+        unsigned long n_accept_misses;
+        unsigned long n_rejected;
+        unsigned long n_busy;
+        unsigned long n_deferred;
+        unsigned long n_write_calls;
+        unsigned long n_segs_out;
+        udp_stats udp;
+        unsigned long n_task_wakeups; /* of the exited workers, kept by the master */
+        unsigned long cpu_us; /* of the exited workers, kept by the master */
+    } __attribute__((aligned(CACHE_LINE)));
+
     // tcp_clnt.c
     typedef struct _data data;
 
     struct _data {
         int numOfRequests;
-        int dataSent;
+        long dataSent;
         int interval;
         int sd;
         double time;
         char sendBuff[BUFLEN];
         struct timeval start;
         struct timeval end;
+
+        /* pipelined mode */
+        int depth; /* requests in flight on the connection */
+        int batch; /* requests coalesced into one write */
+        int rate; /* requests per second, 0 for as fast as possible */
+        int payload; /* bytes per request, NUL padded */
+        int replySize; /* bytes asked for per request, 0 for the BUFLEN reply */
+        char *file; /* file asked for per request instead */
+        int numOfReplies;
+        long dataReceived;
+        unsigned int *latency; /* round trip of every request in microseconds */
+        int numOfBusy; /* requests the server answered busy */
+        bool binary; /* requests and replies are frames, see proto.c */
+        int latencyCap;
+    };
+
+    // reslog.c
+    typedef struct _reslog_hdr reslog_hdr;
+    typedef struct _reslog_rec reslog_rec;
+    typedef struct _reslog reslog;
+
+#define RESLOG_MAGIC 0x474c5352 // "RSLG"
+#define RESLOG_CAPACITY 65536 // results in a log created by tcp_clnt or clnt
+
+    struct _reslog_hdr {
+        uint32_t magic;
+        uint32_t record_size;
+        uint32_t capacity;
+        uint32_t next; /* next free record, claimed with fetch-add */
+        uint32_t dropped;
+        uint32_t pad[11]; /* records start on their own cache line */
+    };
+
+    struct _reslog_rec {
+        int32_t pid;
+        int32_t requests;
+        int32_t replies;
+        uint32_t valid; /* set last, once the record is filled */
+        int64_t dataSent;
+        int64_t dataReceived;
+        double time;
+        double meanLatency;
+        uint32_t p50Latency;
+        uint32_t p99Latency;
+        uint32_t maxLatency;
+        uint32_t busy; /* requests answered busy, see overload.c */
+    };
+
+    struct _reslog {
+        reslog_hdr *hdr;
+        reslog_rec *rec;
+        size_t size;
+    };
+
+    // trace.c
+    struct _trace_hdr {
+        uint32_t magic;
+        uint32_t record_size;
+        uint32_t pad[2];
+    };
+
+    struct _trace_rec {
+        union {
+            struct {
+                uint32_t delta_us; /* since the record before */
+                uint32_t conn; /* numbered in order of arrival */
+                uint32_t arg;
+            };
+            char text[12]; /* of a TRACE_TEXT record */
+        };
+        uint8_t kind;
+        uint8_t cmd; /* the CMD_ type of a request */
+        uint16_t len; /* its bytes on the wire, or the bytes of text */
+        uint8_t depth; /* earlier requests of the connection not answered */
+        uint8_t binary; /* the request is a frame */
+        uint8_t pad[2];
+    };
+
+    struct _trace {
+        FILE *f;
+        const char *path;
+        pthread_mutex_t lock;
+        uint64_t last_us; /* time of the last record */
+        uint32_t next_conn;
+        unsigned long n_records[TRACE_TEXT + 1];
+        unsigned long n_failed;
+    };
+
+    // workload.c
+    struct _dist {
+        int kind;
+        double a, b; /* the value, bounds, mean or minimum and shape */
+    };
+
+    struct _workload {
+        uint64_t seed;
+        double duration; /* seconds of arrivals, 0 until stopped */
+        int curve;
+        double c[4]; /* the curve's parameters */
+        bool poisson; /* arrivals drawn around the rate, not evenly spaced */
+        dist session; /* seconds */
+        double session_max;
+        double rate; /* requests per second per session, 0 unpaced */
+        dist size; /* reply bytes, 0 for BUFLEN */
+        int payload; /* bytes of each request with its NUL padding */
+        uint64_t rng; /* the arrivals' random stream */
+        double t; /* time of the last arrival */
+        double burst_start, burst_end;
+    };
+
+    // hist.c
+    typedef struct _hist hist;
+
+#define HIST_SUB_BITS 4 // linear steps per power of two, as a shift
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+    struct _hist {
+        uint64_t count;
+        uint64_t sum;
+        uint64_t max;
+        uint64_t bucket[HIST_BUCKETS];
+    };
+
+    // overload.c
+    struct _overload {
+        uint64_t limit_ns; /* smoothed lag above which the loop sheds */
+        int policy;
+        bool shedding;
+        uint64_t lag_ns; /* smoothed lag */
+        uint64_t probe_ns; /* last connection let through while rejecting */
+        uint64_t idle_ns; /* since when no lag was sampled, see overload_idle */
+        uint64_t idle_mark; /* samples taken by then */
+        unsigned long n_episodes;
+        unsigned long n_rejected;
+        unsigned long n_busy;
+        unsigned long n_queue_samples;
+        unsigned long queue_sum;
+        int max_queue;
+        hist lag;
+    };
+
+    // tcp_sample.c
+    struct _tcp_sampler {
+        uint64_t interval_ns;
+        uint64_t next_ns; /* when the next round is due */
+        int per_round;
+        node *cursor; /* the client the next round starts with */
+        unsigned long n_rounds;
+        unsigned long n_samples;
+        unsigned long n_failed; /* Unix sockets and closed connections */
+        hist rtt; /* smoothed round trip time, us */
+        hist retrans; /* segments retransmitted over the connection's life */
+        hist unacked; /* segments in flight */
+        hist notsent; /* bytes in the send queue not sent yet */
+        hist cwnd; /* congestion window, segments */
     };
 
+    // pubsub.c
+    /* a published message, written once and shared by the replies */
+    struct _ps_msg {
+        int refs; /* replies and reactors holding it */
+        long len;
+        uint64_t published_ns;
+        pubsub *hub;
+        char data[];
+    };
+
+    /* a reactor's subscribers and the messages handed to it */
+    struct _ps_node {
+        int efd; /* eventfd, in the reactor's epoll set */
+        pubsub *hub;
+        client **subs;
+        int n_subs;
+        int cap_subs;
+        int max_subs;
+        unsigned long n_published;
+        unsigned long n_delivered; /* messages queued on subscribers */
+        unsigned long n_lagged; /* messages a slow subscriber missed */
+        unsigned long n_dropped; /* slow subscribers disconnected */
+
+        /* written by the other reactors */
+        pthread_mutex_t lock __attribute__((aligned(CACHE_LINE)));
+        ps_msg **inbox;
+        int n_inbox;
+        int cap_inbox;
+    };
+
+    struct _pubsub {
+        int depth; /* replies a subscriber may have queued */
+        int policy;
+        pthread_mutex_t lock;
+        int n_nodes;
+        ps_node *nodes[PUBSUB_MAX_NODES];
+        hist fanout; /* from publishing to the last write, in ns */
+    };
+
+    // FUNCTION PROTOTYPES reslog.c
+    reslog* reslog_create(const char *, int);
+    reslog* reslog_open(const char *);
+    void reslog_close(reslog *);
+    reslog_rec* reslog_claim(reslog *);
+    void reslog_commit(reslog_rec *);
+    int reslog_to_csv(reslog *, FILE *);
+
+    // FUNCTION PROTOTYPES hist.c
+    void hist_init(hist *);
+    void hist_add(hist *, uint64_t);
+    void hist_merge(hist *, const hist *);
+    uint64_t hist_percentile(const hist *, double);
+    void hist_print(const hist *, const char *, const char *);
+
+    // FUNCTION PROTOTYPES overload.c
+    uint64_t overload_now(void);
+    overload* overload_new(const char *);
+    overload* overload_clone(const overload *);
+    void overload_lag(overload *, uint64_t);
+    void overload_queue(overload *, int);
+    bool overload_admit(overload *, int);
+    bool overload_busy(overload *);
+    void overload_idle(overload *, uint64_t);
+    void overload_merge(overload *, const overload *);
+    void overload_print(overload *);
+
     // FUNCTION PROTOTYPES tcp_clnt.c
     void connect_to_server(data *, char *, int);
+    bool negotiate_binary(data *);
+    void send_requests(data *);
     void print_client_data(data *);
     void signal_handler(int);
 
@@ -123,16 +697,150 @@ extern "C" {
     int llist_length(llist *l);
     bool llist_is_empty(llist *l);
 
+    // FUNCTION PROTOTYPES cpu_cost.c
+    cpu_cost* cpu_cost_new(int, volatile unsigned long *);
+    void cpu_cost_start(cpu_cost *);
+    void cpu_cost_sample(cpu_cost *);
+    void cpu_cost_print(cpu_cost *);
+    unsigned long cpu_task_wakeups(pid_t, pid_t);
+
+    // FUNCTION PROTOTYPES proto.c
+    const char* proto_scan_use(int);
+    int proto_next_cmd(char *, int, char **, int *);
+    int proto_parse_cmd(const char *, int, long *);
+    int proto_next_frame(char *, int, proto_req *);
+    int proto_next_req(bool, char *, int, proto_req *);
+    int proto_wire_len(bool, const char *, int, int);
+    void proto_frame_hdr(char *, int, uint32_t, uint32_t);
+    void client_queue_frame_hdr(client *, int, uint32_t, uint32_t);
+    bool client_queue_status(client *, int, uint32_t);
+    bool client_negotiate(client *, long);
+    int client_fill(client *);
+    void client_consume(client *, int);
+    void client_queue_reply(client *, const char *, long);
+    void client_owe(client *, int);
+    bool client_flush(client *, server *);
+    unsigned long client_segs_out(int);
+    void client_flush_print(server *);
+    void client_drop_replies(client *);
+
+    // FUNCTION PROTOTYPES affinity.c
+    int affinity_parse(const char *, cpu_set_t *);
+    int affinity_cpu(const cpu_set_t *, int);
+    int affinity_pin(int);
+    int affinity_node(int);
+    void* affinity_alloc(size_t, int);
+    void affinity_free(void *, size_t);
+
+    // FUNCTION PROTOTYPES coro.c
+    coro_pool* coro_pool_new(size_t);
+    coro* coro_new(coro_pool *, void (*)(void *), void *);
+    void coro_free(coro_pool *, coro *);
+    bool coro_resume(coro_pool *, coro *);
+    void coro_yield(void);
+    void coro_pool_print(coro_pool *);
+    ssize_t co_read(int, void *, size_t);
+    ssize_t co_write(int, const void *, size_t);
+    ssize_t co_send(int, const void *, size_t, int);
+
+    // FUNCTION PROTOTYPES prefork.c
+    void prefork_run(server *, int);
+    void prefork_publish(server *);
+    void prefork_stop(server *);
+    void prefork_print(server *);
+
+    // FUNCTION PROTOTYPES unix_sock.c
+    bool unix_name(const char *);
+    int unix_listen(const char *);
+    int unix_connect(const char *);
+    int unix_connect_start(const char *);
+    void unix_unlink(const char *);
+
+    // FUNCTION PROTOTYPES kv.c
+    kv* kv_new(long);
+    void kv_free(kv *);
+    int kv_get(kv *, const char *, int, char *);
+    bool kv_set(kv *, const char *, int, const char *, int);
+    bool kv_del(kv *, const char *, int);
+    int kv_reply(kv *, proto_req *, char *, const char **);
+    bool client_queue_kv(client *, kv *, proto_req *);
+    void kv_print(kv *);
+
+    // FUNCTION PROTOTYPES pubsub.c
+    pubsub* pubsub_new(const char *);
+    ps_node* pubsub_join(pubsub *);
+    void ps_msg_put(ps_msg *, int);
+    bool pubsub_subscribe(ps_node *, client *);
+    void pubsub_leave(ps_node *, client *);
+    bool pubsub_publish(server *, client *, proto_req *);
+    void pubsub_deliver(server *);
+    void pubsub_print(pubsub *);
+
+    // FUNCTION PROTOTYPES tcp_sample.c
+    tcp_sampler* tcp_sampler_new(const char *);
+    tcp_sampler* tcp_sampler_clone(const tcp_sampler *);
+    bool tcp_sample_fd(tcp_sampler *, int, pthread_mutex_t *);
+    void tcp_sample_round(tcp_sampler *, llist *);
+    void tcp_sample_forget(tcp_sampler *, client *);
+    int tcp_sample_wait(tcp_sampler *);
+    void tcp_sample_merge(tcp_sampler *, const tcp_sampler *);
+    void tcp_sample_print(tcp_sampler *);
+
+    // FUNCTION PROTOTYPES trace.c
+    trace* trace_new(const char *);
+    void trace_event(trace *, uint32_t, int, uint32_t);
+    void trace_request(trace *, uint32_t, const proto_req *, bool, int, int);
+    uint32_t trace_connect(trace *);
+    trace_rec* trace_load(const char *, long *);
+    void trace_print(trace *);
+
+    // FUNCTION PROTOTYPES workload.c
+    void workload_init(workload *);
+    uint64_t workload_seed(uint64_t, uint64_t);
+    double workload_uniform(uint64_t *);
+    double dist_sample(const dist *, uint64_t *);
+    double workload_rate(workload *, double);
+    void workload_start(workload *);
+    double workload_next_arrival(workload *);
+    int workload_set(workload *, const char *);
+    int workload_load(workload *, const char *);
+    void workload_print(const workload *, FILE *);
+
+    // FUNCTION PROTOTYPES udp.c
+    udp_server* udp_new(int, bool);
+    void udp_serve(server *, udp_server *);
+    void udp_merge(udp_stats *, const udp_stats *);
+    void udp_print(udp_stats *, bool);
+
+    // FUNCTION PROTOTYPES file_serve.c
+    extern bool file_buffered;
+    bool client_queue_file(client *, int, const char *, int);
+    ssize_t file_send(client *, reply *);
+
+    // FUNCTION PROTOTYPES reply_cache.c
+    reply_cache* reply_cache_new(const char *);
+    int reply_class(int);
+    const char* reply_cache_get(reply_cache *, int);
+    void reply_cache_print(reply_cache *);
+    bool client_queue_request(client *, reply_cache *, long, uint32_t);
+
     // FUNCTION PROTOTYPES s_svr.c & e_svr.c
     void SystemFatal(const char*);
     void signal_Handler(int);
     server* server_new(void);
+    server* server_worker(server *, int);
+    int accept_mode(const char *);
     void server_init(server *);
     void* client_manager(void *);
+    int wait_for_events(server *);
     void read_from_socket(server *);
+    void client_ready(server *, client *);
+    void serve_ready(server *);
+    void client_remove(server *, client *);
     client* client_new(void);
     void process_client_data(client *, server *);
     void process_client_req(client *, server *);
+    void process_client_coro(void *);
     void print_server_data(server *);
 
 
@@ -0,0 +1,190 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		coro_bench.c - Cost of a coroutine switch against a callback
+--
+--	PROGRAM:			coro_bench
+--						./coro_bench [-n iterations] [-c coroutines]
+--
+--	FUNCTIONS:			clock_gettime, swapcontext
+--
+--	DATE:				October 19, 2026
+--
+--	PROGRAMMERS:		Jivanjot Brar & Shan Bains
+--
+--	NOTES:
+--	Times the step e_svr takes for a client event in each mode: a call
+--	through a function pointer for the callback handlers, a coro_resume and
+--	the coro_yield back for -C, and for comparison a swapcontext pair, the
+--	portable switch coro.c falls back to. The coroutines are resumed in turn
+--	so their stacks are spread over memory like those of many clients, and
+--	the creation and release of a pooled coroutine is timed as well.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+#include <ucontext.h>
+
+#define USAGE "Usage: %s [-n iterations] [-c coroutines]\n"
+
+static volatile unsigned long counter;
+static ucontext_t main_ctx, uc_ctx;
+
+/**
+ * now_ns
+ *
+ * @return the monotonic clock in nanoseconds
+ */
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * step
+ *
+ * The work of one event in the callback mode, kept out of line.
+ */
+static void __attribute__((noinline)) step(void *arg) {
+    (void) arg;
+    counter++;
+}
+
+/**
+ * step_coro
+ *
+ * The same work in a loop that yields after each step.
+ */
+static void step_coro(void *arg) {
+    (void) arg;
+    for (;;) {
+        counter++;
+        coro_yield();
+    }
+}
+
+/**
+ * step_once
+ *
+ * Returns at once, for timing the creation of a coroutine.
+ */
+static void step_once(void *arg) {
+    (void) arg;
+}
+
+/**
+ * step_ucontext
+ *
+ * The same work switching with swapcontext.
+ */
+static void step_ucontext(void) {
+    for (;;) {
+        counter++;
+        swapcontext(&uc_ctx, &main_ctx);
+    }
+}
+
+/**
+ * main
+ *
+ * @param argc
+ * @param argv
+ * @return
+ */
+int main(int argc, char **argv) {
+    void (*volatile callback)(void *) = step;
+    int opt, i, n_coros = 1000;
+    long n = 10000000;
+    uint64_t start, end;
+    coro_pool *pool;
+    coro **co, *c;
+    char *stack;
+
+    while ((opt = getopt(argc, argv, "n:c:")) != -1) {
+        switch (opt) {
+            case 'n':
+                n = atol(optarg); // switches timed
+                break;
+            case 'c':
+                n_coros = atoi(optarg); // coroutines resumed in turn
+                break;
+            default:
+                fprintf(stderr, USAGE, argv[0]);
+                exit(1);
+        }
+    }
+    if (optind != argc || n < 1 || n_coros < 1) {
+        fprintf(stderr, USAGE, argv[0]);
+        exit(1);
+    }
+
+    if ((pool = coro_pool_new(CORO_STACK_SIZE)) == NULL ||
+            (co = malloc(n_coros * sizeof (coro *))) == NULL)
+        SystemFatal("malloc(): Failed");
+    for (i = 0; i < n_coros; i++) {
+        if ((co[i] = coro_new(pool, step_coro, NULL)) == NULL)
+            SystemFatal("coro_new(): Failed");
+    }
+
+    start = now_ns();
+    for (i = 0; i < n; i++)
+        callback(NULL);
+    end = now_ns();
+    fprintf(stdout, "[ Callback: %.2lf ns\n", (double) (end - start) / n);
+
+    /* first resumes fault the stacks in, outside the timing */
+    for (i = 0; i < n_coros; i++)
+        coro_resume(pool, co[i]);
+    start = now_ns();
+    for (i = 0; i < n; i++)
+        coro_resume(pool, co[i % n_coros]);
+    end = now_ns();
+    fprintf(stdout, "[ Coroutine Resume+Yield (%d coroutines): %.2lf ns\n",
+            n_coros, (double) (end - start) / n);
+
+    start = now_ns();
+    for (i = 0; i < n; i++)
+        coro_resume(pool, co[0]);
+    end = now_ns();
+    fprintf(stdout, "[ Coroutine Resume+Yield (1 coroutine): %.2lf ns\n",
+            (double) (end - start) / n);
+
+    if ((stack = malloc(CORO_STACK_SIZE)) == NULL)
+        SystemFatal("malloc(): Failed");
+    getcontext(&uc_ctx);
+    uc_ctx.uc_stack.ss_sp = stack;
+    uc_ctx.uc_stack.ss_size = CORO_STACK_SIZE;
+    makecontext(&uc_ctx, step_ucontext, 0);
+    swapcontext(&main_ctx, &uc_ctx);
+    start = now_ns();
+    for (i = 0; i < n; i++)
+        swapcontext(&main_ctx, &uc_ctx);
+    end = now_ns();
+    fprintf(stdout, "[ swapcontext Pair: %.2lf ns\n", (double) (end - start) / n);
+
+    /* a pooled stack per connection: take, run to the end, give back */
+    start = now_ns();
+    for (i = 0; i < n / 10; i++) {
+        c = coro_new(pool, step_once, NULL);
+        coro_resume(pool, c);
+        coro_free(pool, c);
+    }
+    end = now_ns();
+    fprintf(stdout, "[ Pooled Coroutine Create+Run+Free: %.2lf ns\n",
+            (double) (end - start) / (n / 10 > 0 ? n / 10 : 1));
+
+    coro_pool_print(pool);
+    free(stack);
+    free(co);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * SystemFatal
+ *
+ * Displays a perror message and exits the program.
+ *
+ * @param message takes in a string message
+ */
+void SystemFatal(const char* message) {
+    perror(message);
+    exit(EXIT_FAILURE);
+}
@@ -0,0 +1,311 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		cpu_cost.c - CPU cost accounting for the servers
+--
+--	FUNCTIONS:			getrusage, perf_event_open
+--
+--	DATE:				October 19, 2026
+--
+--	NOTES:
+--	Samples getrusage and, when the kernel allows it, perf_event_open counters
+--	(cycles, instructions, cache misses, context switches and syscalls) at a
+--	fixed interval. Counter deltas of every interval are attributed to the
+--	requests the server handled during that interval, so the servers can
+--	report cycles/request and syscalls/request next to their other statistics.
+--	Counters that cannot be opened (no PMU in a VM, perf_event_paranoid, no
+--	tracefs) are reported as n/a; context switches fall back to getrusage.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+
+static const char *cost_names[COST_NUM_COUNTERS] = {
+    "Cycles", "Instructions", "Cache Misses", "Context Switches", "Syscalls"
+};
+
+/**
+ * perf_open
+ *
+ * Opens one counting perf event for this process and every thread it creates
+ * afterwards. Retries with kernel counting disabled when the paranoid level
+ * only allows user space measurement.
+ *
+ * @param type perf event type
+ * @param config perf event config for the type
+ * @return the perf file descriptor, or -1 if the counter is not available
+ */
+static int perf_open(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    int fd;
+
+    memset(&attr, 0, sizeof (attr));
+    attr.size = sizeof (attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = 1;
+    attr.exclude_hv = 1;
+
+    fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+        attr.exclude_kernel = 1;
+        fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    return fd;
+}
+
+/**
+ * tracepoint_id
+ *
+ * Looks up the id of the raw_syscalls:sys_enter tracepoint in tracefs.
+ *
+ * @return the tracepoint id, or -1 if tracefs is not readable
+ */
+static long tracepoint_id(void) {
+    const char *paths[] = {
+        "/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+        "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id"
+    };
+    unsigned int i;
+    long id = -1;
+    FILE *f;
+
+    for (i = 0; i < sizeof (paths) / sizeof (paths[0]) && id < 0; i++) {
+        if ((f = fopen(paths[i], "r")) == NULL)
+            continue;
+        if (fscanf(f, "%ld", &id) != 1)
+            id = -1;
+        fclose(f);
+    }
+    return id;
+}
+
+/**
+ * cost_read
+ *
+ * Reads the current value of every counter and the process rusage.
+ *
+ * @param cc the cost accounting state
+ * @param values receives the counter values, 0 for unavailable counters
+ * @param cpu_us receives the user + system cpu time in microseconds
+ */
+static void cost_read(cpu_cost *cc, uint64_t *values, uint64_t *cpu_us) {
+    struct rusage ru;
+    uint64_t v;
+    int i;
+
+    getrusage(RUSAGE_SELF, &ru);
+    *cpu_us = (uint64_t) (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000
+            + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+
+    for (i = 0; i < COST_NUM_COUNTERS; i++) {
+        values[i] = 0;
+        if (cc->fd[i] >= 0 && read(cc->fd[i], &v, sizeof (v)) == sizeof (v))
+            values[i] = v;
+    }
+
+    /* no perf software counter, use the voluntary + involuntary switches */
+    if (cc->fd[COST_CTX_SWITCHES] < 0)
+        values[COST_CTX_SWITCHES] = ru.ru_nvcsw + ru.ru_nivcsw;
+}
+
+/**
+ * cost_take
+ *
+ * Takes a sample and attributes the counter deltas since the previous sample
+ * to the requests handled in between. Intervals without requests are
+ * accounted as idle cost. The caller holds the lock.
+ *
+ * @param cc the cost accounting state
+ */
+static void cost_take(cpu_cost *cc) {
+    uint64_t values[COST_NUM_COUNTERS], cpu_us;
+    unsigned long requests;
+    int i;
+
+    cost_read(cc, values, &cpu_us);
+    requests = *cc->requests;
+
+    for (i = 0; i < COST_NUM_COUNTERS; i++) {
+        if (requests != cc->last_requests)
+            cc->busy[i] += values[i] - cc->last[i];
+        else
+            cc->idle[i] += values[i] - cc->last[i];
+        cc->last[i] = values[i];
+    }
+    if (requests != cc->last_requests) {
+        cc->busy_cpu_us += cpu_us - cc->last_cpu_us;
+        cc->n_busy_samples++;
+    }
+    cc->last_cpu_us = cpu_us;
+    cc->last_requests = requests;
+    cc->n_samples++;
+}
+
+/**
+ * cpu_cost_sample
+ *
+ * Takes a sample, see cost_take.
+ *
+ * @param cc the cost accounting state
+ */
+void cpu_cost_sample(cpu_cost *cc) {
+    pthread_mutex_lock(&cc->lock);
+    cost_take(cc);
+    pthread_mutex_unlock(&cc->lock);
+}
+
+/**
+ * cost_sampler
+ *
+ * Thread function taking a sample every interval until stopped.
+ *
+ * @param data the cost accounting state
+ */
+static void* cost_sampler(void *data) {
+    cpu_cost *cc = (cpu_cost *) data;
+
+    while (cc->running) {
+        usleep(cc->interval_ms * 1000);
+        cpu_cost_sample(cc);
+    }
+    return NULL;
+}
+
+/**
+ * cpu_cost_new
+ *
+ * Opens the counters and takes the baseline sample. Must be called before
+ * the server creates its worker threads so the counters are inherited.
+ *
+ * @param interval_ms the sampling interval in milliseconds
+ * @param requests the server's handled request counter
+ * @return the cost accounting state, NULL on failure
+ */
+cpu_cost* cpu_cost_new(int interval_ms, volatile unsigned long *requests) {
+    long id;
+    int i;
+    uint64_t values[COST_NUM_COUNTERS];
+    cpu_cost *cc = malloc(sizeof (cpu_cost));
+    if (cc == NULL)
+        return NULL;
+
+    memset(cc, 0, sizeof (cpu_cost));
+    cc->interval_ms = interval_ms > 0 ? interval_ms : 1000;
+    cc->requests = requests;
+
+    cc->fd[COST_CYCLES] = perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    cc->fd[COST_INSTRUCTIONS] = perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    cc->fd[COST_CACHE_MISSES] = perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    cc->fd[COST_CTX_SWITCHES] = perf_open(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES);
+    cc->fd[COST_SYSCALLS] = -1;
+    if ((id = tracepoint_id()) >= 0)
+        cc->fd[COST_SYSCALLS] = perf_open(PERF_TYPE_TRACEPOINT, id);
+
+    for (i = 0; i < COST_NUM_COUNTERS; i++) {
+        if (cc->fd[i] < 0 && i != COST_CTX_SWITCHES)
+            fprintf(stderr, "> cpu cost: %s counter not available\n", cost_names[i]);
+    }
+
+    if (pthread_mutex_init(&cc->lock, NULL) != 0) {
+        free(cc);
+        return NULL;
+    }
+
+    cost_read(cc, values, &cc->last_cpu_us);
+    memcpy(cc->last, values, sizeof (values));
+    cc->last_requests = *requests;
+
+    return cc;
+}
+
+/**
+ * cpu_cost_start
+ *
+ * Starts the interval sampler thread.
+ *
+ * @param cc the cost accounting state
+ */
+void cpu_cost_start(cpu_cost *cc) {
+    cc->running = true;
+    if (pthread_create(&cc->sampler, NULL, cost_sampler, cc) != 0) {
+        fprintf(stderr, "> cpu cost: unable to create sampler thread\n");
+        cc->running = false;
+    }
+}
+
+/**
+ * cost_report
+ *
+ * Prints the per request cost of every counter up to the last sample.
+ *
+ * @param cc the cost accounting state
+ */
+static void cost_report(cpu_cost *cc) {
+    unsigned long requests = cc->last_requests;
+    int i;
+
+    fprintf(stdout, "[ Requests Handled: %lu\n", requests);
+    fprintf(stdout, "[ Samples: %lu (%lu busy, %d ms interval)\n",
+            cc->n_samples, cc->n_busy_samples, cc->interval_ms);
+    if (requests == 0)
+        return;
+
+    fprintf(stdout, "[ CPU Time/Request: %.2lf us\n",
+            (double) cc->busy_cpu_us / requests);
+    for (i = 0; i < COST_NUM_COUNTERS; i++) {
+        if (cc->fd[i] < 0 && i != COST_CTX_SWITCHES) {
+            fprintf(stdout, "[ %s/Request: n/a\n", cost_names[i]);
+            continue;
+        }
+        fprintf(stdout, "[ %s/Request: %.2lf (idle: %llu)\n", cost_names[i],
+                (double) cc->busy[i] / requests,
+                (unsigned long long) cc->idle[i]);
+    }
+}
+
+/**
+ * cpu_cost_print
+ *
+ * Takes a final sample and prints the per request cost of every counter.
+ * The lock is only tried, as the servers print from their SIGINT handler,
+ * which may interrupt the sampler holding it; the last sample is printed
+ * then.
+ *
+ * @param cc the cost accounting state
+ */
+void cpu_cost_print(cpu_cost *cc) {
+    bool locked = pthread_mutex_trylock(&cc->lock) == 0;
+
+    if (locked)
+        cost_take(cc);
+    cost_report(cc);
+    if (locked)
+        pthread_mutex_unlock(&cc->lock);
+}
+
+/**
+ * cpu_task_wakeups
+ *
+ * Reads how often a thread blocked and was woken again, its voluntary
+ * context switches.
+ *
+ * @param pid the process
+ * @param tid the thread, pid for the main thread
+ * @return the number of wakeups, 0 if the thread cannot be read
+ */
+unsigned long cpu_task_wakeups(pid_t pid, pid_t tid) {
+    char path[64], line[128];
+    unsigned long n = 0;
+    FILE *fp;
+
+    snprintf(path, sizeof (path), "/proc/%d/task/%d/status", (int) pid, (int) tid);
+    if ((fp = fopen(path, "r")) == NULL)
+        return 0;
+    while (fgets(line, sizeof (line), fp) != NULL) {
+        if (sscanf(line, "voluntary_ctxt_switches: %lu", &n) == 1)
+            break;
+    }
+    fclose(fp);
+    return n;
+}
@@ -9,6 +9,41 @@
 --	DATE:				February 19, 2014
 --
 --	REVISIONS:			(Date and Description)
+--						October 2026
+--						* -w runs several reactors, one per thread, each with
+--						  its own SO_REUSEPORT listen socket and client list
+--						* -a pins the reactors to a CPU list and allocates
+--						  their buffers on the CPU's NUMA node, -I steers
+--						  connections with SO_INCOMING_CPU
+--						* -P forks worker processes, dead workers are restarted
+--						* -A picks how reactors and workers wait for
+--						  connections: one shared listen socket, the same
+--						  with EPOLLEXCLUSIVE, or a SO_REUSEPORT socket each
+--						* -C runs each client's handler on a coroutine that
+--						  yields to the epoll loop when the socket blocks
+--						* -O sheds load when the loop lags: new connections
+--						  are reset or requests answered "busy"
+--						* -B caps the requests served per client per turn,
+--						  clients with more work wait on a ready list
+--						* "binary 1" switches a connection to length-prefixed
+--						  frames with request ids, see proto.c
+--						* -u listens on a Unix stream socket as well as the
+--						  TCP port, -U on the Unix socket alone
+--						* the replies owed to a client go out in one sendmsg
+--						  per turn, counted as writes and TCP segments per
+--						  request
+--						* -K serves "get", "set" and "del" from a key value
+--						  cache shared by the reactors and workers, see kv.c
+--						* -D answers request datagrams on a UDP socket on the
+--						  same port in recvmmsg/sendmmsg batches, -G adds
+--						  UDP_GRO and UDP_SEGMENT, see udp.c
+--						* -S broadcasts "publish" messages to the clients
+--						  that sent "subscribe", one shared buffer per
+--						  message, see pubsub.c
+--						* -T samples TCP_INFO of a few connections per
+--						  interval in turn, see tcp_sample.c
+--						* -R records the connections and requests to a
+--						  trace that replay_clnt plays back, see trace.c
 --
 --	DESIGNERS:			Design based on various code snippets found on C10K links
 --						Modified and improved: Aman Abdulla - February 2008
@@ -26,10 +61,15 @@
 ---------------------------------------------------------------------------------------*/
 
 #include "common.h"
+#include <sys/syscall.h>
+
+#define USAGE "Usage: %s [-c interval_ms] [-b spin_us] [-f dir [-F] | -K megabytes] [-w reactors | -P procs] [-A share|excl|reuseport] [-a cpus [-I]] [-C] [-O lag_us[,reject|busy]] [-B requests] [-S depth[,lag|drop]] [-T interval_ms[,conns]] [-R trace] [-u|-U name] [-D|-G] [-q] [port]\n"
 
 const char client_msg[BUFLEN] =
         "012345678901234567890123456789012345678901234567890123456789012\n";
 
+static const char *accept_modes[] = {"share", "excl", "reuseport"};
+
 // GLOBALS
 pthread_t master_thread;
 bool running = true;
@@ -46,7 +86,7 @@ server *serv;
  * @return EXIT_SUCCES after successful completion.
  */
 int main(int argc, char **argv) {
-    int ret;
+    int i, ret, opt, cost_interval = 0, n_workers = 1, n_procs = 0;
     struct sigaction act;
     server *s;
 
@@ -67,22 +107,185 @@ int main(int argc, char **argv) {
     s = server_new();
     serv = s;
 
-    switch (argc) {
-        case 1:
+    while ((opt = getopt(argc, argv, "c:b:f:FK:qw:P:A:a:ICO:B:S:T:R:u:U:DG")) != -1) {
+        switch (opt) {
+            case 'c':
+                cost_interval = atoi(optarg); // CPU cost sampling interval
+                break;
+            case 'b':
+                s->spin_us = atoi(optarg); // busy-poll budget before blocking
+                break;
+            case 'f':
+                s->file_dir = open(optarg, O_RDONLY | O_DIRECTORY); // files for "get"
+                if (s->file_dir < 0)
+                    SystemFatal("open(): File Directory Failed\n");
+                break;
+            case 'F':
+                file_buffered = true; // read/write files instead of sendfile
+                break;
+            case 'K':
+                if ((s->kv = kv_new(atol(optarg))) == NULL) { // key value cache
+                    fprintf(stderr, USAGE, argv[0]);
+                    exit(1);
+                }
+                break;
+            case 'q':
+                s->quiet = true; // no per-connection logging
+                break;
+            case 'w':
+                n_workers = atoi(optarg); // reactor threads
+                break;
+            case 'P':
+                n_procs = atoi(optarg); // prefork worker processes
+                break;
+            case 'A':
+                if ((s->accept_mode = accept_mode(optarg)) < 0) {
+                    fprintf(stderr, USAGE, argv[0]);
+                    exit(1);
+                }
+                break;
+            case 'a':
+                if (affinity_parse(optarg, &s->cpus) < 0) {
+                    fprintf(stderr, "Bad CPU list: %s\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 'I':
+                s->incoming_cpu = true; // steer connections to their CPU's reactor
+                break;
+            case 'C':
+                s->coroutines = true; // straight-line handlers on coroutines
+                break;
+            case 'B':
+                s->budget = atoi(optarg); // requests per client per turn
+                break;
+            case 'S':
+                if ((s->ps = pubsub_new(optarg)) == NULL) { // broadcast to subscribers
+                    fprintf(stderr, USAGE, argv[0]);
+                    exit(1);
+                }
+                break;
+            case 'T':
+                if ((s->tcp_samples = tcp_sampler_new(optarg)) == NULL) { // TCP_INFO sampling
+                    fprintf(stderr, USAGE, argv[0]);
+                    exit(1);
+                }
+                break;
+            case 'R':
+                if ((s->trace = trace_new(optarg)) == NULL) // capture to a trace file
+                    SystemFatal("trace_new(): Failed");
+                break;
+            case 'u':
+                s->unix_path = optarg; // Unix socket next to the TCP port
+                break;
+            case 'U':
+                s->unix_path = optarg; // Unix socket instead of the TCP port
+                s->tcp = false;
+                break;
+            case 'D':
+                s->udp = true; // request datagrams on the same port
+                break;
+            case 'G':
+                s->udp = s->udp_gso = true; // the same with UDP_GRO and UDP_SEGMENT
+                break;
+            case 'O':
+                if ((s->load = overload_new(optarg)) == NULL) { // admission control
+                    fprintf(stderr, USAGE, argv[0]);
+                    exit(1);
+                }
+                break;
+            default:
+                fprintf(stderr, USAGE, argv[0]);
+                exit(1);
+        }
+    }
+
+    switch (argc - optind) {
+        case 0:
             s->port = SERVER_TCP_PORT; // Use the default port
             break;
-        case 2:
-            s->port = atoi(argv[1]); // Get user specified port
+        case 1:
+            s->port = atoi(argv[optind]); // Get user specified port
             break;
         default:
-            fprintf(stderr, "Usage: %s [port]\n", argv[0]);
+            fprintf(stderr, USAGE, argv[0]);
             exit(1);
     }
+    if (n_workers < 1 || n_procs < 0 || (n_procs > 0 && n_workers > 1) || s->budget < 0 ||
+            (s->kv != NULL && s->file_dir >= 0) || (s->ps != NULL && n_procs > 0)) {
+        fprintf(stderr, USAGE, argv[0]);
+        exit(1);
+    }
+
+    /* files are queued on the reply ring, which the coroutines do not use */
+    if (s->coroutines && s->file_dir >= 0) {
+        fprintf(stderr, "> -C does not serve files, using callbacks\n");
+        s->coroutines = false;
+    }
+    if (s->coroutines && s->ps != NULL) {
+        fprintf(stderr, "> -C does not broadcast, using callbacks\n");
+        s->coroutines = false;
+    }
+
+    /* the counters of a process do not see its children until they exit */
+    if (cost_interval > 0 && n_procs > 0) {
+        fprintf(stderr, "> -c is not supported with -P, reporting worker CPU time\n");
+        cost_interval = 0;
+    }
+    if (s->tcp_samples != NULL && n_procs > 0) {
+        fprintf(stderr, "> -T is not supported with -P\n");
+        free(s->tcp_samples);
+        s->tcp_samples = NULL;
+    }
+    if (s->trace != NULL && n_procs > 0) {
+        fprintf(stderr, "> -R is not supported with -P\n");
+        s->trace = NULL;
+    }
+
+    /* open the cost counters before any thread exists so they are inherited */
+    if (cost_interval > 0) {
+        if ((s->cost = cpu_cost_new(cost_interval, &s->n_requests)) == NULL)
+            SystemFatal("cpu_cost_new() Failed\n");
+        cpu_cost_start(s->cost);
+    }
+
+    /* the kernel does not spread Unix connections over SO_REUSEPORT
+     * sockets, so every reactor and worker waits on this one */
+    if (s->unix_path != NULL) {
+        if ((s->unix_sd = unix_listen(s->unix_path)) < 0)
+            SystemFatal("unix_listen(): Failed\n");
+        if (fcntl(s->unix_sd, F_SETFL, O_NONBLOCK | fcntl(s->unix_sd, F_GETFL, 0)) == -1)
+            SystemFatal("fcntl(): Server Non-Block Failed\n");
+        fprintf(stderr, "> Listening on Unix socket %s\n", s->unix_path);
+    }
 
-    ret = pthread_create(&master_thread, NULL, client_manager, s);
-    if (ret != 0)
-        fprintf(stderr, "Unable to create client management thread\n");
-    pthread_join(master_thread, NULL);
+    /* processes share one socket with EPOLLEXCLUSIVE and threads bind one
+     * each, unless told otherwise */
+    if (s->accept_mode < 0)
+        s->accept_mode = n_procs > 0 ? ACCEPT_EXCL : ACCEPT_REUSEPORT;
+
+    if (n_procs > 0) {
+        prefork_run(s, n_procs);
+    } else if (n_workers == 1) {
+        s->cpu = affinity_cpu(&s->cpus, 0);
+        ret = pthread_create(&master_thread, NULL, client_manager, s);
+        if (ret != 0)
+            fprintf(stderr, "Unable to create client management thread\n");
+        pthread_join(master_thread, NULL);
+    } else {
+        /* one reactor per thread, with their own listen sockets or this one */
+        if (s->accept_mode != ACCEPT_REUSEPORT)
+            server_init(s);
+        s->n_workers = n_workers;
+        s->workers = malloc(n_workers * sizeof (server *));
+        for (i = 0; i < n_workers; i++) {
+            s->workers[i] = server_worker(s, affinity_cpu(&s->cpus, i));
+            if (pthread_create(&s->workers[i]->tid, NULL, client_manager, s->workers[i]) != 0)
+                SystemFatal("Unable to create reactor thread\n");
+        }
+        for (i = 0; i < n_workers; i++)
+            pthread_join(s->workers[i]->tid, NULL);
+    }
 
     /* clean up */
     free(s);
@@ -90,6 +293,22 @@ int main(int argc, char **argv) {
     return EXIT_SUCCESS;
 }
 
+/**
+ * accept_mode
+ *
+ * @param name share, excl or reuseport
+ * @return the accept mode, -1 for an unknown name
+ */
+int accept_mode(const char *name) {
+    int i;
+
+    for (i = ACCEPT_SHARE; i <= ACCEPT_REUSEPORT; i++) {
+        if (strcmp(name, accept_modes[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
 /**
  * client_manager
  *
@@ -102,8 +321,28 @@ void* client_manager(void *data) {
     client *c = NULL;
     node *n = NULL;*/
     server *s = (server *) data;
+    unsigned long handled;
 
-    server_init(s);
+    s->task = syscall(SYS_gettid);
+
+    /* pin the reactor before it allocates anything, so its memory is local */
+    if (s->cpu >= 0) {
+        if (affinity_pin(s->cpu) < 0) {
+            fprintf(stderr, "> CPU %d: pinning failed, running unpinned\n", s->cpu);
+            s->cpu = -1;
+        } else {
+            s->node = affinity_node(s->cpu);
+        }
+    }
+    s->events = affinity_alloc(EPOLL_MAX_EVENTS * sizeof (struct epoll_event), s->node);
+    if (s->events == NULL)
+        SystemFatal("Events Alloc() Failed\n");
+    if (s->coroutines && (s->coros = coro_pool_new(CORO_STACK_SIZE)) == NULL)
+        SystemFatal("coro_pool_new() Failed\n");
+
+    /* reactors and prefork workers may share the main socket */
+    if (s->listen_sd < 0)
+        server_init(s);
 
     s->epoll_fd = epoll_create(EPOLL_QUEUE_LEN);
     if (s->epoll_fd < 0)
@@ -111,20 +350,61 @@ void* client_manager(void *data) {
 
     /* Add the server socket to the epoll event loop  */
     s->event.events = EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLET;
+    if (s->accept_mode == ACCEPT_EXCL)
+        s->event.events |= EPOLLEXCLUSIVE; // wake one of the waiters sharing it
     s->event.data.fd = s->listen_sd;
-    if (epoll_ctl(s->epoll_fd, EPOLL_CTL_ADD, s->listen_sd, &s->event) == -1)
+    if (s->listen_sd >= 0 && epoll_ctl(s->epoll_fd, EPOLL_CTL_ADD, s->listen_sd, &s->event) == -1)
+        SystemFatal("epoll_ctl() error\n");
+
+    /* the Unix socket is shared unless the waiters share alike */
+    s->event.events = EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLET;
+    if (s->accept_mode != ACCEPT_SHARE)
+        s->event.events |= EPOLLEXCLUSIVE;
+    s->event.data.fd = s->unix_sd;
+    if (s->unix_sd >= 0 && epoll_ctl(s->epoll_fd, EPOLL_CTL_ADD, s->unix_sd, &s->event) == -1)
         SystemFatal("epoll_ctl() error\n");
 
+    /* every reactor and worker binds its own UDP socket with SO_REUSEPORT */
+    if (s->udp) {
+        s->udp_srv = udp_new(s->port, s->udp_gso);
+        s->event.events = EPOLLIN | EPOLLET;
+        s->event.data.fd = s->udp_srv->fd;
+        if (epoll_ctl(s->epoll_fd, EPOLL_CTL_ADD, s->udp_srv->fd, &s->event) == -1)
+            SystemFatal("epoll_ctl() error\n");
+    }
+
+    /* other reactors hand this one their messages through the eventfd */
+    if (s->ps != NULL) {
+        s->ps_local = pubsub_join(s->ps);
+        s->event.events = EPOLLIN | EPOLLET;
+        s->event.data.fd = s->ps_local->efd;
+        if (epoll_ctl(s->epoll_fd, EPOLL_CTL_ADD, s->ps_local->efd, &s->event) == -1)
+            SystemFatal("epoll_ctl() error\n");
+    }
+
 
     for (; running;) {
-        pthread_mutex_lock(&s->dataLock);
-        s->num_fds = epoll_wait(s->epoll_fd, s->events, EPOLL_QUEUE_LEN, -1);
-        pthread_mutex_unlock(&s->dataLock);
+        s->num_fds = wait_for_events(s);
 
-        if (s->num_fds < 0)
+        if (s->num_fds < 0) {
+            if (errno == EINTR)
+                continue;
             SystemFatal("epoll_wait(): Error\n");
+        }
 
+        handled = s->n_requests;
         read_from_socket(s);
+        if (s->ready_head != NULL)
+            serve_ready(s);
+        if (s->tcp_samples != NULL)
+            tcp_sample_round(s->tcp_samples, s->e_client_list);
+
+        /* one shared update per wakeup keeps the reactors off each other's lines */
+        if (s->parent != NULL && s->n_requests != handled)
+            __atomic_fetch_add(&s->parent->n_requests, s->n_requests - handled,
+                __ATOMIC_RELAXED);
+        if (s->slot != NULL)
+            prefork_publish(s);
     }
 
     fprintf(stdout, "Exiting the client manager\n");
@@ -133,6 +413,142 @@ void* client_manager(void *data) {
     pthread_exit(NULL);
 }
 
+/**
+ * wait_for_events
+ *
+ * Waits for the next batch of epoll events. With a spin budget the loop
+ * polls epoll without blocking until events arrive or the budget runs out,
+ * and only then blocks. The batch size doubles while epoll fills the whole
+ * batch and halves again once wakeups use less than a quarter of it.
+ * With -T the wait ends in time for the next TCP_INFO round.
+ *
+ * @param s The server data holding the epoll set and event buffer.
+ * @return the number of ready events, -1 on error.
+ */
+int wait_for_events(server *s) {
+    int n = 0;
+    struct timespec now, deadline;
+
+    /* clients on the ready list are served without waiting for an edge */
+    if (s->spin_us > 0 && s->ready_head == NULL) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_nsec += (long) s->spin_us * 1000;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000;
+        deadline.tv_nsec %= 1000000000;
+
+        do {
+            n = epoll_wait(s->epoll_fd, s->events, s->batch_size, 0);
+            if (n != 0)
+                break;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+        } while (running && (now.tv_sec < deadline.tv_sec ||
+                (now.tv_sec == deadline.tv_sec && now.tv_nsec < deadline.tv_nsec)));
+
+        if (n > 0)
+            s->n_spin_wakeups++;
+    }
+
+    if (n == 0)
+        n = epoll_wait(s->epoll_fd, s->events, s->batch_size,
+            s->ready_head != NULL ? 0 : tcp_sample_wait(s->tcp_samples));
+    if (n <= 0)
+        return n;
+
+    s->n_wakeups++;
+    s->n_events += n;
+    if (s->load != NULL)
+        s->wake_ns = overload_now();
+
+    if (n == s->batch_size && s->batch_size < EPOLL_MAX_EVENTS) {
+        s->batch_size *= 2;
+        if (s->batch_size > s->max_batch_size)
+            s->max_batch_size = s->batch_size;
+    } else if (n < s->batch_size / 4 && s->batch_size > EPOLL_QUEUE_LEN) {
+        s->batch_size /= 2;
+    }
+
+    return n;
+}
+
+/**
+ * client_ready
+ *
+ * Puts a client that used up its budget with work left at the end of the
+ * ready list.
+ *
+ * @param s the server
+ * @param c the client
+ */
+void client_ready(server *s, client *c) {
+    c->ready = true;
+    c->cold->next_ready = NULL;
+    if (s->ready_tail != NULL)
+        s->ready_tail->cold->next_ready = c;
+    else
+        s->ready_head = c;
+    s->ready_tail = c;
+    s->n_deferred++;
+}
+
+/**
+ * serve_ready
+ *
+ * Gives every client on the ready list another turn, in the order they
+ * were put on it. Clients that use up their budget again go to the end of
+ * a new list for the next loop pass.
+ *
+ * @param s the server
+ */
+void serve_ready(server *s) {
+    client *c, *next;
+
+    c = s->ready_head;
+    s->ready_head = s->ready_tail = NULL;
+    for (; c != NULL; c = next) {
+        next = c->cold->next_ready;
+        c->ready = false;
+        if (c->co != NULL)
+            c->quit = !coro_resume(s->coros, c->co);
+        else
+            process_client_req(c, s);
+        if (c->quit)
+            client_remove(s, c);
+    }
+}
+
+/**
+ * client_remove
+ *
+ * Closes a client's connection and frees it.
+ *
+ * @param s the server
+ * @param c the client
+ */
+void client_remove(server *s, client *c) {
+    pthread_mutex_trylock(&s->dataLock);
+    s->n_clients--;
+    if (s->tcp_samples != NULL)
+        tcp_sample_forget(s->tcp_samples, c);
+    s->e_client_list = llist_remove(s->e_client_list, (void *) c,
+            client_compare);
+    if (!s->quiet)
+        fprintf(stderr, "[%5d]Removed client from list, new size: %d\n",
+                c->fd, llist_length(s->e_client_list));
+    s->n_segs_out += client_segs_out(c->fd);
+    if (s->ps_local != NULL)
+        pubsub_leave(s->ps_local, c);
+    if (s->trace != NULL)
+        trace_event(s->trace, c->cold->trace_id, TRACE_CLOSE, 0);
+    client_drop_replies(c);
+    close(c->fd);
+    if (c->file_fd >= 0)
+        close(c->file_fd);
+    if (c->co != NULL)
+        coro_free(s->coros, c->co);
+    free(c);
+    pthread_mutex_unlock(&s->dataLock);
+}
+
 /**
  * read_from_socket
  *
@@ -143,41 +559,73 @@ void* client_manager(void *data) {
  * @param s The server data containing the epoll events to handle.
  */
 void read_from_socket(server *s) {
-    int i;
+    int i, fd, accepted;
     client *c = NULL;
     node *it = NULL;
 
     for (i = 0; i < s->num_fds; i++) {
+        fd = s->events[i].data.fd;
+
         /* Error check */
-        if (s->events[i].events & (EPOLLHUP | EPOLLERR)) {
+        if ((fd == s->listen_sd || fd == s->unix_sd) &&
+                s->events[i].events & (EPOLLHUP | EPOLLERR)) {
             fprintf(stderr, "epoll(): EPOLLERR\n");
-            close(s->events[i].data.fd);
+            close(fd);
+            continue;
+        }
+        assert(s->events[i].events & (EPOLLIN | EPOLLOUT | EPOLLHUP | EPOLLERR));
+
+        if (s->udp_srv != NULL && fd == s->udp_srv->fd) {
+            udp_serve(s, s->udp_srv);
+            continue;
+        }
+        if (s->ps_local != NULL && fd == s->ps_local->efd) {
+            pubsub_deliver(s);
             continue;
         }
-        assert(s->events[i].events & EPOLLIN);
+
+        /* the event waited for the ones before it in the batch */
+        if (s->load != NULL)
+            overload_lag(s->load, overload_now() - s->wake_ns);
 
         /* Server is receiving a connection request */
-        if (s->events[i].data.fd == s->listen_sd) {
+        if (fd == s->listen_sd || fd == s->unix_sd) {
+            s->n_listen_wakeups++;
+            accepted = 0;
+            if (s->load != NULL && fd == s->listen_sd)
+                overload_queue(s->load, s->listen_sd);
             while (true) {
                 /* create new client data */
                 c = client_new();
-                c->sa_len = sizeof (c->sa);
 
-                fprintf(stdout, "client connection\n");
-                c->fd = accept(s->listen_sd, (struct sockaddr *) &c->sa, &c->sa_len);
+                if (!s->quiet)
+                    fprintf(stdout, "client connection\n");
+                c->fd = accept(fd, (struct sockaddr *) &c->cold->sa, &c->cold->sa_len);
                 if (c->fd < 0) {
                     if ((errno == EAGAIN) ||
                             (errno == EWOULDBLOCK)) {
-                        /* all incoming connections have been processed */
+                        /* all incoming connections have been processed, another
+                         * waiter on a shared socket may have taken them all */
+                        if (accepted == 0)
+                            s->n_accept_misses++;
+                        free(c);
                         break;
                     } else {
                         SystemFatal("accept(): Error");
                         break;
                     }
                 }
-                fprintf(stdout, "Received connection from (%s, %d)\n",
-                        inet_ntoa(c->sa.sin_addr),
-                        ntohs(c->sa.sin_port));
+                accepted++;
+                if (s->load != NULL && !overload_admit(s->load, c->fd)) {
+                    free(c);
+                    continue;
+                }
+                if (!s->quiet && fd == s->unix_sd)
+                    fprintf(stdout, "Received connection on %s\n", s->unix_path);
+                else if (!s->quiet)
+                    fprintf(stdout, "Received connection from (%s, %d)\n",
+                            inet_ntoa(c->cold->sa.sin_addr),
+                            ntohs(c->cold->sa.sin_port));
 
                 /* make the server Socket non-blocking */
                 if (fcntl(c->fd, F_SETFL, O_NONBLOCK | fcntl(c->fd, F_GETFL, 0)) == -1)
@@ -189,46 +637,58 @@ void read_from_socket(server *s) {
                 s->n_clients++;
                 s->n_max_connected++;
 
-                /* add the new socket descriptor to the epoll loop */
+                /* add the new socket descriptor to the epoll loop, EPOLLOUT
+                 * resumes replies that did not fit in the socket buffer */
+                s->event.events = EPOLLIN | EPOLLOUT | EPOLLERR | EPOLLHUP | EPOLLET;
                 s->event.data.fd = c->fd;
                 if (epoll_ctl(s->epoll_fd, EPOLL_CTL_ADD, c->fd, &s->event) == -1)
                     SystemFatal("epoll_ctl() error");
 
                 /* add the client data to the linked list */
                 s->e_client_list = llist_append(s->e_client_list, (void *) c);
+                if (s->trace != NULL)
+                    c->cold->trace_id = trace_connect(s->trace);
+
+                /* without a stack the client is served by callbacks */
+                if (s->coros != NULL) {
+                    c->cold->s = s;
+                    c->co = coro_new(s->coros, process_client_coro, c);
+                }
 
-                fprintf(stdout, "Added client to list, new size: %d\n",
-                        llist_length(s->e_client_list));
+                if (!s->quiet)
+                    fprintf(stdout, "Added client to list, new size: %d\n",
+                            llist_length(s->e_client_list));
 
                 pthread_mutex_unlock(&s->dataLock);
             }
 
             continue;
         } else {
-            /* go through existing client connections. */
+            /* go through existing client connections, a client streaming
+             * a pipe is also woken through the pipe */
             it = s->e_client_list->link;
             while (it != NULL) {
                 c = (client *) it->data;
-                if (c->fd == s->events[i].data.fd)
+                if (c->fd == fd || c->file_fd == fd)
                     break;
                 it = it->next;
             }
 
-            //process_client_data(c, s);
-            process_client_req(c, s);
+            /* removed earlier in this batch, or served from the ready list,
+             * which also finds a hang up */
+            if (it == NULL || c->ready)
+                continue;
 
-            if (c->quit) {
-                pthread_mutex_trylock(&s->dataLock);
-                s->n_clients--;
-                s->e_client_list = llist_remove(s->e_client_list, (void *) c,
-                        client_compare);
-                fprintf(stderr, "[%5d]Removed client from list, new size: %d\n",
-                        c->fd, llist_length(s->e_client_list));
-                close(c->fd);
-                c = NULL;
-                free(c);
-                pthread_mutex_unlock(&s->dataLock);
-            }
+            if (fd == c->fd && (s->events[i].events & (EPOLLHUP | EPOLLERR)) &&
+                    !(s->events[i].events & EPOLLIN))
+                c->quit = true;
+            else if (c->co != NULL)
+                c->quit = !coro_resume(s->coros, c->co);
+            else
+                process_client_req(c, s);
+
+            if (c->quit)
+                client_remove(s, c);
         }
     }
 }
@@ -275,26 +735,297 @@ void process_client_data(client *c, server *s) {
  * @param s server information
  */
 void process_client_req(client *c, server *s) {
-    ssize_t r, w;
-    char *recv;
-    //int bytes_to_read = BUFLEN;
-    char error[100];
+    int off, used, depth, queued, turn = 0;
+    bool full, blocked, binary, deferred = false;
+    proto_req r;
 
-    recv = malloc(BUFLEN * sizeof (char));
+    /* send what the client is still owed before taking more requests */
+    if (!client_flush(c, s))
+        return;
 
-    while ((r = read(c->fd, recv, BUFLEN)) > 0) {
-        s->n_max_bytes_received += r;
+    while (!c->quit) {
+        s->n_max_bytes_received += client_fill(c);
+        full = (c->rlen == RECV_BUFLEN);
+
+        /* handle complete requests while the reply queue has room */
+        off = 0;
+        blocked = false;
+        while ((used = proto_next_req(c->binary, c->rbuf + off, c->rlen - off, &r)) > 0) {
+            if (r.type == CMD_NONE) {
+                off += used;
+                break;
+            }
+
+            /* the requests still owed replies came before this one */
+            depth = c->cold->n_owed;
+            queued = c->n_pending;
+            binary = c->binary;
+            switch (r.type) {
+                case CMD_REQUEST:
+                    /* a shed request costs a five byte reply, a full queue
+                     * blocks it below like any other */
+                    if (s->load != NULL && c->n_pending < REPLY_QUEUE_LEN &&
+                            overload_busy(s->load))
+                        client_queue_status(c, OP_BUSY, r.id);
+                    else if (client_queue_request(c, s->replies, r.arg, r.id))
+                        s->n_requests++;
+                    else
+                        blocked = true;
+                    break;
+                case CMD_QUIT:
+                    c->quit = true;
+                    break;
+                case CMD_GET:
+                case CMD_SET:
+                case CMD_DEL:
+                    if (s->kv != NULL) {
+                        if (!client_queue_kv(c, s->kv, &r))
+                            blocked = true;
+                        else
+                            s->n_requests++;
+                        break;
+                    }
+                    /* a command nothing serves is answered as a bad one,
+                     * a pipelining client waits for every reply */
+                    if (s->file_dir < 0 || r.type != CMD_GET) {
+                        if (!client_queue_status(c, OP_ERROR, r.id))
+                            blocked = true;
+                        break;
+                    }
+                    if (!client_queue_file(c, s->file_dir, r.cmd + r.arg, r.cmd_len - r.arg)) {
+                        blocked = true;
+                        break;
+                    }
+                    s->n_requests++;
+
+                    /* a pipe wakes the client when it has data to splice */
+                    if (c->file_fd >= 0 && c->file_pipe) {
+                        s->event.events = EPOLLIN | EPOLLET;
+                        s->event.data.fd = c->file_fd;
+                        if (epoll_ctl(s->epoll_fd, EPOLL_CTL_ADD, c->file_fd, &s->event) == -1)
+                            SystemFatal("epoll_ctl() error");
+                    }
+                    break;
+                case CMD_SUBSCRIBE:
+                    if (s->ps_local != NULL && !pubsub_subscribe(s->ps_local, c))
+                        blocked = true;
+                    break;
+                case CMD_PUBLISH:
+                    if (s->ps_local == NULL)
+                        break;
+                    if (!pubsub_publish(s, c, &r)) {
+                        blocked = true;
+                        break;
+                    }
+                    s->n_requests++;
+                    break;
+                case CMD_BINARY:
+                    if (!client_negotiate(c, r.arg))
+                        blocked = true;
+                    break;
+                case CMD_INVALID:
+                    fprintf(stderr, "[%5d]Bad frame\n", c->fd);
+                    c->quit = true;
+                    return;
+                default:
+                    /* every frame is answered, unknown text is ignored */
+                    if (c->binary && !client_queue_status(c, OP_ERROR, r.id))
+                        blocked = true;
+                    break;
+            }
+            if (blocked)
+                break;
+            if (s->trace != NULL) {
+                trace_request(s->trace, c->cold->trace_id, &r, binary,
+                        proto_wire_len(binary, c->rbuf + off + used, c->rlen - off - used, used),
+                        depth);
+                client_owe(c, queued);
+            }
+            if (c->quit)
+                return;
+            off += used;
+
+            /* leave the rest for the client's next turn */
+            if (s->budget > 0 && ++turn == s->budget) {
+                deferred = true;
+                break;
+            }
+        }
+        client_consume(c, off);
+
+        /* a command that does not fit in the buffer can never complete */
+        if (c->rlen == RECV_BUFLEN && !blocked && !deferred) {
+            fprintf(stderr, "[%5d]Request too long\n", c->fd);
+            c->quit = true;
+            return;
+        }
+
+        /* wait for EPOLLOUT when the socket buffer is full */
+        if (!client_flush(c, s))
+            return;
+
+        /* the socket is not drained, so no edge will bring the client back */
+        if (deferred) {
+            client_ready(s, c);
+            return;
+        }
+
+        /* edge triggered: keep going until the socket and buffer are drained */
+        if (!full && !blocked)
+            return;
+    }
+}
+
+/**
+ * co_reply
+ *
+ * Writes the reply to a request for len bytes, or the legacy BUFLEN reply
+ * when len is 0, behind a frame header on a binary connection, yielding
+ * while the socket buffer is full.
+ *
+ * @param c the client
+ * @param rc the reply cache
+ * @param len the requested reply length
+ * @param id the request id of a binary request
+ * @return 0, -1 if the client went away
+ */
+static int co_reply(client *c, reply_cache *rc, long len, uint32_t id) {
+    char hdr[FRAME_HDR_LEN];
+    int chunk;
+
+    if (c->binary) {
+        proto_frame_hdr(hdr, OP_REPLY, len == 0 ? BUFLEN : len, id);
+        if (co_send(c->fd, hdr, FRAME_HDR_LEN, MSG_MORE) < 0)
+            return -1;
+    }
+    if (len == 0)
+        return co_write(c->fd, rc->legacy, BUFLEN) < 0 ? -1 : 0;
+
+    for (; len > 0; len -= chunk) {
+        chunk = len > REPLY_CLASS_MAX ? REPLY_CLASS_MAX : len;
+        if (co_write(c->fd, reply_cache_get(rc, chunk), chunk) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * co_status
+ *
+ * Writes a reply without data, see client_queue_status.
+ *
+ * @param c the client
+ * @param opcode OP_BUSY or OP_ERROR
+ * @param id the request id
+ * @return 0, -1 if the client went away
+ */
+static int co_status(client *c, int opcode, uint32_t id) {
+    char hdr[FRAME_HDR_LEN];
+
+    if (c->binary) {
+        proto_frame_hdr(hdr, opcode, 0, id);
+        return co_write(c->fd, hdr, FRAME_HDR_LEN) < 0 ? -1 : 0;
     }
+    if (opcode == OP_BUSY)
+        return co_write(c->fd, OVERLOAD_BUSY_REPLY, OVERLOAD_BUSY_LEN) < 0 ? -1 : 0;
+    return co_write(c->fd, "error\n", 6) < 0 ? -1 : 0;
+}
+
+/**
+ * process_client_coro
+ *
+ * The client's handler with -C, running on its own coroutine: reads
+ * requests and writes each reply in turn, and returns when the client
+ * quits or goes away. co_read and co_write hand the thread back to the
+ * epoll loop whenever the socket would block.
+ *
+ * @param data the client
+ */
+void process_client_coro(void *data) {
+    client *c = (client *) data;
+    server *s = c->cold->s;
+    int off, used, depth, turn = 0;
+    char kv_out[KV_REPLY_MAX];
+    const char *reply;
+    ssize_t n;
+    proto_req r;
+
+    for (;;) {
+        if ((n = co_read(c->fd, c->rbuf + c->rlen, RECV_BUFLEN - c->rlen)) <= 0)
+            return;
+        c->rlen += n;
+        s->n_max_bytes_received += n;
+
+        off = 0;
+        depth = 0;
+        while ((used = proto_next_req(c->binary, c->rbuf + off, c->rlen - off, &r)) > 0) {
+            off += used;
+            if (r.type == CMD_NONE)
+                break;
+
+            /* the requests read with this one were sent before their replies */
+            if (s->trace != NULL && r.type != CMD_INVALID)
+                trace_request(s->trace, c->cold->trace_id, &r, c->binary,
+                        proto_wire_len(c->binary, c->rbuf + off, c->rlen - off, used), depth++);
+
+            switch (r.type) {
+                case CMD_REQUEST:
+                    if (s->load != NULL && overload_busy(s->load)) {
+                        if (co_status(c, OP_BUSY, r.id) < 0)
+                            return;
+                        break;
+                    }
+                    if (co_reply(c, s->replies, r.arg, r.id) < 0)
+                        return;
+                    s->n_requests++;
+
+                    /* the ready list resumes the client after the others */
+                    if (s->budget > 0 && ++turn == s->budget) {
+                        turn = 0;
+                        client_ready(s, c);
+                        coro_yield();
+                    }
+                    break;
+                case CMD_QUIT:
+                    return;
+                case CMD_GET:
+                case CMD_SET:
+                case CMD_DEL:
+                    if (s->kv == NULL) {
+                        if (co_status(c, OP_ERROR, r.id) < 0)
+                            return;
+                        break;
+                    }
+                    n = kv_reply(s->kv, &r, kv_out, &reply);
+                    if (co_write(c->fd, reply, n) < 0)
+                        return;
+                    s->n_requests++;
+                    break;
+                case CMD_BINARY:
+                    if (r.arg != PROTO_BIN_VERSION)
+                        n = co_write(c->fd, "error\n", 6);
+                    else if ((n = co_write(c->fd, "binary 1\n", 9)) > 0)
+                        c->binary = true;
+                    if (n < 0)
+                        return;
+                    break;
+                case CMD_INVALID:
+                    fprintf(stderr, "[%5d]Bad frame\n", c->fd);
+                    return;
+                default:
+                    /* every frame is answered, unknown text is ignored */
+                    if (c->binary && co_status(c, OP_ERROR, r.id) < 0)
+                        return;
+                    break;
+            }
+        }
+        client_consume(c, off);
 
-    if (strcmp(recv, "request\n") == 0) {
-        if ((w = write(c->fd, client_msg, BUFLEN)) != BUFLEN) {
-            strcpy(error, "write(): Client Write Error - ");
-            sscanf(error, "%d != %d\n", (int *) strlen(recv), (int *) w);
-            SystemFatal(error);
+        /* a command that does not fit in the buffer can never complete */
+        if (c->rlen == RECV_BUFLEN) {
+            fprintf(stderr, "[%5d]Request too long\n", c->fd);
+            return;
         }
-    } else if (strcmp(recv, "quit\n") == 0) {
-        c->quit = true;
-        return;
     }
 }
 
@@ -306,9 +1037,32 @@ void process_client_req(client *c, server *s) {
  * @return c returns the client struct
  */
 client * client_new(void) {
-    client *c = malloc(sizeof (client));
-    c->sa_len = sizeof (c->sa);
+    client *c;
+    size_t size = sizeof (client) + REPLY_QUEUE_LEN * sizeof (reply) +
+            sizeof (client_cold) + RECV_BUFLEN + REPLY_QUEUE_LEN * FRAME_HDR_LEN;
+
+    /* one block: the hot line, the reply ring, the cold state, the buffer
+     * and the frame headers */
+    if (posix_memalign((void **) &c, CACHE_LINE, size) != 0)
+        SystemFatal("Client Malloc() Failed\n");
+    c->replies = (reply *) (c + 1);
+    c->cold = (client_cold *) (c->replies + REPLY_QUEUE_LEN);
+    c->rbuf = (char *) (c->cold + 1);
+    c->cold->frames = c->rbuf + RECV_BUFLEN;
+    c->cold->sub = -1;
+    c->cold->n_owed = 0;
+
+    c->cold->sa_len = sizeof (c->cold->sa);
     c->quit = false;
+    c->rlen = 0;
+    c->reply_head = 0;
+    c->n_pending = 0;
+    c->reply_off = 0;
+    c->file_fd = -1;
+    c->file_pipe = false;
+    c->co = NULL;
+    c->ready = false;
+    c->binary = false;
     return c;
 }
 
@@ -320,7 +1074,7 @@ client * client_new(void) {
  * @return s Returns the server structure
  */
 server * server_new(void) {
-    server *s = malloc(sizeof (server));
+    server *s = aligned_alloc(CACHE_LINE, sizeof (server));
     if (s == NULL)
         fprintf(stderr, "Server Malloc() Failed\n");
 
@@ -328,8 +1082,58 @@ server * server_new(void) {
     s->n_clients = 0;
     s->n_max_connected = 0;
     s->n_max_bytes_received = 0;
+    s->n_requests = 0;
+    s->cost = NULL;
+    s->file_dir = -1;
+    s->kv = NULL;
+    s->ps = NULL;
+    s->ps_local = NULL;
+    s->tcp_samples = NULL;
+    s->trace = NULL;
+    s->quiet = false;
+
+    s->batch_size = EPOLL_QUEUE_LEN;
+    s->max_batch_size = EPOLL_QUEUE_LEN;
+    s->spin_us = 0;
+    s->n_wakeups = 0;
+    s->n_events = 0;
+    s->n_spin_wakeups = 0;
+    s->n_listen_wakeups = 0;
+    s->n_accept_misses = 0;
+    s->events = NULL;
+
+    s->listen_sd = -1;
+    s->unix_sd = -1;
+    s->tcp = true;
+    s->unix_path = NULL;
+    CPU_ZERO(&s->cpus);
+    s->cpu = -1;
+    s->node = -1;
+    s->incoming_cpu = false;
+    s->n_workers = 1;
+    s->workers = NULL;
+    s->parent = NULL;
+    s->accept_mode = -1;
+    s->n_procs = 0;
+    s->slot = NULL;
+    s->slots = NULL;
+    s->coroutines = false;
+    s->coros = NULL;
+    s->load = NULL;
+    s->budget = 0;
+    s->n_deferred = 0;
+    s->n_write_calls = 0;
+    s->n_segs_out = 0;
+    s->ready_head = s->ready_tail = NULL;
+    s->udp = false;
+    s->udp_gso = false;
+    s->udp_srv = NULL;
+    bzero(&s->udp_total, sizeof (udp_stats));
 
     s->e_client_list = llist_new();
+    s->replies = reply_cache_new(client_msg);
+    if (s->replies == NULL)
+        fprintf(stderr, "Reply Cache Failed\n");
 
     /* create the mutexes for controlling access to thread data */
     if (pthread_mutex_init(&s->dataLock, NULL) != 0) {
@@ -340,10 +1144,54 @@ server * server_new(void) {
     return s;
 }
 
+/**
+ * server_worker
+ *
+ * Creates a reactor sharing the configuration and reply cache of the
+ * server. The reactor allocates its event buffer once it runs on its CPU.
+ *
+ * @param parent the server
+ * @param cpu the CPU the reactor runs on, -1 for any
+ * @return the reactor's server structure
+ */
+server* server_worker(server *parent, int cpu) {
+    server *w = aligned_alloc(CACHE_LINE, sizeof (server));
+    if (w == NULL)
+        SystemFatal("Server Malloc() Failed\n");
+
+    memcpy(w, parent, sizeof (server));
+    w->n_clients = 0;
+    w->n_max_connected = 0;
+    w->n_max_bytes_received = 0;
+    w->n_requests = 0;
+    w->n_wakeups = 0;
+    w->n_events = 0;
+    w->n_spin_wakeups = 0;
+    w->n_listen_wakeups = 0;
+    w->n_accept_misses = 0;
+    w->n_deferred = 0;
+    w->n_write_calls = 0;
+    w->n_segs_out = 0;
+    w->udp_srv = NULL;
+    w->ps_local = NULL;
+    w->cpu = cpu;
+    w->n_workers = 1;
+    w->workers = NULL;
+    w->parent = parent;
+    w->load = parent->load != NULL ? overload_clone(parent->load) : NULL;
+    w->tcp_samples = parent->tcp_samples != NULL ? tcp_sampler_clone(parent->tcp_samples) : NULL;
+    w->e_client_list = llist_new();
+    if (pthread_mutex_init(&w->dataLock, NULL) != 0)
+        SystemFatal("pthread_mutex_init() Failed\n");
+
+    return w;
+}
+
 /**
  * server_init
  *
- * Creates a socket and puts the socket into a listening mode
+ * Creates a socket and puts the socket into a listening mode, unless the
+ * server listens on its Unix socket alone.
  *
  * @param s server structure variable.
  */
@@ -351,6 +1199,9 @@ void server_init(server * s) {
     const int on = 1;
     struct sockaddr_in servaddr;
 
+    if (!s->tcp)
+        return;
+
     /* create TCP socket to listen for client connections */
     fprintf(stderr, "> Creating TCP socket\n");
     s->listen_sd = socket(AF_INET, SOCK_STREAM, 0);
@@ -360,6 +1211,14 @@ void server_init(server * s) {
     /* set the socket to allow re-bind to same port without wait issues */
     setsockopt(s->listen_sd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof (int));
 
+    /* reactors each bind their own socket and the kernel spreads connections
+     * between them, preferring the one on the CPU that took the packet */
+    if (s->accept_mode == ACCEPT_REUSEPORT)
+        setsockopt(s->listen_sd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof (int));
+    if (s->incoming_cpu && s->cpu >= 0 &&
+            setsockopt(s->listen_sd, SOL_SOCKET, SO_INCOMING_CPU, &s->cpu, sizeof (int)) < 0)
+        fprintf(stderr, "> CPU %d: SO_INCOMING_CPU not supported\n", s->cpu);
+
     /* make the server Socket non-blocking */
     if (fcntl(s->listen_sd, F_SETFL, O_NONBLOCK | fcntl(s->listen_sd, F_GETFL, 0)) == -1)
         SystemFatal("fcntl(): Server Non-Block Failed\n");
@@ -389,10 +1248,103 @@ void server_init(server * s) {
  * @param s
  */
 void print_server_data(server * s) {
+    unsigned long task_wakeups, total_wakeups = 0;
+    server *w;
+    int i;
+
+    /* the reactors' counters add up to the server's */
+    if (s->workers != NULL) {
+        s->n_max_connected = s->n_max_bytes_received = s->n_clients = 0;
+        s->n_wakeups = s->n_events = s->n_spin_wakeups = 0;
+        s->n_listen_wakeups = s->n_accept_misses = s->n_deferred = 0;
+        s->n_write_calls = s->n_segs_out = 0;
+        bzero(&s->udp_total, sizeof (udp_stats));
+        for (i = 0; i < s->n_workers; i++) {
+            w = s->workers[i];
+            s->n_max_connected += w->n_max_connected;
+            s->n_max_bytes_received += w->n_max_bytes_received;
+            s->n_clients += w->n_clients;
+            s->n_wakeups += w->n_wakeups;
+            s->n_events += w->n_events;
+            s->n_spin_wakeups += w->n_spin_wakeups;
+            s->n_listen_wakeups += w->n_listen_wakeups;
+            s->n_accept_misses += w->n_accept_misses;
+            s->n_deferred += w->n_deferred;
+            s->n_write_calls += w->n_write_calls;
+            s->n_segs_out += w->n_segs_out;
+            if (w->max_batch_size > s->max_batch_size)
+                s->max_batch_size = w->max_batch_size;
+            if (w->load != NULL)
+                overload_merge(s->load, w->load);
+            if (w->udp_srv != NULL)
+                udp_merge(&s->udp_total, &w->udp_srv->stats);
+            if (w->tcp_samples != NULL)
+                tcp_sample_merge(s->tcp_samples, w->tcp_samples);
+        }
+    }
+
     fprintf(stdout, "\n\n[===========================================]\n");
+    if (s->n_procs > 0)
+        prefork_print(s);
     fprintf(stdout, "[ Total Clients Connected: %d\n", s->n_max_connected);
     fprintf(stdout, "[ Total Bytes Received: %d\n", s->n_max_bytes_received);
     fprintf(stdout, "[ Total Active Clients: %d\n", s->n_clients);
+    fprintf(stdout, "[ Epoll Wakeups: %lu (%lu while spinning)\n",
+            s->n_wakeups, s->n_spin_wakeups);
+    fprintf(stdout, "[ Events/Wakeup: %.2lf\n", s->n_wakeups ?
+            (double) s->n_events / s->n_wakeups : 0.0);
+    fprintf(stdout, "[ Batch Size: %d (max %d)\n", s->batch_size, s->max_batch_size);
+    if (s->accept_mode >= 0)
+        fprintf(stdout, "[ Accept Mode: %s\n", accept_modes[s->accept_mode]);
+    fprintf(stdout, "[ Listen Wakeups: %lu (%lu without a connection)\n",
+            s->n_listen_wakeups, s->n_accept_misses);
+    fprintf(stdout, "[ Listen Wakeups/Accept: %.2lf\n", s->n_max_connected ?
+            (double) s->n_listen_wakeups / s->n_max_connected : 0.0);
+    if (s->budget > 0)
+        fprintf(stdout, "[ Read Budget: %d requests/turn, %lu turns deferred\n",
+                s->budget, s->n_deferred);
+    client_flush_print(s);
+    if (s->workers == NULL && s->cpu >= 0)
+        fprintf(stdout, "[ Reactor CPU: %d (node %d)\n", s->cpu, s->node);
+    for (i = 0; s->workers != NULL && i < s->n_workers; i++) {
+        w = s->workers[i];
+        task_wakeups = cpu_task_wakeups(s->pid, w->task);
+        if (w->cpu >= 0)
+            fprintf(stdout, "[ CPU %3d (node %d): ", w->cpu, w->node);
+        else
+            fprintf(stdout, "[ Reactor %3d (any CPU): ", i);
+        fprintf(stdout, "%d clients, %lu requests, %lu wakeups, %.2lf events/wakeup, "
+                "%lu listen wakeups, %lu thread wakeups\n", w->n_max_connected, w->n_requests,
+                w->n_wakeups, w->n_wakeups ? (double) w->n_events / w->n_wakeups : 0.0,
+                w->n_listen_wakeups, task_wakeups);
+        total_wakeups += task_wakeups;
+    }
+    if (total_wakeups > 0 && s->n_max_connected > 0)
+        fprintf(stdout, "[ Thread Wakeups/Accept: %.2lf\n",
+                (double) total_wakeups / s->n_max_connected);
+    if (s->load != NULL)
+        overload_print(s->load);
+    if (s->udp_srv != NULL)
+        s->udp_total = s->udp_srv->stats;
+    if (s->udp)
+        udp_print(&s->udp_total, s->udp_gso);
+    if (s->kv != NULL)
+        kv_print(s->kv);
+    if (s->ps != NULL)
+        pubsub_print(s->ps);
+    if (s->tcp_samples != NULL)
+        tcp_sample_print(s->tcp_samples);
+    if (s->trace != NULL)
+        trace_print(s->trace);
+    if (s->coros != NULL)
+        coro_pool_print(s->coros);
+    for (i = 0; s->workers != NULL && i < s->n_workers; i++) {
+        if (s->workers[i]->coros != NULL)
+            coro_pool_print(s->workers[i]->coros);
+    }
+    reply_cache_print(s->replies);
+    if (s->cost != NULL)
+        cpu_cost_print(s->cost);
     fprintf(stdout, "[===========================================]\n\n");
 }
 
@@ -409,7 +1361,10 @@ void signal_Handler(int signo) {
             fprintf(stderr, "\nReceived SIGINT signal\n");
             running = false;
             close(serv->listen_sd);
+            unix_unlink(serv->unix_path);
             print_server_data(serv);
+            if (serv->n_procs > 0)
+                prefork_stop(serv);
             exit(EXIT_FAILURE);
             break;
 
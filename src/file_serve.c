@@ -0,0 +1,104 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		file_serve.c - Zero-copy file transfers for e_svr
+--
+--	FUNCTIONS:			sendfile, splice
+--
+--	DATE:				October 19, 2026
+--
+--	NOTES:
+--	"get NAME\n" streams the file NAME from the configured directory. The
+--	reply is a header line followed by the data: the file size for a regular
+--	file, "stream" for a pipe (the data ends when the server closes the
+--	connection, a pipe without a writer is at end of file straight away) or
+--	"error" when the file cannot be opened. Regular files are
+--	sent with sendfile and pipes with splice, so the data never passes
+--	through user space; the buffered mode reads the file into a bounce
+--	buffer and writes it instead, for comparison. A client has at most one
+--	file in flight, its offset is the reply offset of its queue entry.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+
+#define FILE_BOUNCE_LEN (64 * 1024)
+
+bool file_buffered = false;
+static __thread char bounce[FILE_BOUNCE_LEN];
+
+/**
+ * client_queue_file
+ *
+ * Opens a file in the serving directory and queues its header and data on
+ * the client. Names may not contain a '/' or start with a '.'.
+ *
+ * @param c the client
+ * @param dir_fd the serving directory
+ * @param name the file name, not NUL terminated
+ * @param name_len the length of the name
+ * @return false, without queuing, if the client has no room for a file
+ */
+bool client_queue_file(client *c, int dir_fd, const char *name, int name_len) {
+    char path[256];
+    struct stat st;
+    int fd;
+
+    if (c->file_fd >= 0 || REPLY_QUEUE_LEN - c->n_pending < 2)
+        return false;
+
+    if (name_len <= 0 || name_len >= (int) sizeof (path) || name[0] == '.' ||
+            memchr(name, '/', name_len) != NULL) {
+        client_queue_reply(c, "error\n", 6);
+        return true;
+    }
+    memcpy(path, name, name_len);
+    path[name_len] = '\0';
+
+    if ((fd = openat(dir_fd, path, O_RDONLY | O_NONBLOCK | O_NOFOLLOW)) < 0) {
+        client_queue_reply(c, "error\n", 6);
+        return true;
+    }
+    if (fstat(fd, &st) < 0 || !(S_ISREG(st.st_mode) || S_ISFIFO(st.st_mode))) {
+        close(fd);
+        client_queue_reply(c, "error\n", 6);
+        return true;
+    }
+
+    c->file_fd = fd;
+    c->file_pipe = S_ISFIFO(st.st_mode);
+    if (c->file_pipe)
+        client_queue_reply(c, "stream\n", 7);
+    else
+        client_queue_reply(c, c->cold->file_hdr, sprintf(c->cold->file_hdr, "%ld\n", (long) st.st_size));
+
+    /* the data entry, a pipe is sent until it reaches end of file */
+    client_queue_reply(c, NULL, c->file_pipe ? -1 : st.st_size);
+    c->replies[(c->reply_head + c->n_pending - 1) % REPLY_QUEUE_LEN].fd = fd;
+    return true;
+}
+
+/**
+ * file_send
+ *
+ * Sends the next part of the client's file.
+ *
+ * @param c the client
+ * @param r the file's queue entry
+ * @return the number of bytes sent, 0 at end of file, -1 on error
+ */
+ssize_t file_send(client *c, reply *r) {
+    off_t off = c->reply_off;
+    size_t left = r->len < 0 ? FILE_BOUNCE_LEN * 16 : (size_t) (r->len - c->reply_off);
+    ssize_t n;
+
+    if (c->file_pipe)
+        return splice(r->fd, NULL, c->fd, NULL, left, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+    if (!file_buffered)
+        return sendfile(c->fd, r->fd, &off, left);
+
+    /* what the socket does not take is read again next time */
+    if ((n = pread(r->fd, bounce, left < FILE_BOUNCE_LEN ? left : FILE_BOUNCE_LEN, off)) <= 0)
+        return n;
+    return write(c->fd, bounce, n);
+}
@@ -0,0 +1,134 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		hist.c - Log-linear latency histogram
+--
+--	DATE:				October 19, 2026
+--
+--	NOTES:
+--	Values are counted in buckets of 16 linear steps per power of two, so a
+--	percentile is accurate to within 1/16 of its value over the full 64 bit
+--	range with a fixed 8 KB of counters. Histograms of several threads are
+--	combined with hist_merge.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+
+/**
+ * hist_index
+ *
+ * @param v the value
+ * @return the bucket counting v
+ */
+static int hist_index(uint64_t v) {
+    int msb;
+
+    if (v < HIST_SUB)
+        return (int) v;
+    msb = 63 - __builtin_clzll(v);
+    return (msb - HIST_SUB_BITS + 1) * HIST_SUB +
+            (int) ((v >> (msb - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+/**
+ * hist_value
+ *
+ * @param i a bucket
+ * @return the middle of the values counted in bucket i
+ */
+static uint64_t hist_value(int i) {
+    int msb;
+
+    if (i < HIST_SUB)
+        return i;
+    msb = i / HIST_SUB + HIST_SUB_BITS - 1;
+    return ((uint64_t) (HIST_SUB + i % HIST_SUB) << (msb - HIST_SUB_BITS)) +
+            ((1ULL << (msb - HIST_SUB_BITS)) >> 1);
+}
+
+/**
+ * hist_init
+ *
+ * @param h the histogram to clear
+ */
+void hist_init(hist *h) {
+    memset(h, 0, sizeof (hist));
+}
+
+/**
+ * hist_add
+ *
+ * Counts one value.
+ *
+ * @param h the histogram
+ * @param v the value
+ */
+void hist_add(hist *h, uint64_t v) {
+    h->bucket[hist_index(v)]++;
+    h->count++;
+    h->sum += v;
+    if (v > h->max)
+        h->max = v;
+}
+
+/**
+ * hist_merge
+ *
+ * Adds the counts of one histogram to another.
+ *
+ * @param h the histogram to add to
+ * @param o the histogram to add
+ */
+void hist_merge(hist *h, const hist *o) {
+    int i;
+
+    for (i = 0; i < HIST_BUCKETS; i++)
+        h->bucket[i] += o->bucket[i];
+    h->count += o->count;
+    h->sum += o->sum;
+    if (o->max > h->max)
+        h->max = o->max;
+}
+
+/**
+ * hist_percentile
+ *
+ * @param h the histogram
+ * @param p the percentile, 0 to 100
+ * @return the value below which p percent of the values fall
+ */
+uint64_t hist_percentile(const hist *h, double p) {
+    uint64_t seen = 0, rank;
+    int i;
+
+    if (h->count == 0)
+        return 0;
+    rank = (uint64_t) (h->count * p / 100.0);
+    if (rank >= h->count)
+        rank = h->count - 1;
+
+    for (i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->bucket[i];
+        if (seen > rank)
+            return hist_value(i) < h->max ? hist_value(i) : h->max;
+    }
+    return h->max;
+}
+
+/**
+ * hist_print
+ *
+ * Prints the count, mean and main percentiles of a histogram.
+ *
+ * @param h the histogram
+ * @param name what the values are
+ * @param unit the unit of the values
+ */
+void hist_print(const hist *h, const char *name, const char *unit) {
+    fprintf(stdout, "[ %s (%s): n=%llu mean=%.1lf p50=%llu p90=%llu p99=%llu "
+            "p99.9=%llu max=%llu\n", name, unit, (unsigned long long) h->count,
+            h->count ? (double) h->sum / h->count : 0.0,
+            (unsigned long long) hist_percentile(h, 50),
+            (unsigned long long) hist_percentile(h, 90),
+            (unsigned long long) hist_percentile(h, 99),
+            (unsigned long long) hist_percentile(h, 99.9),
+            (unsigned long long) h->max);
+}
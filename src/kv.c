@@ -0,0 +1,684 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		kv.c - Key value cache behind the request protocol
+--
+--	FUNCTIONS:			mmap, pthread_mutex_lock
+--
+--	DATE:				October 19, 2026
+--
+--	NOTES:
+--	With -K the servers answer "get KEY", "set KEY VALUE" and "del KEY"
+--	from a cache of at most the given number of megabytes, instead of
+--	serving files. A hit is answered with the value's length on a line and
+--	the value, as a file is; a miss with "miss\n", a set with "stored\n"
+--	and a delete with "deleted\n" or "miss\n".
+--
+--	The items live in slab classes of chunk sizes 25% apart, carved out of
+--	1 MB pages until the cap is reached; after that a set takes the least
+--	recently used item of its class. The keys are found through an open
+--	addressing table with linear probing, deleted slots are left as
+--	tombstones and cleared when they fill an eighth of the table.
+--
+--	Writers take one lock. Readers take none: every key hashes to one of
+--	KV_STRIPES sequence counters that a writer makes odd while it changes
+--	an item of that stripe, a reader copies the value and tries again if
+--	its counter moved, the seqlock scheme. A reader may read an item that
+--	is being freed or reused, so chunks are never handed back to the
+--	system and the copy is bounded by the largest value. A get does not
+--	move the item in its list, it marks it used and eviction gives a
+--	marked item a second turn, so the LRU order is approximate and the
+--	reads write nothing shared but the mark and their counters.
+--
+--	All of it is in one shared mapping, locked with a process shared
+--	mutex, so prefork workers share the cache as reactor threads do.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+#include <sys/mman.h>
+
+#define KV_PAGE (1024 * 1024) // slab page, holds at least one largest item
+#define KV_MIN_CHUNK 64
+#define KV_CLASSES 32
+#define KV_STRIPES 1024
+#define KV_STAT_SLOTS 64 // counters of up to this many threads apart
+#define KV_TOMB ((kv_item *) 1) // a deleted slot, probing goes on past it
+#define KV_ITEM_MAX ((int) (sizeof (kv_item) + KV_KEY_MAX + KV_VALUE_MAX + 7) & ~7)
+
+typedef struct _kv_item kv_item;
+typedef struct _kv_class kv_class;
+typedef struct _kv_stat kv_stat;
+
+struct _kv_item {
+    kv_item *prev; /* the class LRU list, most recent first */
+    kv_item *next; /* also the free list */
+    uint32_t hash;
+    uint32_t slot; /* in the table */
+    uint32_t vlen;
+    uint16_t klen;
+    uint8_t cls;
+    uint8_t used; /* read since it last came up for eviction */
+    char data[]; /* the key, then the value */
+};
+
+struct _kv_class {
+    int size; /* chunk size */
+    kv_item *free;
+    kv_item *head;
+    kv_item *tail;
+    unsigned long n_items;
+    unsigned long n_pages;
+    unsigned long n_evictions;
+};
+
+/* a thread's counters, each on its own line */
+struct _kv_stat {
+    unsigned long n_gets;
+    unsigned long n_hits;
+    unsigned long n_sets;
+    unsigned long n_dels;
+    unsigned long n_retries; /* reads repeated after a concurrent write */
+} __attribute__((aligned(CACHE_LINE)));
+
+struct _kv {
+    pthread_mutex_t lock; /* writers */
+    unsigned int gen; /* odd while the table is rebuilt */
+    int n_classes;
+    kv_class classes[KV_CLASSES];
+    kv_item **table;
+    uint32_t mask;
+    unsigned long n_live;
+    unsigned long n_tombs;
+    unsigned long n_rebuilds;
+    unsigned long n_failed; /* sets without a chunk, the class got no page */
+    char *slabs; /* the pages, handed out from the front */
+    size_t slabs_len;
+    size_t slabs_used;
+    int n_stat_slots;
+    size_t map_len;
+    unsigned int seq[KV_STRIPES] __attribute__((aligned(CACHE_LINE)));
+    kv_stat stats[KV_STAT_SLOTS];
+};
+
+static __thread int stat_slot = -1;
+
+/**
+ * kv_hash
+ *
+ * @param key the key
+ * @param klen its length
+ * @return the FNV-1a hash of the key
+ */
+static uint32_t kv_hash(const char *key, int klen) {
+    uint32_t h = 2166136261u;
+    int i;
+
+    for (i = 0; i < klen; i++)
+        h = (h ^ (unsigned char) key[i]) * 16777619u;
+    return h;
+}
+
+/**
+ * kv_stats
+ *
+ * @param k the cache
+ * @return the calling thread's counters
+ */
+static kv_stat* kv_stats(kv *k) {
+    if (stat_slot < 0)
+        stat_slot = __atomic_fetch_add(&k->n_stat_slots, 1, __ATOMIC_RELAXED) % KV_STAT_SLOTS;
+    return &k->stats[stat_slot];
+}
+
+/**
+ * kv_count
+ *
+ * Bumps a thread's counter. Threads past KV_STAT_SLOTS share slots, so
+ * the add is atomic, but uncontended it costs little more than a plain one.
+ *
+ * @param n the counter
+ */
+static inline void kv_count(unsigned long *n) {
+    __atomic_fetch_add(n, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * kv_pause
+ *
+ * Waits a moment for a writer.
+ */
+static inline void kv_pause(void) {
+#if defined(__x86_64__)
+    __builtin_ia32_pause();
+#else
+    sched_yield();
+#endif
+}
+
+/**
+ * kv_write_begin
+ *
+ * Makes a stripe's counter odd, readers of its keys wait.
+ *
+ * @param seq the counter
+ */
+static inline void kv_write_begin(unsigned int *seq) {
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/**
+ * kv_write_end
+ *
+ * @param seq the counter, even again
+ */
+static inline void kv_write_end(unsigned int *seq) {
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * kv_new
+ *
+ * Creates a cache in a shared mapping, so forked workers share it.
+ *
+ * @param cap_mb the memory for items, in megabytes
+ * @return the cache, NULL on failure
+ */
+kv* kv_new(long cap_mb) {
+    pthread_mutexattr_t attr;
+    size_t table_len, slots, len;
+    kv *k;
+    char *mem;
+    int size, i;
+
+    if (cap_mb < 1)
+        return NULL;
+
+    /* a slot for each chunk of the smallest class */
+    for (slots = 1024; slots < (size_t) cap_mb * 1024 * 1024 / KV_MIN_CHUNK; slots <<= 1)
+        ;
+    table_len = slots * sizeof (kv_item *);
+
+    /* a reader may copy past the last chunk from a reused one */
+    len = sizeof (kv) + table_len + (size_t) cap_mb * 1024 * 1024 + KV_PAGE;
+    mem = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+        return NULL;
+    k = (kv *) mem;
+    k->map_len = len;
+    k->table = (kv_item **) (mem + sizeof (kv));
+    k->mask = slots - 1;
+    k->slabs = mem + sizeof (kv) + table_len;
+    k->slabs_len = (size_t) cap_mb * 1024 * 1024;
+
+    /* chunks stay 8 byte aligned, the last class holds the largest item */
+    for (size = KV_MIN_CHUNK, i = 0; i < KV_CLASSES - 1 && size < KV_ITEM_MAX; i++) {
+        k->classes[i].size = size;
+        size = (size + size / 4 + 7) & ~7;
+    }
+    k->classes[i].size = KV_ITEM_MAX;
+    k->n_classes = i + 1;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&k->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    return k;
+}
+
+/**
+ * kv_free
+ *
+ * Unmaps a cache no thread uses any more.
+ *
+ * @param k the cache
+ */
+void kv_free(kv *k) {
+    pthread_mutex_destroy(&k->lock);
+    munmap(k, k->map_len);
+}
+
+/**
+ * kv_find
+ *
+ * @param k the cache
+ * @param key the key
+ * @param klen its length
+ * @param h its hash
+ * @param it receives the key's item, NULL if it is not cached
+ * @return the key's slot, or the slot to insert it at, UINT32_MAX if the
+ * table has none
+ */
+static uint32_t kv_find(kv *k, const char *key, int klen, uint32_t h, kv_item **it) {
+    uint32_t i, tomb = UINT32_MAX, n;
+    kv_item *e;
+
+    for (i = h & k->mask, n = 0; n <= k->mask; i = (i + 1) & k->mask, n++) {
+        e = k->table[i];
+        if (e == NULL)
+            break;
+        if (e == KV_TOMB) {
+            if (tomb == UINT32_MAX)
+                tomb = i;
+            continue;
+        }
+        if (e->hash == h && e->klen == klen && memcmp(e->data, key, klen) == 0) {
+            *it = e;
+            return i;
+        }
+    }
+    *it = NULL;
+    if (tomb != UINT32_MAX)
+        return tomb;
+    return n <= k->mask ? i : UINT32_MAX;
+}
+
+/**
+ * kv_release
+ *
+ * Takes an item out of its class list and frees its chunk. The caller
+ * holds the lock and has the item's stripe odd.
+ *
+ * @param k the cache
+ * @param it the item
+ */
+static void kv_release(kv *k, kv_item *it) {
+    kv_class *cl = &k->classes[it->cls];
+
+    if (it->prev != NULL)
+        it->prev->next = it->next;
+    else
+        cl->head = it->next;
+    if (it->next != NULL)
+        it->next->prev = it->prev;
+    else
+        cl->tail = it->prev;
+    cl->n_items--;
+    it->next = cl->free;
+    cl->free = it;
+}
+
+/**
+ * kv_unlink
+ *
+ * Takes an item out of the table, leaving a tombstone, and frees it. The
+ * caller holds the lock.
+ *
+ * @param k the cache
+ * @param it the item
+ */
+static void kv_unlink(kv *k, kv_item *it) {
+    unsigned int *seq = &k->seq[it->hash % KV_STRIPES];
+
+    kv_write_begin(seq);
+    __atomic_store_n(&k->table[it->slot], KV_TOMB, __ATOMIC_RELAXED);
+    k->n_live--;
+    k->n_tombs++;
+    kv_release(k, it);
+    kv_write_end(seq);
+}
+
+/**
+ * kv_rebuild
+ *
+ * Clears the tombstones by inserting every item into an empty table.
+ * Readers wait on the table's generation meanwhile.
+ *
+ * @param k the cache
+ */
+static void kv_rebuild(kv *k) {
+    kv_item *it;
+    uint32_t i;
+    int c;
+
+    kv_write_begin(&k->gen);
+    memset(k->table, 0, ((size_t) k->mask + 1) * sizeof (kv_item *));
+    for (c = 0; c < k->n_classes; c++) {
+        for (it = k->classes[c].head; it != NULL; it = it->next) {
+            for (i = it->hash & k->mask; k->table[i] != NULL; i = (i + 1) & k->mask)
+                ;
+            k->table[i] = it;
+            it->slot = i;
+        }
+    }
+    k->n_tombs = 0;
+    k->n_rebuilds++;
+    kv_write_end(&k->gen);
+}
+
+/**
+ * kv_evict
+ *
+ * Frees the least recently used item of a class. An item read since it
+ * last came up goes to the front instead, once.
+ *
+ * @param k the cache
+ * @param cl the class
+ * @return false if the class has no items
+ */
+static bool kv_evict(kv *k, kv_class *cl) {
+    kv_item *it;
+
+    while ((it = cl->tail) != NULL && __atomic_load_n(&it->used, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&it->used, 0, __ATOMIC_RELAXED);
+        if (it == cl->head)
+            break;
+        cl->tail = it->prev;
+        cl->tail->next = NULL;
+        it->prev = NULL;
+        it->next = cl->head;
+        cl->head->prev = it;
+        cl->head = it;
+    }
+    if (it == NULL)
+        return false;
+    kv_unlink(k, it);
+    cl->n_evictions++;
+    return true;
+}
+
+/**
+ * kv_alloc
+ *
+ * Takes a chunk of a class: a free one, one of a new page while the cap
+ * allows, or the one of an evicted item. The caller holds the lock.
+ *
+ * @param k the cache
+ * @param cls the class
+ * @return the chunk, NULL if there is none
+ */
+static kv_item* kv_alloc(kv *k, int cls) {
+    kv_class *cl = &k->classes[cls];
+    kv_item *it;
+    int i;
+
+    if (cl->free == NULL && k->slabs_used + KV_PAGE <= k->slabs_len) {
+        for (i = 0; i + cl->size <= KV_PAGE; i += cl->size) {
+            it = (kv_item *) (k->slabs + k->slabs_used + i);
+            it->next = cl->free;
+            cl->free = it;
+        }
+        k->slabs_used += KV_PAGE;
+        cl->n_pages++;
+    }
+    if (cl->free == NULL && !kv_evict(k, cl))
+        return NULL;
+    it = cl->free;
+    cl->free = it->next;
+    return it;
+}
+
+/**
+ * kv_get
+ *
+ * Copies a key's value without taking the lock.
+ *
+ * @param k the cache
+ * @param key the key
+ * @param klen its length
+ * @param out receives the value, KV_VALUE_MAX bytes
+ * @return the value's length, -1 for a miss
+ */
+int kv_get(kv *k, const char *key, int klen, char *out) {
+    unsigned int *seq, g, s;
+    kv_stat *st = kv_stats(k);
+    uint32_t h, i, n;
+    kv_item *it;
+    int len;
+
+    h = kv_hash(key, klen);
+    seq = &k->seq[h % KV_STRIPES];
+    kv_count(&st->n_gets);
+    for (;;) {
+        g = __atomic_load_n(&k->gen, __ATOMIC_ACQUIRE);
+        s = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+        if ((g | s) & 1) {
+            kv_pause();
+            continue;
+        }
+
+        len = -1;
+        for (i = h & k->mask, n = 0; n <= k->mask; i = (i + 1) & k->mask, n++) {
+            it = __atomic_load_n(&k->table[i], __ATOMIC_RELAXED);
+            if (it == NULL)
+                break;
+            if (it == KV_TOMB || it->hash != h || it->klen != klen ||
+                    memcmp(it->data, key, klen) != 0)
+                continue;
+            len = it->vlen;
+            if (len > KV_VALUE_MAX)
+                len = KV_VALUE_MAX; // a chunk being reused
+            memcpy(out, it->data + klen, len);
+            __atomic_store_n(&it->used, 1, __ATOMIC_RELAXED);
+            break;
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&k->gen, __ATOMIC_RELAXED) == g &&
+                __atomic_load_n(seq, __ATOMIC_RELAXED) == s)
+            break;
+        kv_count(&st->n_retries);
+    }
+    if (len >= 0)
+        kv_count(&st->n_hits);
+    return len;
+}
+
+/**
+ * kv_set
+ *
+ * Stores a value under a key, replacing the value it had.
+ *
+ * @param k the cache
+ * @param key the key
+ * @param klen its length, at most KV_KEY_MAX
+ * @param val the value
+ * @param vlen its length, at most KV_VALUE_MAX
+ * @return false if there was no memory for it
+ */
+bool kv_set(kv *k, const char *key, int klen, const char *val, int vlen) {
+    unsigned int *seq;
+    kv_item *it, *old;
+    kv_class *cl;
+    uint32_t h, i;
+    int cls;
+
+    if (klen <= 0 || klen > KV_KEY_MAX || vlen < 0 || vlen > KV_VALUE_MAX)
+        return false;
+    for (cls = 0; k->classes[cls].size < (int) sizeof (kv_item) + klen + vlen; cls++)
+        ;
+    kv_count(&kv_stats(k)->n_sets);
+    h = kv_hash(key, klen);
+    seq = &k->seq[h % KV_STRIPES];
+
+    pthread_mutex_lock(&k->lock);
+    if (k->n_live + k->n_tombs >= (k->mask + 1) - (k->mask + 1) / 8) {
+        if (k->n_tombs > 0)
+            kv_rebuild(k);
+        /* a table full of small items makes room like a full class */
+        while (k->n_live >= (k->mask + 1) - (k->mask + 1) / 8 && kv_evict(k, &k->classes[cls]))
+            ;
+    }
+
+    /* the chunk first, its eviction may touch this key's stripe */
+    if ((it = kv_alloc(k, cls)) == NULL) {
+        k->n_failed++;
+        pthread_mutex_unlock(&k->lock);
+        return false;
+    }
+    it->hash = h;
+    it->klen = klen;
+    it->vlen = vlen;
+    it->cls = cls;
+    it->used = 0;
+    memcpy(it->data, key, klen);
+    memcpy(it->data + klen, val, vlen);
+
+    if ((i = kv_find(k, key, klen, h, &old)) == UINT32_MAX) {
+        /* no slot, the eviction above keeps one free */
+        it->next = k->classes[cls].free;
+        k->classes[cls].free = it;
+        k->n_failed++;
+        pthread_mutex_unlock(&k->lock);
+        return false;
+    }
+
+    /* the new item takes the old one's slot, readers see one or the other */
+    kv_write_begin(seq);
+    if (old != NULL)
+        kv_release(k, old);
+    else if (k->table[i] == KV_TOMB)
+        k->n_tombs--;
+    __atomic_store_n(&k->table[i], it, __ATOMIC_RELAXED);
+    kv_write_end(seq);
+    it->slot = i;
+    if (old == NULL)
+        k->n_live++;
+
+    cl = &k->classes[cls];
+    it->prev = NULL;
+    it->next = cl->head;
+    if (cl->head != NULL)
+        cl->head->prev = it;
+    cl->head = it;
+    if (cl->tail == NULL)
+        cl->tail = it;
+    cl->n_items++;
+    pthread_mutex_unlock(&k->lock);
+    return true;
+}
+
+/**
+ * kv_del
+ *
+ * @param k the cache
+ * @param key the key
+ * @param klen its length
+ * @return false if the key was not cached
+ */
+bool kv_del(kv *k, const char *key, int klen) {
+    kv_item *it;
+    uint32_t h;
+
+    kv_count(&kv_stats(k)->n_dels);
+    h = kv_hash(key, klen);
+    pthread_mutex_lock(&k->lock);
+    kv_find(k, key, klen, h, &it);
+    if (it != NULL)
+        kv_unlink(k, it);
+    pthread_mutex_unlock(&k->lock);
+    return it != NULL;
+}
+
+/**
+ * kv_reply
+ *
+ * Carries out a cache command and forms its reply.
+ *
+ * @param k the cache
+ * @param r a CMD_GET, CMD_SET or CMD_DEL request
+ * @param out room for the reply to a get, KV_REPLY_MAX bytes
+ * @param reply receives the reply, out or a constant
+ * @return the reply's length
+ */
+int kv_reply(kv *k, proto_req *r, char *out, const char **reply) {
+    const char *key = r->cmd + r->arg, *sp;
+    int klen = r->cmd_len - r->arg, vlen, n;
+
+    switch (r->type) {
+        case CMD_GET:
+            if ((vlen = kv_get(k, key, klen, out + 16)) < 0)
+                break;
+            n = snprintf(out, 16, "%d\n", vlen);
+            memmove(out + n, out + 16, vlen);
+            *reply = out;
+            return n + vlen;
+        case CMD_SET:
+            /* the value is the rest of the line after the key */
+            if ((sp = memchr(key, ' ', klen)) == NULL ||
+                    !kv_set(k, key, sp - key, sp + 1, klen - (sp - key) - 1)) {
+                *reply = "error\n";
+                return 6;
+            }
+            *reply = "stored\n";
+            return 7;
+        case CMD_DEL:
+            if (!kv_del(k, key, klen))
+                break;
+            *reply = "deleted\n";
+            return 8;
+    }
+    *reply = "miss\n";
+    return 5;
+}
+
+/**
+ * client_queue_kv
+ *
+ * Carries out a cache command and queues its reply. A value is copied,
+ * the cache may drop it before the reply is sent.
+ *
+ * @param c the client
+ * @param k the cache
+ * @param r the request
+ * @return false, without carrying it out, if the reply queue is full
+ */
+bool client_queue_kv(client *c, kv *k, proto_req *r) {
+    char out[KV_REPLY_MAX];
+    const char *reply;
+    char *copy;
+    int len;
+
+    if (c->n_pending == REPLY_QUEUE_LEN)
+        return false;
+    len = kv_reply(k, r, out, &reply);
+    if (reply != out) {
+        client_queue_reply(c, reply, len);
+        return true;
+    }
+    if ((copy = malloc(len)) == NULL) {
+        client_queue_reply(c, "error\n", 6);
+        return true;
+    }
+    memcpy(copy, out, len);
+    client_queue_reply(c, copy, len);
+    c->replies[(c->reply_head + c->n_pending - 1) % REPLY_QUEUE_LEN].owned = true;
+    return true;
+}
+
+/**
+ * kv_print
+ *
+ * Prints the cache's counters, the threads' added up.
+ *
+ * @param k the cache
+ */
+void kv_print(kv *k) {
+    kv_stat t;
+    unsigned long items = 0, evictions = 0;
+    int i;
+
+    bzero(&t, sizeof (t));
+    for (i = 0; i < KV_STAT_SLOTS; i++) {
+        t.n_gets += k->stats[i].n_gets;
+        t.n_hits += k->stats[i].n_hits;
+        t.n_sets += k->stats[i].n_sets;
+        t.n_dels += k->stats[i].n_dels;
+        t.n_retries += k->stats[i].n_retries;
+    }
+    for (i = 0; i < k->n_classes; i++) {
+        items += k->classes[i].n_items;
+        evictions += k->classes[i].n_evictions;
+    }
+    fprintf(stdout, "[ KV Cache: %lu items, %zu of %zu MB in slab pages, %u table slots\n",
+            items, k->slabs_used >> 20, k->slabs_len >> 20, k->mask + 1);
+    fprintf(stdout, "[ KV Ops: %lu gets (%.1lf%% hits), %lu sets (%lu failed), %lu dels\n",
+            t.n_gets, t.n_gets ? 100.0 * t.n_hits / t.n_gets : 0.0, t.n_sets,
+            k->n_failed, t.n_dels);
+    fprintf(stdout, "[ KV Evictions: %lu, %lu table rebuilds, %lu read retries\n",
+            evictions, k->n_rebuilds, t.n_retries);
+    for (i = 0; i < k->n_classes; i++) {
+        if (k->classes[i].n_pages > 0)
+            fprintf(stdout, "[ KV Class %5d B: %lu items, %lu pages, %lu evictions\n",
+                    k->classes[i].size, k->classes[i].n_items, k->classes[i].n_pages,
+                    k->classes[i].n_evictions);
+    }
+}
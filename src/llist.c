@@ -31,11 +31,11 @@ llist *llist_new(void) {
 }
 
 void llist_free(llist *l, void (*free_func)(void *)) {
-    node *n = l->link;
-    while (n) {
+    node *n;
+    while ((n = l->link) != NULL) {
         if (n->data != NULL)
             free_func(n->data);
-        l->link = l->link->next;
+        l->link = n->next;
         free(n);
     }
     free(l);
@@ -0,0 +1,591 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		micro_bench.c - Microbenchmarks of the server building blocks
+--
+--	PROGRAM:			micro_bench
+--						./micro_bench [-r reps] [-w warmup] [-t target_ms] [-f filter]
+--						[-p port] [-o file]
+--
+--	FUNCTIONS:			clock_gettime, fork, execl
+--
+--	DATE:				October 19, 2026
+--
+--	PROGRAMMERS:		Jivanjot Brar & Shan Bains
+--
+--	NOTES:
+--	Times the pieces the servers are built from, each on its own, so a
+--	change to one of them can be measured without a whole system run:
+--	the client list of llist.c at several lengths, the lookup of a client
+--	by its descriptor that e_svr does for every event, the allocation of a
+--	client block, queuing and releasing replies, parsing pipelined
+--	requests of both framings, rebuilding the fd_sets of s_svr, and one
+--	request's round trip over loopback to each server model found next to
+--	the program.
+--
+--	Every case runs a batch of operations sized to take -t milliseconds,
+--	-w batches to warm up and -r timed batches. The time per operation of
+--	each batch is a sample; the results are the median, mean, standard
+--	deviation, 95% confidence interval of the mean, minimum and maximum of
+--	the samples, written as JSON, one case per line, to stdout or -o, so
+--	two runs on different commits can be compared line by line, see
+--	bench/micro.sh. -f runs the cases whose names contain the filter.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+#include <math.h>
+#include <sys/mman.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#define USAGE "Usage: %s [-r reps] [-w warmup] [-t target_ms] [-f filter] [-p port] [-o file]\n"
+
+#define MICRO_MAX_REPS 1000
+#define MICRO_FDSET_BASE 16 // descriptors of the fake clients of the fd_set case
+
+typedef struct _micro_case micro_case;
+
+/* a case times iters operations on its state */
+struct _micro_case {
+    const char *name;
+    long size; /* list length, clients or bytes, 0 for none */
+    void (*setup)(micro_case *);
+    void (*run)(micro_case *, long);
+    void (*teardown)(micro_case *);
+    void *state;
+    const char *model; /* the server of a round trip case */
+};
+
+int reps = 11, warmup = 2, target_ms = 5, port = 7610;
+const char *filter = NULL;
+FILE *out;
+volatile long sink; /* keeps the results of the timed loops alive */
+
+const char client_msg[BUFLEN] =
+        "012345678901234567890123456789012345678901234567890123456789012\n";
+
+/**
+ * now_ns
+ *
+ * @return the monotonic clock in nanoseconds
+ */
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * t95
+ *
+ * @param df degrees of freedom
+ * @return the two sided 95% quantile of Student's t distribution
+ */
+static double t95(int df) {
+    static const double t[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306,
+        2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+
+    if (df < 1)
+        return 0.0;
+    return df <= 30 ? t[df - 1] : 1.96;
+}
+
+/**
+ * cmp_double
+ */
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * fake_client
+ *
+ * @param fd the descriptor the client is known by
+ * @return a client block laid out as client_new lays it out
+ */
+static client* fake_client(int fd) {
+    size_t size = sizeof (client) + REPLY_QUEUE_LEN * sizeof (reply) +
+            sizeof (client_cold) + RECV_BUFLEN + REPLY_QUEUE_LEN * FRAME_HDR_LEN;
+    client *c;
+
+    if (posix_memalign((void **) &c, CACHE_LINE, size) != 0)
+        SystemFatal("posix_memalign(): Failed");
+    bzero(c, sizeof (client));
+    c->replies = (reply *) (c + 1);
+    c->cold = (client_cold *) (c->replies + REPLY_QUEUE_LEN);
+    c->rbuf = (char *) (c->cold + 1);
+    c->cold->frames = c->rbuf + RECV_BUFLEN;
+    c->fd = fd;
+    c->file_fd = -1;
+    return c;
+}
+
+/**
+ * list_setup
+ *
+ * A client list of the case's length, as e_client_list holds them.
+ */
+static void list_setup(micro_case *mc) {
+    llist *l = llist_new();
+    long i;
+
+    for (i = 0; i < mc->size; i++)
+        l = llist_append(l, fake_client(MICRO_FDSET_BASE + i));
+    mc->state = l;
+}
+
+/**
+ * list_teardown
+ */
+static void list_teardown(micro_case *mc) {
+    llist_free((llist *) mc->state, free);
+}
+
+/**
+ * run_list_append_remove
+ *
+ * A client connecting and leaving: appended at the tail and removed.
+ */
+static void run_list_append_remove(micro_case *mc, long iters) {
+    llist *l = (llist *) mc->state;
+    client *c = fake_client(-1);
+
+    while (iters-- > 0) {
+        l = llist_append(l, c);
+        l = llist_remove(l, c, client_compare);
+    }
+    free(c);
+}
+
+/**
+ * run_list_length
+ */
+static void run_list_length(micro_case *mc, long iters) {
+    long n = 0;
+
+    while (iters-- > 0)
+        n += llist_length((llist *) mc->state);
+    sink = n;
+}
+
+/**
+ * run_client_lookup
+ *
+ * The walk of read_from_socket finding the client of an event, for
+ * descriptors spread over the whole list.
+ */
+static void run_client_lookup(micro_case *mc, long iters) {
+    llist *l = (llist *) mc->state;
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    long found = 0;
+    client *c = NULL;
+    node *it;
+    int fd;
+
+    while (iters-- > 0) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        fd = MICRO_FDSET_BASE + rng % mc->size;
+        for (it = l->link; it != NULL; it = it->next) {
+            c = (client *) it->data;
+            if (c->fd == fd || c->file_fd == fd)
+                break;
+        }
+        found += it != NULL && c->fd == fd;
+    }
+    sink = found;
+}
+
+/**
+ * run_client_alloc
+ *
+ * The client block of client_new allocated and freed.
+ */
+static void run_client_alloc(micro_case *mc, long iters) {
+    client *c;
+
+    while (iters-- > 0) {
+        c = fake_client(0);
+        sink += c->fd;
+        free(c);
+    }
+}
+
+/**
+ * replies_setup
+ */
+static void replies_setup(micro_case *mc) {
+    mc->state = reply_cache_new(client_msg);
+    if (mc->state == NULL)
+        SystemFatal("reply_cache_new(): Failed");
+}
+
+/**
+ * replies_teardown
+ */
+static void replies_teardown(micro_case *mc) {
+    reply_cache *rc = (reply_cache *) mc->state;
+    int i;
+
+    for (i = 0; i < REPLY_CLASSES; i++)
+        munmap(rc->buf[i], 1 << (REPLY_MIN_SHIFT + i));
+    free(rc);
+}
+
+/**
+ * run_reply_queue
+ *
+ * A reply of the case's size taken from the reply cache onto a client's
+ * ring and released, as a flush that wrote it would.
+ */
+static void run_reply_queue(micro_case *mc, long iters) {
+    reply_cache *rc = (reply_cache *) mc->state;
+    client *c = fake_client(-1);
+
+    while (iters-- > 0) {
+        client_queue_request(c, rc, mc->size, 0);
+        client_drop_replies(c);
+        c->reply_head = 0;
+    }
+    free(c);
+}
+
+/**
+ * parse_setup
+ *
+ * A receive buffer full of pipelined requests: "request 1024\n" when the
+ * case's size is 0, frames of that many bytes otherwise.
+ */
+static void parse_setup(micro_case *mc) {
+    char *buf = malloc(RECV_BUFLEN);
+    uint32_t v = htonl(1024);
+    const char *cmd = "request 1024\n";
+    int off, n = strlen(cmd);
+
+    if (buf == NULL)
+        SystemFatal("malloc(): Failed");
+    memset(buf, 0, RECV_BUFLEN);
+    if (mc->size == 0) {
+        for (off = 0; off + n <= RECV_BUFLEN; off += n)
+            memcpy(buf + off, cmd, n);
+    } else {
+        for (off = 0; off + mc->size <= RECV_BUFLEN; off += mc->size) {
+            proto_frame_hdr(buf + off, OP_REQUEST, mc->size - FRAME_HDR_LEN, 0);
+            memcpy(buf + off + FRAME_HDR_LEN, &v, 4);
+        }
+    }
+    mc->state = buf;
+}
+
+/**
+ * parse_teardown
+ */
+static void parse_teardown(micro_case *mc) {
+    free(mc->state);
+}
+
+/**
+ * run_parse
+ *
+ * proto_next_req splitting the buffer, one operation per request, going
+ * back to its start when it runs out.
+ */
+static void run_parse(micro_case *mc, long iters) {
+    char *buf = (char *) mc->state;
+    bool binary = mc->size > 0;
+    int off = 0, used;
+    long found = 0;
+    proto_req r;
+
+    while (iters > 0) {
+        used = proto_next_req(binary, buf + off, RECV_BUFLEN - off, &r);
+        if (used == 0 || r.type != CMD_REQUEST) {
+            off = 0;
+            continue;
+        }
+        off += used;
+        found += r.arg;
+        iters--;
+    }
+    sink = found;
+}
+
+/**
+ * run_fdset_rebuild
+ *
+ * The start of every select loop of s_svr: the sets cleared and every
+ * client's descriptor added to them.
+ */
+static void run_fdset_rebuild(micro_case *mc, long iters) {
+    llist *l = (llist *) mc->state;
+    fd_set allset, writeset;
+    int maxfd = 0;
+    client *c;
+    node *n;
+
+    while (iters-- > 0) {
+        FD_ZERO(&allset);
+        FD_ZERO(&writeset);
+        FD_SET(3, &allset);
+        for (n = l->link; n != NULL; n = n->next) {
+            c = (client *) n->data;
+            if (c->n_pending > 0)
+                FD_SET(c->fd, &writeset);
+            else
+                FD_SET(c->fd, &allset);
+            if (c->fd > maxfd)
+                maxfd = c->fd;
+        }
+        sink = maxfd + FD_ISSET(MICRO_FDSET_BASE, &allset);
+    }
+}
+
+/* a server started for a round trip case */
+typedef struct {
+    pid_t pid;
+    int sd;
+} rtt_state;
+
+/**
+ * rtt_setup
+ *
+ * Starts the case's server on the next port and connects to it.
+ */
+static void rtt_setup(micro_case *mc) {
+    struct sockaddr_in addr;
+    rtt_state *st;
+    char port_s[16];
+    int i, devnull;
+
+    mc->state = NULL;
+    if (access(mc->model, X_OK) != 0) {
+        fprintf(stderr, "> %s not built, skipping %s\n", mc->model, mc->name);
+        return;
+    }
+    if ((st = calloc(1, sizeof (rtt_state))) == NULL)
+        SystemFatal("calloc(): Failed");
+    snprintf(port_s, sizeof (port_s), "%d", port);
+    if ((st->pid = fork()) == 0) {
+        devnull = open("/dev/null", O_WRONLY);
+        dup2(devnull, 1);
+        dup2(devnull, 2);
+        execl(mc->model, mc->model, "-q", port_s, (char *) NULL);
+        _exit(127);
+    }
+
+    bzero(&addr, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port++);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    for (i = 0; i < 100; i++) {
+        if ((st->sd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+            SystemFatal("socket(): Failed");
+        if (connect(st->sd, (struct sockaddr *) &addr, sizeof (addr)) == 0)
+            break;
+        close(st->sd);
+        st->sd = -1;
+        usleep(20000);
+    }
+    if (st->sd < 0) {
+        fprintf(stderr, "> %s did not start, skipping %s\n", mc->model, mc->name);
+        kill(st->pid, SIGKILL);
+        waitpid(st->pid, NULL, 0);
+        free(st);
+        return;
+    }
+    mc->state = st;
+}
+
+/**
+ * rtt_teardown
+ */
+static void rtt_teardown(micro_case *mc) {
+    rtt_state *st = (rtt_state *) mc->state;
+
+    if (st == NULL)
+        return;
+    if (write(st->sd, "quit\n", 5) < 0)
+        perror("write(): quit");
+    close(st->sd);
+    kill(st->pid, SIGINT);
+    waitpid(st->pid, NULL, 0);
+    free(st);
+}
+
+/**
+ * run_rtt
+ *
+ * "request\n" sent and its BUFLEN reply read.
+ */
+static void run_rtt(micro_case *mc, long iters) {
+    rtt_state *st = (rtt_state *) mc->state;
+    char buf[BUFLEN];
+    ssize_t r;
+    int got;
+
+    while (iters-- > 0) {
+        if (write(st->sd, "request\n", 8) != 8)
+            SystemFatal("write(): Failed");
+        for (got = 0; got < BUFLEN; got += r) {
+            if ((r = read(st->sd, buf + got, BUFLEN - got)) <= 0)
+                SystemFatal("read(): Failed");
+        }
+    }
+}
+
+/**
+ * run_case
+ *
+ * Sizes the batch, warms up, times the samples and writes the case's
+ * line of JSON.
+ *
+ * @param mc the case
+ * @param first true for the first case written
+ * @return true if the case ran
+ */
+static bool run_case(micro_case *mc, bool first) {
+    double s[MICRO_MAX_REPS], mean = 0, var = 0, ci;
+    uint64_t start, took;
+    long iters;
+    int i;
+
+    if (filter != NULL && strstr(mc->name, filter) == NULL)
+        return false;
+    if (mc->setup != NULL)
+        mc->setup(mc);
+    if (mc->setup != NULL && mc->state == NULL)
+        return false;
+
+    /* double the batch until it takes the target time */
+    for (iters = 1;; iters *= 2) {
+        start = now_ns();
+        mc->run(mc, iters);
+        took = now_ns() - start;
+        if (took >= (uint64_t) target_ms * 1000000 || iters >= (1L << 40))
+            break;
+    }
+    for (i = 0; i < warmup; i++)
+        mc->run(mc, iters);
+    for (i = 0; i < reps; i++) {
+        start = now_ns();
+        mc->run(mc, iters);
+        s[i] = (double) (now_ns() - start) / iters;
+        mean += s[i];
+    }
+    if (mc->teardown != NULL)
+        mc->teardown(mc);
+
+    mean /= reps;
+    for (i = 0; i < reps; i++)
+        var += (s[i] - mean) * (s[i] - mean);
+    var = reps > 1 ? var / (reps - 1) : 0.0;
+    ci = t95(reps - 1) * sqrt(var / reps);
+    qsort(s, reps, sizeof (double), cmp_double);
+
+    fprintf(out, "%s    {\"name\": \"%s\", \"size\": %ld, \"iters\": %ld, \"reps\": %d, "
+            "\"unit\": \"ns/op\", \"median\": %.3lf, \"mean\": %.3lf, \"stddev\": %.3lf, "
+            "\"ci95\": %.3lf, \"min\": %.3lf, \"max\": %.3lf}", first ? "" : ",\n", mc->name,
+            mc->size, iters, reps, reps % 2 ? s[reps / 2] : (s[reps / 2 - 1] + s[reps / 2]) / 2,
+            mean, sqrt(var), ci, s[0], s[reps - 1]);
+    fflush(out);
+    fprintf(stderr, "> %-24s %8ld %12.1lf ns/op +- %.1lf\n", mc->name, mc->size, mean, ci);
+    return true;
+}
+
+/**
+ * main
+ *
+ * @param argc
+ * @param argv
+ * @return
+ */
+int main(int argc, char **argv) {
+    micro_case cases[] = {
+        {"list_append_remove", 16, list_setup, run_list_append_remove, list_teardown},
+        {"list_append_remove", 256, list_setup, run_list_append_remove, list_teardown},
+        {"list_append_remove", 4096, list_setup, run_list_append_remove, list_teardown},
+        {"list_length", 16, list_setup, run_list_length, list_teardown},
+        {"list_length", 256, list_setup, run_list_length, list_teardown},
+        {"list_length", 4096, list_setup, run_list_length, list_teardown},
+        {"client_lookup", 16, list_setup, run_client_lookup, list_teardown},
+        {"client_lookup", 256, list_setup, run_client_lookup, list_teardown},
+        {"client_lookup", 4096, list_setup, run_client_lookup, list_teardown},
+        {"client_alloc", 0, NULL, run_client_alloc, NULL},
+        {"reply_queue", 0, replies_setup, run_reply_queue, replies_teardown},
+        {"reply_queue", 4096, replies_setup, run_reply_queue, replies_teardown},
+        {"reply_queue", REPLY_MAX_LEN, replies_setup, run_reply_queue, replies_teardown},
+        {"parse_text", 0, parse_setup, run_parse, parse_teardown},
+        {"parse_binary", FRAME_HDR_LEN + 4, parse_setup, run_parse, parse_teardown},
+        {"parse_binary", BUFLEN, parse_setup, run_parse, parse_teardown},
+        {"fdset_rebuild", 16, list_setup, run_fdset_rebuild, list_teardown},
+        {"fdset_rebuild", 256, list_setup, run_fdset_rebuild, list_teardown},
+        {"fdset_rebuild", FD_SETSIZE - 2 * MICRO_FDSET_BASE, list_setup, run_fdset_rebuild,
+            list_teardown},
+        {"rtt_s_svr", 0, rtt_setup, run_rtt, rtt_teardown, NULL, "./s_svr"},
+        {"rtt_e_svr", 0, rtt_setup, run_rtt, rtt_teardown, NULL, "./e_svr"},
+        {"rtt_t_svr", 0, rtt_setup, run_rtt, rtt_teardown, NULL, "./t_svr"},
+    };
+    const char *path = NULL;
+    bool first = true;
+    size_t i;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:w:t:f:p:o:")) != -1) {
+        switch (opt) {
+            case 'r':
+                reps = atoi(optarg); // timed batches per case
+                break;
+            case 'w':
+                warmup = atoi(optarg); // untimed batches first
+                break;
+            case 't':
+                target_ms = atoi(optarg); // length of a batch
+                break;
+            case 'f':
+                filter = optarg; // cases whose names contain it
+                break;
+            case 'p':
+                port = atoi(optarg); // first port of the round trip servers
+                break;
+            case 'o':
+                path = optarg; // JSON file instead of stdout
+                break;
+            default:
+                fprintf(stderr, USAGE, argv[0]);
+                exit(1);
+        }
+    }
+    if (optind != argc || reps < 2 || reps > MICRO_MAX_REPS || warmup < 0 || target_ms < 1) {
+        fprintf(stderr, USAGE, argv[0]);
+        exit(1);
+    }
+    out = stdout;
+    if (path != NULL && (out = fopen(path, "w")) == NULL)
+        SystemFatal("fopen(): Failed");
+    signal(SIGPIPE, SIG_IGN);
+
+    fprintf(out, "{\"bench\": \"micro_bench\", \"time\": %ld, \"reps\": %d, \"warmup\": %d, "
+            "\"target_ms\": %d, \"scan\": \"%s\", \"results\": [\n", (long) time(NULL), reps,
+            warmup, target_ms, proto_scan_use(-1));
+    for (i = 0; i < sizeof (cases) / sizeof (cases[0]); i++) {
+        if (run_case(&cases[i], first))
+            first = false;
+    }
+    fprintf(out, "\n]}\n");
+    if (out != stdout)
+        fclose(out);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * SystemFatal
+ *
+ * Displays a perror message and exits the program.
+ *
+ * @param message takes in a string message
+ */
+void SystemFatal(const char* message) {
+    perror(message);
+    exit(EXIT_FAILURE);
+}
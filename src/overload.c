@@ -0,0 +1,247 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		overload.c - Admission control on event loop lag
+--
+--	FUNCTIONS:			clock_gettime, getsockopt, setsockopt
+--
+--	DATE:				October 19, 2026
+--
+--	NOTES:
+--	The servers measure the lag of their loops, the time from a socket
+--	being reported ready to the server getting to it: from epoll_wait or
+--	select returning to the event being handled, and in t_svr from accept
+--	to the client's thread starting. A smoothed lag above the limit puts the
+--	server in shedding mode until it drops below half the limit. While
+--	shedding, the reject policy resets new connections as soon as they are
+--	accepted, letting one through every OVERLOAD_PROBE_NS to keep measuring,
+--	and the busy policy answers requests with "busy\n" instead of their
+--	reply, which the clients tell apart from a reply by its first byte.
+--	Either way the clients already being served keep their latency. The
+--	length of the accept queue is sampled on every listen wakeup. t_svr
+--	only samples when a thread starts, so while it sheds its requests let
+--	the smoothed lag decay once no sample came for OVERLOAD_IDLE_NS;
+--	otherwise it would answer "busy" until the next connection.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+#include <netinet/tcp.h>
+
+#define OVERLOAD_PROBE_NS 10000000ULL // connections let through while rejecting
+#define OVERLOAD_SMOOTH 3 // the smoothed lag moves 1/8 of the way per sample
+#define OVERLOAD_IDLE_NS 100000000ULL // without samples the lag decays this often
+
+static const char *overload_policies[] = {"reject", "busy"};
+
+/**
+ * overload_now
+ *
+ * @return the monotonic clock in nanoseconds
+ */
+uint64_t overload_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * overload_new
+ *
+ * @param spec the lag limit in microseconds and the policy, "500,busy";
+ * the policy defaults to reject
+ * @return the controller, NULL if the spec is malformed
+ */
+overload* overload_new(const char *spec) {
+    overload *o;
+    char *end;
+    long us;
+    int i;
+
+    us = strtol(spec, &end, 10);
+    if (end == spec || us <= 0)
+        return NULL;
+    if ((o = calloc(1, sizeof (overload))) == NULL)
+        return NULL;
+    o->limit_ns = (uint64_t) us * 1000;
+    o->policy = OVERLOAD_REJECT;
+
+    if (*end == ',') {
+        for (i = OVERLOAD_REJECT; i <= OVERLOAD_BUSY; i++) {
+            if (strcmp(end + 1, overload_policies[i]) == 0)
+                break;
+        }
+        if (i > OVERLOAD_BUSY) {
+            free(o);
+            return NULL;
+        }
+        o->policy = i;
+    } else if (*end != '\0') {
+        free(o);
+        return NULL;
+    }
+    hist_init(&o->lag);
+    return o;
+}
+
+/**
+ * overload_clone
+ *
+ * @param o a controller
+ * @return a controller with the same limit and policy for another loop
+ */
+overload* overload_clone(const overload *o) {
+    overload *c = calloc(1, sizeof (overload));
+
+    if (c == NULL)
+        SystemFatal("Overload Malloc() Failed\n");
+    c->limit_ns = o->limit_ns;
+    c->policy = o->policy;
+    hist_init(&c->lag);
+    return c;
+}
+
+/**
+ * overload_lag
+ *
+ * Records the lag of one event and moves in or out of shedding mode.
+ *
+ * @param o the loop's controller
+ * @param lag_ns the time from readiness to handling
+ */
+void overload_lag(overload *o, uint64_t lag_ns) {
+    hist_add(&o->lag, lag_ns);
+    if (lag_ns > o->lag_ns)
+        o->lag_ns += (lag_ns - o->lag_ns) >> OVERLOAD_SMOOTH;
+    else
+        o->lag_ns -= (o->lag_ns - lag_ns) >> OVERLOAD_SMOOTH;
+
+    if (!o->shedding && o->lag_ns > o->limit_ns) {
+        o->shedding = true;
+        o->n_episodes++;
+    } else if (o->shedding && o->lag_ns < o->limit_ns / 2) {
+        o->shedding = false;
+    }
+}
+
+/**
+ * overload_queue
+ *
+ * Samples the accept queue of a listen socket, which TCP_INFO reports as
+ * its unacknowledged segments.
+ *
+ * @param o the loop's controller
+ * @param listen_sd the listen socket
+ */
+void overload_queue(overload *o, int listen_sd) {
+    struct tcp_info ti;
+    socklen_t len = sizeof (ti);
+
+    if (getsockopt(listen_sd, IPPROTO_TCP, TCP_INFO, &ti, &len) < 0)
+        return;
+    o->n_queue_samples++;
+    o->queue_sum += ti.tcpi_unacked;
+    if ((int) ti.tcpi_unacked > o->max_queue)
+        o->max_queue = ti.tcpi_unacked;
+}
+
+/**
+ * overload_admit
+ *
+ * Decides on a connection that was just accepted. A rejected connection is
+ * closed with a reset, so it costs the server no FIN handshake and the
+ * client learns at once.
+ *
+ * @param o the controller
+ * @param fd the connection
+ * @return true to serve the connection, false if it was rejected and closed
+ */
+bool overload_admit(overload *o, int fd) {
+    struct linger lg = {1, 0};
+    uint64_t now;
+
+    if (!o->shedding || o->policy != OVERLOAD_REJECT)
+        return true;
+
+    now = overload_now();
+    if (now - o->probe_ns >= OVERLOAD_PROBE_NS) {
+        o->probe_ns = now;
+        return true;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof (lg));
+    close(fd);
+    __sync_fetch_and_add(&o->n_rejected, 1);
+    return false;
+}
+
+/**
+ * overload_busy
+ *
+ * @param o the controller
+ * @return true if a request is to be answered "busy", and counts it
+ */
+bool overload_busy(overload *o) {
+    if (!o->shedding || o->policy != OVERLOAD_BUSY)
+        return false;
+    __sync_fetch_and_add(&o->n_busy, 1);
+    return true;
+}
+
+/**
+ * overload_idle
+ *
+ * Moves the smoothed lag of a shedding controller 1/8 of the way to 0,
+ * as a sample of no lag would, when no sample was taken for
+ * OVERLOAD_IDLE_NS, so shedding ends once the events that measure the lag
+ * stop coming. The caller serialises it with overload_lag.
+ *
+ * @param o the controller
+ * @param now the time, from overload_now
+ */
+void overload_idle(overload *o, uint64_t now) {
+    if (!o->shedding)
+        return;
+    if (o->lag.count != o->idle_mark) {
+        o->idle_mark = o->lag.count;
+        o->idle_ns = now;
+        return;
+    }
+    if (now - o->idle_ns < OVERLOAD_IDLE_NS)
+        return;
+    o->idle_ns = now;
+    o->lag_ns -= o->lag_ns >> OVERLOAD_SMOOTH;
+    if (o->lag_ns < o->limit_ns / 2)
+        o->shedding = false;
+}
+
+/**
+ * overload_merge
+ *
+ * Adds the counters of a reactor's controller to the server's.
+ *
+ * @param o the server's controller
+ * @param w a reactor's controller
+ */
+void overload_merge(overload *o, const overload *w) {
+    hist_merge(&o->lag, &w->lag);
+    o->n_episodes += w->n_episodes;
+    o->n_rejected += w->n_rejected;
+    o->n_busy += w->n_busy;
+    o->n_queue_samples += w->n_queue_samples;
+    o->queue_sum += w->queue_sum;
+    if (w->max_queue > o->max_queue)
+        o->max_queue = w->max_queue;
+}
+
+/**
+ * overload_print
+ *
+ * @param o the controller
+ */
+void overload_print(overload *o) {
+    fprintf(stdout, "[ Overload Policy: %s above %lu us lag\n",
+            overload_policies[o->policy], (unsigned long) (o->limit_ns / 1000));
+    fprintf(stdout, "[ Shedding Episodes: %lu\n", o->n_episodes);
+    fprintf(stdout, "[ Rejected Connections: %lu\n", o->n_rejected);
+    fprintf(stdout, "[ Busy Replies: %lu\n", o->n_busy);
+    fprintf(stdout, "[ Accept Queue: %.2lf mean, %d max\n", o->n_queue_samples ?
+            (double) o->queue_sum / o->n_queue_samples : 0.0, o->max_queue);
+    hist_print(&o->lag, "Loop Lag", "ns");
+}
@@ -0,0 +1,284 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		prefork.c - Prefork worker processes for e_svr
+--
+--	FUNCTIONS:			fork, wait4, mmap
+--
+--	DATE:				October 19, 2026
+--
+--	NOTES:
+--	The master process forks a number of workers that each run the epoll
+--	client_manager loop. They share the master's listen socket, by default
+--	adding it to their epoll sets with EPOLLEXCLUSIVE so a connection wakes
+--	one worker instead of all of them, or bind a SO_REUSEPORT socket each,
+--	see the accept modes in e_svr. Each worker publishes its counters into
+--	its slot of a shared anonymous mapping after every wakeup, and the
+--	master adds the slots up when it prints the statistics. A worker that
+--	dies, through SystemFatal or a signal, is replaced by a new one in the
+--	same slot; the counters of the old one are kept. The workers' CPU time
+--	is read from /proc while they run and from wait4 once they exit.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+/* counters of the workers that ran in a slot before the current one */
+static prefork_slot *retired;
+
+/**
+ * prefork_cpu_us
+ *
+ * @param pid a running worker
+ * @return the worker's user and system CPU time in microseconds, 0 if it
+ * cannot be read
+ */
+static unsigned long prefork_cpu_us(pid_t pid) {
+    char path[64], buf[512], *p;
+    unsigned long utime, stime;
+    FILE *fp;
+
+    snprintf(path, sizeof (path), "/proc/%d/stat", (int) pid);
+    if ((fp = fopen(path, "r")) == NULL)
+        return 0;
+    p = fgets(buf, sizeof (buf), fp);
+    fclose(fp);
+
+    /* utime and stime are the 12th and 13th fields after the command name */
+    if (p == NULL || (p = strrchr(buf, ')')) == NULL ||
+            sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+            &utime, &stime) != 2)
+        return 0;
+    return (utime + stime) * (1000000 / sysconf(_SC_CLK_TCK));
+}
+
+/**
+ * prefork_spawn
+ *
+ * Forks the worker of a slot. The worker runs the client manager and never
+ * returns.
+ *
+ * @param s the master's server structure
+ * @param i the slot
+ */
+static void prefork_spawn(server *s, int i) {
+    pid_t pid;
+
+    if ((pid = fork()) < 0) {
+        perror("fork(): Worker Failed");
+        return;
+    }
+    if (pid > 0) {
+        s->slots[i].pid = pid;
+        return;
+    }
+
+    /* the master alone handles CTRL-c and a crash only ends this worker */
+    signal(SIGINT, SIG_IGN);
+    signal(SIGSEGV, SIG_DFL);
+
+    s->slot = &s->slots[i];
+    s->slot->pid = getpid();
+    s->cpu = affinity_cpu(&s->cpus, i);
+    s->n_procs = 0;
+    client_manager(s);
+    _exit(EXIT_SUCCESS);
+}
+
+/**
+ * prefork_run
+ *
+ * Forks the workers and replaces those that exit, until the master is
+ * stopped.
+ *
+ * @param s the master's server structure
+ * @param n the number of workers
+ */
+void prefork_run(server *s, int n) {
+    struct rusage ru;
+    prefork_slot *slot;
+    time_t born[n];
+    int i, status;
+    pid_t pid;
+
+    s->n_procs = n;
+    s->slots = mmap(NULL, n * sizeof (prefork_slot), PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (s->slots == MAP_FAILED)
+        SystemFatal("mmap(): Statistics Segment Failed\n");
+    retired = calloc(n, sizeof (prefork_slot));
+
+    /* the workers inherit one listen socket, or bind their own */
+    if (s->accept_mode != ACCEPT_REUSEPORT)
+        server_init(s);
+
+    for (i = 0; i < n; i++) {
+        born[i] = time(NULL);
+        prefork_spawn(s, i);
+    }
+
+    for (;;) {
+        if ((pid = wait4(-1, &status, 0, &ru)) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        for (i = 0; i < n && s->slots[i].pid != pid; i++)
+            ;
+        if (i == n)
+            continue;
+
+        slot = &s->slots[i];
+        if (WIFSIGNALED(status))
+            fprintf(stderr, "> Worker %d (pid %d) killed by %s, restarting\n",
+                    i, (int) pid, strsignal(WTERMSIG(status)));
+        else
+            fprintf(stderr, "> Worker %d (pid %d) exited with %d, restarting\n",
+                    i, (int) pid, WEXITSTATUS(status));
+
+        /* keep what the dead worker did */
+        retired[i].n_connected += slot->n_connected;
+        retired[i].n_requests += slot->n_requests;
+        retired[i].n_bytes += slot->n_bytes;
+        retired[i].n_wakeups += slot->n_wakeups;
+        retired[i].n_events += slot->n_events;
+        retired[i].n_listen_wakeups += slot->n_listen_wakeups;
+        retired[i].n_accept_misses += slot->n_accept_misses;
+        retired[i].n_rejected += slot->n_rejected;
+        retired[i].n_busy += slot->n_busy;
+        retired[i].n_deferred += slot->n_deferred;
+        retired[i].n_write_calls += slot->n_write_calls;
+        retired[i].n_segs_out += slot->n_segs_out;
+        udp_merge(&retired[i].udp, &slot->udp);
+        retired[i].n_task_wakeups += ru.ru_nvcsw;
+        retired[i].cpu_us += ru.ru_utime.tv_sec * 1000000 + ru.ru_utime.tv_usec +
+                ru.ru_stime.tv_sec * 1000000 + ru.ru_stime.tv_usec;
+        slot->n_connected = slot->n_requests = slot->n_bytes = 0;
+        slot->n_wakeups = slot->n_events = 0;
+        slot->n_listen_wakeups = slot->n_accept_misses = 0;
+        slot->n_rejected = slot->n_busy = slot->n_deferred = 0;
+        slot->n_write_calls = slot->n_segs_out = 0;
+        slot->n_active = 0;
+        bzero(&slot->udp, sizeof (udp_stats));
+        slot->restarts++;
+
+        /* a worker that fails straight away is not restarted in a tight loop */
+        if (time(NULL) - born[i] < 1)
+            sleep(1);
+        born[i] = time(NULL);
+        prefork_spawn(s, i);
+    }
+}
+
+/**
+ * prefork_publish
+ *
+ * Copies a worker's counters into its shared slot.
+ *
+ * @param s the worker's server structure
+ */
+void prefork_publish(server *s) {
+    prefork_slot *slot = s->slot;
+
+    slot->n_active = s->n_clients;
+    slot->n_connected = s->n_max_connected;
+    slot->n_requests = s->n_requests;
+    slot->n_bytes = s->n_max_bytes_received;
+    slot->n_wakeups = s->n_wakeups;
+    slot->n_events = s->n_events;
+    slot->n_listen_wakeups = s->n_listen_wakeups;
+    slot->n_accept_misses = s->n_accept_misses;
+    slot->n_deferred = s->n_deferred;
+    slot->n_write_calls = s->n_write_calls;
+    slot->n_segs_out = s->n_segs_out;
+    if (s->load != NULL) {
+        slot->n_rejected = s->load->n_rejected;
+        slot->n_busy = s->load->n_busy;
+    }
+    if (s->udp_srv != NULL)
+        slot->udp = s->udp_srv->stats;
+}
+
+/**
+ * prefork_stop
+ *
+ * Terminates the workers.
+ *
+ * @param s the master's server structure
+ */
+void prefork_stop(server *s) {
+    int i;
+
+    for (i = 0; i < s->n_procs; i++) {
+        if (s->slots[i].pid > 0)
+            kill(s->slots[i].pid, SIGTERM);
+    }
+}
+
+/**
+ * prefork_print
+ *
+ * Prints every worker's counters and adds them up into the master's, which
+ * print_server_data then reports as the totals.
+ *
+ * @param s the master's server structure
+ */
+void prefork_print(server *s) {
+    prefork_slot *slot, w;
+    unsigned long cpu_us = 0, task_wakeups = 0;
+    int i;
+
+    s->n_max_connected = s->n_max_bytes_received = s->n_clients = 0;
+    s->n_requests = s->n_wakeups = s->n_events = 0;
+    s->n_listen_wakeups = s->n_accept_misses = s->n_deferred = 0;
+    s->n_write_calls = s->n_segs_out = 0;
+    if (s->load != NULL)
+        s->load->n_rejected = s->load->n_busy = 0;
+    bzero(&s->udp_total, sizeof (udp_stats));
+    for (i = 0; i < s->n_procs; i++) {
+        slot = &s->slots[i];
+        w.n_connected = slot->n_connected + retired[i].n_connected;
+        w.n_requests = slot->n_requests + retired[i].n_requests;
+        w.n_bytes = slot->n_bytes + retired[i].n_bytes;
+        w.n_wakeups = slot->n_wakeups + retired[i].n_wakeups;
+        w.n_events = slot->n_events + retired[i].n_events;
+        w.n_listen_wakeups = slot->n_listen_wakeups + retired[i].n_listen_wakeups;
+        w.n_accept_misses = slot->n_accept_misses + retired[i].n_accept_misses;
+        w.n_rejected = slot->n_rejected + retired[i].n_rejected;
+        w.n_busy = slot->n_busy + retired[i].n_busy;
+        w.n_deferred = slot->n_deferred + retired[i].n_deferred;
+        w.cpu_us = prefork_cpu_us(slot->pid) + retired[i].cpu_us;
+        w.n_task_wakeups = cpu_task_wakeups(slot->pid, slot->pid) + retired[i].n_task_wakeups;
+
+        fprintf(stdout, "[ Worker %3d (pid %d, %d restarts): %lu clients, %lu requests, "
+                "%.2lf events/wakeup, %lu listen wakeups, %lu process wakeups, %.1lf ms CPU\n",
+                i, (int) slot->pid, slot->restarts, w.n_connected, w.n_requests,
+                w.n_wakeups ? (double) w.n_events / w.n_wakeups : 0.0, w.n_listen_wakeups,
+                w.n_task_wakeups, w.cpu_us / 1000.0);
+
+        s->n_max_connected += w.n_connected;
+        s->n_clients += slot->n_active;
+        s->n_max_bytes_received += w.n_bytes;
+        s->n_requests += w.n_requests;
+        s->n_wakeups += w.n_wakeups;
+        s->n_events += w.n_events;
+        s->n_listen_wakeups += w.n_listen_wakeups;
+        s->n_accept_misses += w.n_accept_misses;
+        s->n_deferred += w.n_deferred;
+        s->n_write_calls += slot->n_write_calls + retired[i].n_write_calls;
+        s->n_segs_out += slot->n_segs_out + retired[i].n_segs_out;
+        if (s->load != NULL) {
+            s->load->n_rejected += w.n_rejected;
+            s->load->n_busy += w.n_busy;
+        }
+        udp_merge(&s->udp_total, &slot->udp);
+        udp_merge(&s->udp_total, &retired[i].udp);
+        cpu_us += w.cpu_us;
+        task_wakeups += w.n_task_wakeups;
+    }
+    if (s->n_max_connected > 0)
+        fprintf(stdout, "[ Process Wakeups/Accept: %.2lf\n",
+                (double) task_wakeups / s->n_max_connected);
+    if (s->n_requests > 0)
+        fprintf(stdout, "[ Worker CPU Time/Request: %.2lf us\n", (double) cpu_us / s->n_requests);
+}
@@ -0,0 +1,207 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		probe_clnt.c - Busy-polling latency probe client
+--
+--	PROGRAM:			probe_clnt
+--						./probe_clnt [-a cpu] [-i interval_us] [-n probes] [-w warmup]
+--									 [-s size] HOST PORT
+--
+--	FUNCTIONS:			Berkeley Socket API, clock_gettime
+--
+--	DATE:				October 19, 2026
+--
+--	PROGRAMMERS:		Jivanjot Brar & Shan Bains
+--
+--	NOTES:
+--	Sends one small request at a fixed interval on one connection and times
+--	the round trip with CLOCK_MONOTONIC_RAW, in nanoseconds. The thread is
+--	pinned to a CPU and spins on a non-blocking socket both between probes
+--	and while waiting for the reply, so no wakeup or scheduler delay of the
+--	client is added to the measurement. The time spent in send and the cost
+--	of reading the clock are reported next to the round trip, bounding the
+--	client's own share of it. Run it next to a load generator (tcp_clnt) to
+--	see the server's queueing delay under load. Probes a server shedding
+--	load answers "busy" are counted and left out of the round trips. HOST
+--	may name a Unix socket instead, see unix_sock.c.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+#include <netinet/tcp.h>
+
+#define USAGE "Usage: %s [-a cpu] [-i interval_us] [-n probes] [-w warmup] [-s size] HOST PORT\n"
+
+/**
+ * now_ns
+ *
+ * @return the raw monotonic clock in nanoseconds
+ */
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * clock_cost
+ *
+ * @return the average cost of reading the clock in nanoseconds
+ */
+static double clock_cost(void) {
+    uint64_t start, end = 0;
+    int i;
+
+    start = now_ns();
+    for (i = 0; i < 100000; i++)
+        end = now_ns();
+    return (double) (end - start) / 100000;
+}
+
+/**
+ * main
+ *
+ * @param argc
+ * @param argv
+ * @return
+ */
+int main(int argc, char **argv) {
+    int opt, sd, cpu = -1, probes = 10000, warmup = 100, size = 0, interval_us = 1000;
+    int i, req_len, expect, want, got, on = 1;
+    unsigned long late = 0, busy = 0;
+    char req[32], *rbuf;
+    struct sockaddr_in server_addr;
+    struct hostent *hp;
+    struct timespec res;
+    uint64_t next, sent, start, end;
+    ssize_t n;
+    hist rtt, send_ns;
+
+    while ((opt = getopt(argc, argv, "a:i:n:w:s:")) != -1) {
+        switch (opt) {
+            case 'a':
+                cpu = atoi(optarg); // CPU to pin the probe thread to
+                break;
+            case 'i':
+                interval_us = atoi(optarg); // time between probes
+                break;
+            case 'n':
+                probes = atoi(optarg); // probes measured
+                break;
+            case 'w':
+                warmup = atoi(optarg); // probes sent before measuring
+                break;
+            case 's':
+                size = atoi(optarg); // reply size, 0 for the BUFLEN reply
+                break;
+            default:
+                fprintf(stderr, USAGE, argv[0]);
+                exit(1);
+        }
+    }
+    if (argc - optind != 2 || probes < 1 || warmup < 0 || interval_us < 0 ||
+            size < 0 || size > REPLY_MAX_LEN) {
+        fprintf(stderr, USAGE, argv[0]);
+        exit(1);
+    }
+
+    if (cpu >= 0 && affinity_pin(cpu) < 0)
+        fprintf(stderr, "probe: cannot pin to CPU %d, running unpinned\n", cpu);
+
+    if (size > 0) {
+        req_len = sprintf(req, "request %d\n", size);
+        expect = size;
+    } else {
+        req_len = sprintf(req, "request\n");
+        expect = BUFLEN;
+    }
+    if ((rbuf = malloc(expect > OVERLOAD_BUSY_LEN ? expect : OVERLOAD_BUSY_LEN)) == NULL)
+        SystemFatal("malloc(): Failed");
+
+    if (unix_name(argv[optind])) {
+        /* a Unix socket name in place of the host, the port is ignored */
+        if ((sd = unix_connect(argv[optind])) == -1)
+            SystemFatal("connect(): Failed");
+    } else {
+        bzero((char *) &server_addr, sizeof (struct sockaddr_in));
+        server_addr.sin_family = AF_INET;
+        server_addr.sin_port = htons(atoi(argv[optind + 1]));
+        if ((hp = gethostbyname(argv[optind])) == NULL) {
+            fprintf(stderr, "Unknown server address\n");
+            exit(1);
+        }
+        bcopy(hp->h_addr, (char *) &server_addr.sin_addr, hp->h_length);
+
+        if ((sd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+            SystemFatal("socket(): Failed");
+        if (connect(sd, (struct sockaddr *) &server_addr, sizeof (server_addr)) == -1)
+            SystemFatal("connect(): Failed");
+    }
+
+    /* probes are small, send each at once and never block on the socket */
+    setsockopt(sd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof (on));
+    if (fcntl(sd, F_SETFL, O_NONBLOCK | fcntl(sd, F_GETFL, 0)) == -1)
+        SystemFatal("fcntl(): Non-Block Failed");
+
+    hist_init(&rtt);
+    hist_init(&send_ns);
+    next = now_ns() + (uint64_t) interval_us * 1000;
+    for (i = 0; i < warmup + probes; i++) {
+        /* spin to the probe's slot; a reply that overran it starts a new grid
+         * instead of sending a burst of catch-up probes */
+        if ((start = now_ns()) > next) {
+            late++;
+            next = start;
+        }
+        while ((start = now_ns()) < next)
+            ;
+        next += (uint64_t) interval_us * 1000;
+
+        while ((n = send(sd, req, req_len, MSG_NOSIGNAL)) < 0 && errno == EAGAIN)
+            ;
+        sent = now_ns();
+        if (n != req_len)
+            SystemFatal("send(): Failed");
+
+        for (got = 0, want = expect; got < want; got += n) {
+            while ((n = recv(sd, rbuf + got, want - got, 0)) < 0 && errno == EAGAIN)
+                ;
+            if (n <= 0) {
+                fprintf(stderr, "probe: server closed the connection\n");
+                exit(1);
+            }
+            /* a shed request is answered "busy\n", replies start with a digit */
+            if (got == 0 && rbuf[0] == 'b')
+                want = OVERLOAD_BUSY_LEN;
+        }
+        end = now_ns();
+
+        if (want != expect) {
+            busy += i >= warmup;
+        } else if (i >= warmup) {
+            hist_add(&rtt, end - start);
+            hist_add(&send_ns, sent - start);
+        }
+    }
+    close(sd);
+
+    clock_getres(CLOCK_MONOTONIC_RAW, &res);
+    fprintf(stdout, "[ Probes: %d every %d us, %d byte replies, CPU %d, %lu late, %lu busy\n",
+            probes, interval_us, expect, cpu, late, busy);
+    fprintf(stdout, "[ Clock: %ld ns resolution, %.1lf ns per read\n",
+            res.tv_nsec, clock_cost());
+    hist_print(&send_ns, "Send", "ns");
+    hist_print(&rtt, "Round Trip", "ns");
+
+    free(rbuf);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * SystemFatal
+ *
+ * Displays a perror message and exits the program.
+ *
+ * @param message takes in a string message
+ */
+void SystemFatal(const char* message) {
+    perror(message);
+    exit(EXIT_FAILURE);
+}
@@ -0,0 +1,709 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		proto.c - Request framing shared by the servers
+--
+--	FUNCTIONS:			Berkeley Socket API
+--
+--	DATE:				October 19, 2026
+--
+--	NOTES:
+--	Requests are newline terminated commands ("request [N]\n", "quit\n"). The
+--	original clients pad every command with NUL bytes up to BUFLEN, so NUL
+--	bytes between commands are skipped. A client may pipeline any number of
+--	commands; they are reassembled from the stream in the client's receive
+--	buffer and the replies it is owed are queued and written as the socket
+--	allows, all that are queued in one call.
+--
+--	"binary 1\n" switches a connection to the binary framing, once the
+--	server has answered "binary 1\n": length-prefixed frames with an opcode
+--	and a request id, see common.h, which carry a payload and need no scan.
+--	Every request frame gets one reply frame with its id.
+--
+--	The padding and the newlines of the text framing are found with SSE2
+--	or, where the CPU has it, AVX2 compares of 16 or 32 bytes at a time, so
+--	pipelined input is split at close to memory bandwidth.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+#include <limits.h>
+#include <linux/tcp.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/* iovecs of one sendmsg, the whole reply ring */
+#if REPLY_QUEUE_LEN < IOV_MAX
+#define FLUSH_IOV REPLY_QUEUE_LEN
+#else
+#define FLUSH_IOV IOV_MAX
+#endif
+
+static const char *scan_names[] = {"scalar", "sse2", "avx2"};
+
+/* the kernels: the offset of the first byte that is not NUL, len if there
+ * is none, and the offset of the first newline, -1 if there is none */
+static int (*scan_skip)(const char *, int);
+static int (*scan_nl)(const char *, int);
+
+/**
+ * skip_scalar
+ */
+static int skip_scalar(const char *p, int len) {
+    int i = 0;
+
+    while (i < len && p[i] == '\0')
+        i++;
+    return i;
+}
+
+/**
+ * nl_scalar
+ */
+static int nl_scalar(const char *p, int len) {
+    const char *nl = memchr(p, '\n', len);
+    return nl != NULL ? nl - p : -1;
+}
+
+#if defined(__x86_64__)
+/**
+ * skip_sse2
+ */
+static int skip_sse2(const char *p, int len) {
+    __m128i zero = _mm_setzero_si128();
+    unsigned mask;
+    int i;
+
+    for (i = 0; i + 16 <= len; i += 16) {
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (p + i)), zero));
+        if (mask != 0xffff)
+            return i + __builtin_ctz(~mask);
+    }
+    return i + skip_scalar(p + i, len - i);
+}
+
+/**
+ * nl_sse2
+ */
+static int nl_sse2(const char *p, int len) {
+    __m128i nl = _mm_set1_epi8('\n');
+    unsigned mask;
+    int i, j;
+
+    for (i = 0; i + 16 <= len; i += 16) {
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (p + i)), nl));
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    j = nl_scalar(p + i, len - i);
+    return j < 0 ? -1 : i + j;
+}
+
+/**
+ * skip_avx2
+ */
+__attribute__((target("avx2")))
+static int skip_avx2(const char *p, int len) {
+    __m256i zero = _mm256_setzero_si256();
+    unsigned mask;
+    int i;
+
+    for (i = 0; i + 32 <= len; i += 32) {
+        mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (p + i)), zero));
+        if (mask != 0xffffffff)
+            return i + __builtin_ctz(~mask);
+    }
+    return i + skip_sse2(p + i, len - i);
+}
+
+/**
+ * nl_avx2
+ */
+__attribute__((target("avx2")))
+static int nl_avx2(const char *p, int len) {
+    __m256i nl = _mm256_set1_epi8('\n');
+    unsigned mask;
+    int i, j;
+
+    for (i = 0; i + 32 <= len; i += 32) {
+        mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (p + i)), nl));
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    j = nl_sse2(p + i, len - i);
+    return j < 0 ? -1 : i + j;
+}
+#endif
+
+/**
+ * proto_scan_use
+ *
+ * Selects the newline scan kernel.
+ *
+ * @param kernel SCAN_SCALAR, SCAN_SSE2 or SCAN_AVX2, -1 for the best the CPU
+ * has
+ * @return the kernel's name, NULL if the CPU does not have it
+ */
+const char* proto_scan_use(int kernel) {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (kernel < 0)
+        kernel = __builtin_cpu_supports("avx2") ? SCAN_AVX2 : SCAN_SSE2;
+    switch (kernel) {
+        case SCAN_AVX2:
+            if (!__builtin_cpu_supports("avx2"))
+                return NULL;
+            scan_skip = skip_avx2;
+            scan_nl = nl_avx2;
+            break;
+        case SCAN_SSE2:
+            scan_skip = skip_sse2;
+            scan_nl = nl_sse2;
+            break;
+        default:
+            kernel = SCAN_SCALAR;
+            scan_skip = skip_scalar;
+            scan_nl = nl_scalar;
+    }
+#else
+    if (kernel > SCAN_SCALAR)
+        return NULL;
+    kernel = SCAN_SCALAR;
+    scan_skip = skip_scalar;
+    scan_nl = nl_scalar;
+#endif
+    return scan_names[kernel];
+}
+
+/**
+ * proto_scan_init
+ *
+ * Selects the best kernel before main runs.
+ */
+__attribute__((constructor))
+static void proto_scan_init(void) {
+    proto_scan_use(-1);
+}
+
+/**
+ * proto_next_cmd
+ *
+ * Finds the next complete command in a receive buffer.
+ *
+ * @param buf the buffered stream data
+ * @param len number of buffered bytes
+ * @param cmd receives the start of the command
+ * @param cmd_len receives the command length without the newline
+ * @return the number of bytes consumed, 0 if no complete command is buffered
+ */
+int proto_next_cmd(char *buf, int len, char **cmd, int *cmd_len) {
+    int skip, nl;
+
+    /* skip the NUL padding of fixed size requests */
+    skip = scan_skip(buf, len);
+
+    if ((nl = scan_nl(buf + skip, len - skip)) < 0) {
+        *cmd = NULL;
+        return skip;
+    }
+
+    *cmd = buf + skip;
+    *cmd_len = nl;
+    return skip + nl + 1;
+}
+
+/**
+ * proto_parse_cmd
+ *
+ * Identifies a command found by proto_next_cmd. "request" may carry the
+ * number of reply bytes wanted, "request 65536". "get NAME" names a file,
+ * or a key of the cache as "set KEY VALUE" and "del KEY" do, see kv.c.
+ * "subscribe" and "publish MESSAGE" are the broadcast, see pubsub.c.
+ *
+ * @param cmd the command text
+ * @param cmd_len the command length without the newline
+ * @param arg receives the numeric argument, 0 if there is none, or the
+ *            offset of the file name, key or message
+ * @return the command type
+ */
+int proto_parse_cmd(const char *cmd, int cmd_len, long *arg) {
+    int i;
+
+    *arg = 0;
+    if (cmd_len >= 7 && memcmp(cmd, "request", 7) == 0) {
+        if (cmd_len == 7)
+            return CMD_REQUEST;
+        if (cmd[7] != ' ' || cmd_len == 8)
+            return CMD_UNKNOWN;
+        for (i = 8; i < cmd_len; i++) {
+            if (cmd[i] < '0' || cmd[i] > '9' || *arg > REPLY_MAX_LEN)
+                return CMD_UNKNOWN;
+            *arg = *arg * 10 + (cmd[i] - '0');
+        }
+        return (*arg > 0 && *arg <= REPLY_MAX_LEN) ? CMD_REQUEST : CMD_UNKNOWN;
+    }
+    if (cmd_len == 4 && memcmp(cmd, "quit", 4) == 0)
+        return CMD_QUIT;
+    if (cmd_len > 7 && memcmp(cmd, "binary ", 7) == 0) {
+        for (i = 7; i < cmd_len && *arg < 256; i++) {
+            if (cmd[i] < '0' || cmd[i] > '9')
+                return CMD_UNKNOWN;
+            *arg = *arg * 10 + (cmd[i] - '0');
+        }
+        return CMD_BINARY;
+    }
+    if (cmd_len > 4 && memcmp(cmd, "get ", 4) == 0) {
+        *arg = 4;
+        return CMD_GET;
+    }
+    if (cmd_len > 4 && memcmp(cmd, "set ", 4) == 0) {
+        *arg = 4;
+        return CMD_SET;
+    }
+    if (cmd_len > 4 && memcmp(cmd, "del ", 4) == 0) {
+        *arg = 4;
+        return CMD_DEL;
+    }
+    if (cmd_len == 9 && memcmp(cmd, "subscribe", 9) == 0)
+        return CMD_SUBSCRIBE;
+    if (cmd_len > 8 && memcmp(cmd, "publish ", 8) == 0) {
+        *arg = 8;
+        return CMD_PUBLISH;
+    }
+    return CMD_UNKNOWN;
+}
+
+/**
+ * proto_next_frame
+ *
+ * Finds the next complete frame of the binary framing in a receive buffer.
+ *
+ * @param buf the buffered stream data
+ * @param len number of buffered bytes
+ * @param r receives the request, CMD_NONE if no complete frame is
+ *          buffered and CMD_INVALID for a frame of another version or one
+ *          too long for the receive buffer
+ * @return the number of bytes consumed
+ */
+int proto_next_frame(char *buf, int len, proto_req *r) {
+    uint32_t plen, v;
+
+    r->arg = 0;
+    r->id = 0;
+    if (len < FRAME_HDR_LEN) {
+        r->type = CMD_NONE;
+        return 0;
+    }
+    memcpy(&plen, buf + 4, 4);
+    plen = ntohl(plen);
+    if ((unsigned char) buf[0] != PROTO_BIN_VERSION || plen > FRAME_MAX_PAYLOAD) {
+        r->type = CMD_INVALID;
+        return len;
+    }
+    if (len < (int) (FRAME_HDR_LEN + plen)) {
+        r->type = CMD_NONE;
+        return 0;
+    }
+    memcpy(&r->id, buf + 8, 4);
+    r->id = ntohl(r->id);
+    r->cmd = buf + FRAME_HDR_LEN;
+    r->cmd_len = plen;
+
+    switch ((unsigned char) buf[1]) {
+        case OP_REQUEST:
+            r->type = CMD_UNKNOWN;
+            if (plen < 4)
+                break;
+            memcpy(&v, r->cmd, 4);
+            r->arg = ntohl(v);
+            if (r->arg <= REPLY_MAX_LEN)
+                r->type = CMD_REQUEST;
+            break;
+        case OP_QUIT:
+            r->type = CMD_QUIT;
+            break;
+        default:
+            r->type = CMD_UNKNOWN;
+    }
+    return FRAME_HDR_LEN + plen;
+}
+
+/**
+ * proto_next_req
+ *
+ * Finds and identifies the next request of either framing.
+ *
+ * @param binary true once the connection uses the binary framing
+ * @param buf the buffered stream data
+ * @param len number of buffered bytes
+ * @param r receives the request, CMD_NONE if none is complete
+ * @return the number of bytes consumed, which may be padding without a
+ * request
+ */
+int proto_next_req(bool binary, char *buf, int len, proto_req *r) {
+    int used;
+
+    if (binary)
+        return proto_next_frame(buf, len, r);
+
+    used = proto_next_cmd(buf, len, &r->cmd, &r->cmd_len);
+    r->id = 0;
+    if (r->cmd == NULL) {
+        r->type = CMD_NONE;
+        r->arg = 0;
+        return used;
+    }
+    r->type = proto_parse_cmd(r->cmd, r->cmd_len, &r->arg);
+    return used;
+}
+
+/**
+ * proto_wire_len
+ *
+ * The bytes a request took on the wire, for the trace: those consumed for
+ * it and, in the text framing, the NUL padding after it that is already
+ * buffered, which would otherwise be skipped as no request at all.
+ *
+ * @param binary true once the connection uses the binary framing
+ * @param next the buffered data after the request
+ * @param left number of bytes there
+ * @param used the bytes proto_next_req consumed for the request
+ * @return the request's length
+ */
+int proto_wire_len(bool binary, const char *next, int left, int used) {
+    return binary ? used : used + scan_skip(next, left);
+}
+
+/**
+ * proto_frame_hdr
+ *
+ * Writes a frame header.
+ *
+ * @param hdr FRAME_HDR_LEN bytes
+ * @param opcode the opcode
+ * @param len the payload length
+ * @param id the request id
+ */
+void proto_frame_hdr(char *hdr, int opcode, uint32_t len, uint32_t id) {
+    hdr[0] = PROTO_BIN_VERSION;
+    hdr[1] = opcode;
+    hdr[2] = hdr[3] = 0;
+    len = htonl(len);
+    id = htonl(id);
+    memcpy(hdr + 4, &len, 4);
+    memcpy(hdr + 8, &id, 4);
+}
+
+/**
+ * client_queue_frame_hdr
+ *
+ * Queues a reply frame header, kept in the client's header slot of the
+ * ring entry it takes. The caller checks that the queue has room.
+ *
+ * @param c the client
+ * @param opcode the opcode
+ * @param len the payload length
+ * @param id the request id
+ */
+void client_queue_frame_hdr(client *c, int opcode, uint32_t len, uint32_t id) {
+    char *hdr = c->cold->frames +
+            (c->reply_head + c->n_pending) % REPLY_QUEUE_LEN * FRAME_HDR_LEN;
+
+    proto_frame_hdr(hdr, opcode, len, id);
+    client_queue_reply(c, hdr, FRAME_HDR_LEN);
+}
+
+/**
+ * client_queue_status
+ *
+ * Queues a reply without data: "busy" or "error" in the text framing, a
+ * header alone in the binary one.
+ *
+ * @param c the client
+ * @param opcode OP_BUSY or OP_ERROR
+ * @param id the request id
+ * @return true if the reply was queued
+ */
+bool client_queue_status(client *c, int opcode, uint32_t id) {
+    if (c->n_pending == REPLY_QUEUE_LEN)
+        return false;
+    if (c->binary)
+        client_queue_frame_hdr(c, opcode, 0, id);
+    else if (opcode == OP_BUSY)
+        client_queue_reply(c, OVERLOAD_BUSY_REPLY, OVERLOAD_BUSY_LEN);
+    else
+        client_queue_reply(c, "error\n", 6);
+    return true;
+}
+
+/**
+ * client_negotiate
+ *
+ * Answers "binary N". The reply is the last text the client receives when
+ * the server speaks version N, the requests after it are frames.
+ *
+ * @param c the client
+ * @param version the framing version the client asks for
+ * @return true if the reply was queued
+ */
+bool client_negotiate(client *c, long version) {
+    if (c->n_pending == REPLY_QUEUE_LEN)
+        return false;
+    if (version != PROTO_BIN_VERSION) {
+        client_queue_reply(c, "error\n", 6);
+        return true;
+    }
+    client_queue_reply(c, "binary 1\n", 9);
+    c->binary = true;
+    return true;
+}
+
+/**
+ * client_fill
+ *
+ * Reads from a non-blocking client socket into the client's receive buffer
+ * until the buffer is full or the socket would block. A closed or failed
+ * connection marks the client for removal.
+ *
+ * @param c the client to read from
+ * @return the number of bytes read
+ */
+int client_fill(client *c) {
+    ssize_t r;
+    int total = 0;
+
+    while (c->rlen < RECV_BUFLEN) {
+        r = read(c->fd, c->rbuf + c->rlen, RECV_BUFLEN - c->rlen);
+        if (r > 0) {
+            c->rlen += r;
+            total += r;
+        } else if (r == 0) {
+            c->quit = true;
+            break;
+        } else {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                c->quit = true;
+            break;
+        }
+    }
+    return total;
+}
+
+/**
+ * client_consume
+ *
+ * Drops consumed bytes from the front of the client's receive buffer.
+ *
+ * @param c the client
+ * @param used the number of bytes consumed
+ */
+void client_consume(client *c, int used) {
+    if (used <= 0)
+        return;
+    c->rlen -= used;
+    if (c->rlen > 0)
+        memmove(c->rbuf, c->rbuf + used, c->rlen);
+}
+
+/**
+ * client_queue_reply
+ *
+ * Appends a reply to the client's reply queue. The caller checks that the
+ * queue has room.
+ *
+ * @param c the client
+ * @param buf the reply data, which must outlive the queue entry
+ * @param len the reply length
+ */
+void client_queue_reply(client *c, const char *buf, long len) {
+    reply *r = &c->replies[(c->reply_head + c->n_pending) % REPLY_QUEUE_LEN];
+
+    r->buf = buf;
+    r->len = len;
+    r->fd = -1;
+    r->owned = false;
+    r->ends = false;
+    r->msg = NULL;
+    c->n_pending++;
+}
+
+/**
+ * client_owe
+ *
+ * Counts a traced request as owed until client_flush sends the last ring
+ * entry it queued. A binary reply, a file or a chunked reply takes
+ * several entries, so the entries pending are not the requests.
+ *
+ * @param c the client
+ * @param before the entries pending before the request was handled
+ */
+void client_owe(client *c, int before) {
+    if (c->n_pending == before)
+        return;
+    c->replies[(c->reply_head + c->n_pending - 1) % REPLY_QUEUE_LEN].ends = true;
+    c->cold->n_owed++;
+}
+
+/**
+ * reply_release
+ *
+ * Lets go of the data of a reply that was sent or will not be.
+ *
+ * @param r the reply
+ */
+static void reply_release(reply *r) {
+    if (r->owned)
+        free((char *) r->buf);
+    else if (r->msg != NULL)
+        ps_msg_put(r->msg, 1);
+    r->owned = false;
+    r->msg = NULL;
+}
+
+/**
+ * client_flush
+ *
+ * Writes the queued replies until they are all sent or the socket would
+ * block. The replies up to the next file go out in one sendmsg, so a
+ * pipelining client gets all it is owed in one call and as few segments as
+ * the data fills; with a file next, MSG_MORE holds the last segment back
+ * for the file's data. The position in a partially written reply is kept
+ * in the client. A file is closed once sent; one that ends early, and
+ * every pipe, ends the connection since the client cannot tell where the
+ * reply stops.
+ *
+ * @param c the client
+ * @param s the server counting the calls
+ * @return true when nothing is left to write
+ */
+bool client_flush(client *c, server *s) {
+    struct iovec iov[FLUSH_IOV];
+    struct msghdr msg;
+    ssize_t w, total;
+    reply *r;
+    int n, flags;
+
+    while (c->n_pending > 0) {
+        r = &c->replies[c->reply_head];
+        if (r->fd >= 0) {
+            w = file_send(c, r);
+            s->n_write_calls++;
+            if (w < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    c->quit = true;
+                return false;
+            }
+            c->reply_off += w;
+            if (w == 0 || c->reply_off == r->len) {
+                if (c->reply_off != r->len)
+                    c->quit = true;
+                close(r->fd);
+                c->file_fd = -1;
+                r->fd = -1;
+                r->len = c->reply_off;
+                c->reply_off = 0;
+                c->cold->n_owed -= r->ends;
+                c->reply_head = (c->reply_head + 1) % REPLY_QUEUE_LEN;
+                c->n_pending--;
+            }
+            continue;
+        }
+
+        /* gather the buffered replies up to the next file */
+        total = 0;
+        for (n = 0; n < c->n_pending && n < FLUSH_IOV; n++) {
+            r = &c->replies[(c->reply_head + n) % REPLY_QUEUE_LEN];
+            if (r->fd >= 0)
+                break;
+            iov[n].iov_base = (char *) r->buf;
+            iov[n].iov_len = r->len;
+            total += r->len;
+        }
+        iov[0].iov_base = (char *) iov[0].iov_base + c->reply_off;
+        iov[0].iov_len -= c->reply_off;
+        total -= c->reply_off;
+
+        flags = MSG_NOSIGNAL | (n < c->n_pending ? MSG_MORE : 0);
+        if (n == 1) {
+            w = send(c->fd, iov[0].iov_base, iov[0].iov_len, flags);
+        } else {
+            bzero(&msg, sizeof (msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = n;
+            w = sendmsg(c->fd, &msg, flags);
+        }
+        s->n_write_calls++;
+        if (w < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                c->quit = true;
+            return false;
+        }
+
+        /* retire the replies sent, keep the position in a partial one */
+        c->reply_off += w;
+        while (c->n_pending > 0 && c->replies[c->reply_head].fd < 0 &&
+                c->reply_off >= c->replies[c->reply_head].len) {
+            c->reply_off -= c->replies[c->reply_head].len;
+            c->cold->n_owed -= c->replies[c->reply_head].ends;
+            reply_release(&c->replies[c->reply_head]);
+            c->reply_head = (c->reply_head + 1) % REPLY_QUEUE_LEN;
+            c->n_pending--;
+        }
+
+        /* a short write filled the socket buffer, EPOLLOUT brings it back */
+        if (w < total)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * client_flush_print
+ *
+ * Prints the write calls and TCP segments the replies took per request.
+ *
+ * @param s the server
+ */
+void client_flush_print(server *s) {
+    if (s->n_requests == 0)
+        return;
+    fprintf(stdout, "[ Reply Writes/Request: %.3lf (%lu calls)\n",
+            (double) s->n_write_calls / s->n_requests, s->n_write_calls);
+    if (s->n_segs_out > 0)
+        fprintf(stdout, "[ Segments/Request: %.3lf (%lu segments of closed connections)\n",
+                (double) s->n_segs_out / s->n_requests, s->n_segs_out);
+}
+
+/**
+ * client_drop_replies
+ *
+ * Frees the replies allocated for a client that goes away before they
+ * are sent, and drops its references to broadcast messages.
+ *
+ * @param c the client
+ */
+void client_drop_replies(client *c) {
+    reply *r;
+    int i;
+
+    for (i = 0; i < c->n_pending; i++) {
+        r = &c->replies[(c->reply_head + i) % REPLY_QUEUE_LEN];
+        reply_release(r);
+    }
+    c->n_pending = 0;
+    c->cold->n_owed = 0;
+}
+
+/**
+ * client_segs_out
+ *
+ * @param fd a client's socket
+ * @return the data segments TCP sent on it, 0 for a Unix socket
+ */
+unsigned long client_segs_out(int fd) {
+    struct tcp_info ti;
+    socklen_t len = sizeof (ti);
+
+    bzero(&ti, sizeof (ti));
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &ti, &len) < 0)
+        return 0;
+    return ti.tcpi_data_segs_out;
+}
@@ -0,0 +1,182 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		proto_bench.c - Parse throughput of the request framings
+--
+--	PROGRAM:			proto_bench
+--						./proto_bench [-m megabytes] [-n passes] [-s size]
+--
+--	FUNCTIONS:			clock_gettime
+--
+--	DATE:				October 19, 2026
+--
+--	PROGRAMMERS:		Jivanjot Brar & Shan Bains
+--
+--	NOTES:
+--	Fills a buffer with pipelined requests the way the clients send them and
+--	times proto_next_req splitting and identifying all of them: text
+--	requests back to back, text requests NUL padded to BUFLEN as the
+--	original clients send them and padded to -s bytes as tcp_clnt -s sends
+--	them, with every newline scan kernel the CPU has, and binary frames of
+--	BUFLEN and -s bytes. The rates are of the bytes parsed, in GB/s, and of
+--	the requests found.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+
+#define USAGE "Usage: %s [-m megabytes] [-n passes] [-s size]\n"
+
+/**
+ * now_ns
+ *
+ * @return the monotonic clock in nanoseconds
+ */
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * fill_text
+ *
+ * @param buf the buffer
+ * @param len its size
+ * @param size bytes per request, 0 for no padding
+ * @return the number of bytes filled with whole requests
+ */
+static int fill_text(char *buf, int len, int size) {
+    const char *cmd = "request 1024\n";
+    int n = strlen(cmd), step = size > n ? size : n, off;
+
+    memset(buf, 0, len);
+    for (off = 0; off + step <= len; off += step)
+        memcpy(buf + off, cmd, n);
+    return off;
+}
+
+/**
+ * fill_frames
+ *
+ * @param buf the buffer
+ * @param len its size
+ * @param size bytes per frame, header included
+ * @return the number of bytes filled with whole frames
+ */
+static int fill_frames(char *buf, int len, int size) {
+    uint32_t v = htonl(1024), id = 0;
+    int off;
+
+    memset(buf, 0, len);
+    for (off = 0; off + size <= len; off += size) {
+        proto_frame_hdr(buf + off, OP_REQUEST, size - FRAME_HDR_LEN, id++);
+        memcpy(buf + off + FRAME_HDR_LEN, &v, 4);
+    }
+    return off;
+}
+
+/**
+ * run
+ *
+ * Parses the buffer n times and prints the rates.
+ *
+ * @param name the input and kernel
+ * @param binary true for frames
+ * @param buf the requests
+ * @param len their length
+ * @param n passes
+ */
+static void run(const char *name, bool binary, char *buf, int len, int n) {
+    unsigned long found = 0;
+    uint64_t start = 0, end;
+    proto_req r;
+    int i, off, used;
+    double secs;
+
+    /* one pass outside the timing brings the input into the caches */
+    for (i = -1; i < n; i++) {
+        if (i == 0)
+            start = now_ns();
+        for (off = 0; (used = proto_next_req(binary, buf + off, len - off, &r)) > 0;) {
+            off += used;
+            if (r.type == CMD_REQUEST && i >= 0)
+                found++;
+            else if (r.type == CMD_NONE)
+                break;
+        }
+    }
+    end = now_ns();
+    secs = (end - start) / 1e9;
+    fprintf(stdout, "[ %-22s %8.2lf GB/s %10.2lf Mreq/s (%lu requests)\n", name,
+            (double) len * n / secs / 1e9, found / secs / 1e6, found / n);
+}
+
+/**
+ * main
+ *
+ * @param argc
+ * @param argv
+ * @return
+ */
+int main(int argc, char **argv) {
+    int opt, k, len, n = 20, mb = 16, size = 4096;
+    const char *kernel;
+    char name[64], *buf;
+
+    while ((opt = getopt(argc, argv, "m:n:s:")) != -1) {
+        switch (opt) {
+            case 'm':
+                mb = atoi(optarg); // size of the input
+                break;
+            case 'n':
+                n = atoi(optarg); // passes over it
+                break;
+            case 's':
+                size = atoi(optarg); // padded request and frame size
+                break;
+            default:
+                fprintf(stderr, USAGE, argv[0]);
+                exit(1);
+        }
+    }
+    if (optind != argc || mb < 1 || n < 1 || size < BUFLEN || size > FRAME_MAX_PAYLOAD) {
+        fprintf(stderr, USAGE, argv[0]);
+        exit(1);
+    }
+    if ((buf = malloc((size_t) mb << 20)) == NULL)
+        SystemFatal("malloc(): Failed");
+
+    for (k = SCAN_SCALAR; k <= SCAN_AVX2; k++) {
+        if ((kernel = proto_scan_use(k)) == NULL)
+            continue;
+        len = fill_text(buf, mb << 20, 0);
+        snprintf(name, sizeof (name), "text %s:", kernel);
+        run(name, false, buf, len, n);
+        len = fill_text(buf, mb << 20, BUFLEN);
+        snprintf(name, sizeof (name), "text/%d %s:", BUFLEN, kernel);
+        run(name, false, buf, len, n);
+        len = fill_text(buf, mb << 20, size);
+        snprintf(name, sizeof (name), "text/%d %s:", size, kernel);
+        run(name, false, buf, len, n);
+    }
+
+    len = fill_frames(buf, mb << 20, BUFLEN);
+    snprintf(name, sizeof (name), "binary/%d:", BUFLEN);
+    run(name, true, buf, len, n);
+    len = fill_frames(buf, mb << 20, size);
+    snprintf(name, sizeof (name), "binary/%d:", size);
+    run(name, true, buf, len, n);
+
+    free(buf);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * SystemFatal
+ *
+ * Displays a perror message and exits the program.
+ *
+ * @param message takes in a string message
+ */
+void SystemFatal(const char* message) {
+    perror(message);
+    exit(EXIT_FAILURE);
+}
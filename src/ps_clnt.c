@@ -0,0 +1,284 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		ps_clnt.c - Broadcast fan out latency client
+--
+--	PROGRAM:			ps_clnt
+--						./ps_clnt [-n subscribers] [-m messages] [-i interval_ms]
+--						[-l length] HOST PORT
+--
+--	FUNCTIONS:			epoll_wait, clock_gettime
+--
+--	DATE:				October 19, 2026
+--
+--	PROGRAMMERS:		Jivanjot Brar & Shan Bains
+--
+--	NOTES:
+--	Connects -n subscribers to e_svr -S and one more connection that
+--	publishes -m messages of -l bytes, one at a time, -i milliseconds
+--	apart. For every message it times the first and the last subscriber
+--	to receive it, from the moment it was published, and the spread
+--	between the two, the time the server takes to reach every subscriber.
+--	A message not received by every subscriber within a second is counted
+--	as missed by the rest, which a server shedding slow subscribers may
+--	have disconnected. The open file limit is raised to its hard limit,
+--	which has to allow the subscribers of the server and of the client.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+#include <sys/resource.h>
+
+#define USAGE "Usage: %s [-n subscribers] [-m messages] [-i interval_ms] [-l length] HOST PORT\n"
+
+#define PS_CLNT_TIMEOUT_MS 1000 // wait for a message to reach every subscriber
+#define PS_CLNT_RBUF 4096
+
+typedef struct {
+    int fd;
+    int skip; /* bytes of the "subscribed" answer still to come */
+    int off; /* into the message being received */
+    char seq[9]; /* its number, NUL terminated */
+    int last; /* number of the last message received */
+    int n_got;
+    bool closed;
+} subscriber;
+
+int length = 32;
+
+/**
+ * now_us
+ *
+ * @return the monotonic clock in microseconds
+ */
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * connect_to
+ *
+ * @param addr the server
+ * @return a connected socket
+ */
+static int connect_to(struct sockaddr_in *addr) {
+    int sd;
+
+    if ((sd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+        SystemFatal("Cannot Create Socket!");
+    if (connect(sd, (struct sockaddr *) addr, sizeof (struct sockaddr_in)) < 0)
+        SystemFatal("Can't connect to server");
+    return sd;
+}
+
+/**
+ * read_all
+ *
+ * Reads what a subscriber's socket holds and notes the number of every
+ * message that is complete. The messages all have the same length and
+ * start with their number.
+ *
+ * @param sub the subscriber
+ */
+static void read_all(subscriber *sub) {
+    char buf[PS_CLNT_RBUF];
+    ssize_t r;
+    int p, k;
+
+    while ((r = read(sub->fd, buf, sizeof (buf))) > 0) {
+        for (p = 0; p < r; p += k) {
+            if (sub->skip > 0) {
+                k = sub->skip < r - p ? sub->skip : r - p;
+                sub->skip -= k;
+                continue;
+            }
+            if (sub->off < 8) {
+                k = 8 - sub->off < r - p ? 8 - sub->off : r - p;
+                memcpy(sub->seq + sub->off, buf + p, k);
+            } else {
+                k = length + 1 - sub->off < r - p ? length + 1 - sub->off : r - p;
+            }
+            if ((sub->off += k) == length + 1) {
+                sub->last = atoi(sub->seq);
+                sub->n_got++;
+                sub->off = 0;
+            }
+        }
+    }
+    if (r == 0 || (r < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        sub->closed = true;
+}
+
+/**
+ * main
+ *
+ * @param argc
+ * @param argv
+ * @return
+ */
+int main(int argc, char **argv) {
+    int i, j, n, opt, epfd, pub, n_subs = 1000, n_msgs = 100, interval = 10;
+    int done, n_closed = 0;
+    unsigned long missed = 0;
+    uint64_t published, first, now, deadline;
+    struct sockaddr_in server_addr;
+    struct epoll_event ev, *events;
+    struct rlimit rl;
+    struct hostent *hp;
+    hist first_us, last_us, spread_us;
+    subscriber *subs;
+    subscriber *sub;
+    char *msg, ack[64];
+
+    while ((opt = getopt(argc, argv, "n:m:i:l:")) != -1) {
+        switch (opt) {
+            case 'n':
+                n_subs = atoi(optarg); // subscriber connections
+                break;
+            case 'm':
+                n_msgs = atoi(optarg); // messages published
+                break;
+            case 'i':
+                interval = atoi(optarg); // time between messages
+                break;
+            case 'l':
+                length = atoi(optarg); // bytes per message
+                break;
+            default:
+                fprintf(stderr, USAGE, argv[0]);
+                exit(1);
+        }
+    }
+    if (argc - optind != 2 || n_subs < 1 || n_msgs < 1 || interval < 0 || length < 8 ||
+            length > BUFLEN * 8) {
+        fprintf(stderr, USAGE, argv[0]);
+        exit(1);
+    }
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    bzero((char *) &server_addr, sizeof (struct sockaddr_in));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(atoi(argv[optind + 1]));
+    if ((hp = gethostbyname(argv[optind])) == NULL) {
+        fprintf(stderr, "Unknown server address\n");
+        exit(1);
+    }
+    bcopy(hp->h_addr, (char *) &server_addr.sin_addr, hp->h_length);
+
+    if ((epfd = epoll_create1(0)) < 0)
+        SystemFatal("epoll_create1(): Failed");
+    subs = calloc(n_subs, sizeof (subscriber));
+    events = malloc(EPOLL_MAX_EVENTS * sizeof (struct epoll_event));
+    if (subs == NULL || events == NULL)
+        SystemFatal("malloc(): Failed");
+
+    /* every subscriber is answered before the first message goes out */
+    for (i = 0; i < n_subs; i++) {
+        subs[i].fd = connect_to(&server_addr);
+        if (write(subs[i].fd, "subscribe\n", 10) != 10)
+            SystemFatal("write(): Failed");
+        if (fcntl(subs[i].fd, F_SETFL, O_NONBLOCK | fcntl(subs[i].fd, F_GETFL, 0)) == -1)
+            SystemFatal("fcntl(): Non-Block Failed");
+        ev.events = EPOLLIN | EPOLLET;
+        subs[i].skip = 11;
+        ev.data.u32 = i;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, subs[i].fd, &ev) == -1)
+            SystemFatal("epoll_ctl() error");
+    }
+    for (done = 0; done < n_subs;) {
+        if ((n = epoll_wait(epfd, events, EPOLL_MAX_EVENTS, PS_CLNT_TIMEOUT_MS * 5)) <= 0) {
+            fprintf(stderr, "%d of %d subscribers answered\n", done, n_subs);
+            exit(1);
+        }
+        for (j = 0; j < n; j++) {
+            sub = &subs[events[j].data.u32];
+            if (sub->skip > 0) {
+                read_all(sub);
+                if (sub->skip == 0)
+                    done++;
+            }
+        }
+    }
+
+    /* "publish NNNNNNNNxxx...\n", the message numbered in its first 8 bytes */
+    pub = connect_to(&server_addr);
+    if ((msg = malloc(length + 16)) == NULL)
+        SystemFatal("malloc(): Failed");
+    memcpy(msg, "publish ", 8);
+    memset(msg + 8, 'x', length);
+    msg[8 + length] = '\n';
+
+    hist_init(&first_us);
+    hist_init(&last_us);
+    hist_init(&spread_us);
+    fprintf(stdout, "[ %d subscribers, %d messages of %d bytes\n", n_subs, n_msgs, length);
+    for (j = 1; j <= n_msgs; j++) {
+        snprintf(ack, sizeof (ack), "%08d", j);
+        memcpy(msg + 8, ack, 8);
+
+        published = now_us();
+        first = 0;
+        if (write(pub, msg, length + 9) != length + 9)
+            SystemFatal("write(): Failed");
+        deadline = published + PS_CLNT_TIMEOUT_MS * 1000;
+        for (done = 0; done < n_subs - n_closed && (now = now_us()) < deadline;) {
+            n = epoll_wait(epfd, events, EPOLL_MAX_EVENTS, (deadline - now) / 1000 + 1);
+            now = now_us();
+            for (i = 0; i < n; i++) {
+                sub = &subs[events[i].data.u32];
+                if (sub->closed)
+                    continue;
+                if (sub->last < j) {
+                    read_all(sub);
+                    if (sub->last == j) {
+                        if (first == 0)
+                            first = now;
+                        done++;
+                    }
+                }
+                if (sub->closed)
+                    n_closed++;
+            }
+        }
+        now = now_us();
+        if (first != 0) {
+            hist_add(&first_us, first - published);
+            hist_add(&last_us, now - published);
+            hist_add(&spread_us, now - first);
+        }
+        if (read(pub, ack, sizeof (ack)) <= 0)
+            SystemFatal("read(): Publisher Failed");
+        if (interval > 0)
+            usleep(interval * 1000);
+    }
+
+    hist_print(&first_us, "Publish to First Delivery", "us");
+    hist_print(&last_us, "Publish to Last Delivery", "us");
+    hist_print(&spread_us, "First to Last Delivery", "us");
+    for (i = 0; i < n_subs; i++)
+        missed += n_msgs - subs[i].n_got;
+    fprintf(stdout, "[ Deliveries: %lu missed, %d subscribers disconnected\n", missed, n_closed);
+
+    for (i = 0; i < n_subs; i++)
+        close(subs[i].fd);
+    close(pub);
+    free(subs);
+    free(events);
+    free(msg);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * SystemFatal
+ *
+ * Displays a perror message and exits the program.
+ *
+ * @param message takes in a string message
+ */
+void SystemFatal(const char* message) {
+    perror(message);
+    exit(EXIT_FAILURE);
+}
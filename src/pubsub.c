@@ -0,0 +1,340 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		pubsub.c - Broadcast of published messages to subscribers
+--
+--	FUNCTIONS:			eventfd, pthread_mutex_lock
+--
+--	DATE:				October 19, 2026
+--
+--	NOTES:
+--	With -S a connection that sends "subscribe" is answered "subscribed\n"
+--	and from then on receives every "publish MESSAGE" of any connection
+--	as "MESSAGE\n"; the publisher is answered "published\n".
+--
+--	A message is copied once, into a buffer that is never written again,
+--	and queued by reference on the reply ring of every subscriber, so a
+--	broadcast to thousands of connections costs one copy and a ring entry
+--	each. The buffer counts its references and is freed when the last
+--	subscriber has written it out. Each reactor keeps its own subscribers;
+--	a message published on one is handed to the others through their
+--	inboxes, which an eventfd in their epoll set tells them about.
+--
+--	A subscriber with the depth of -S replies still queued is slow. By the
+--	lag policy it misses the messages until it catches up, by the drop
+--	policy it is disconnected. The time from publishing a message to the
+--	last write of it is kept in a histogram.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+
+static const char *pubsub_policies[] = {"lag", "drop"};
+
+/**
+ * pubsub_new
+ *
+ * Creates the hub the reactors join, and raises the open file limit to
+ * its hard limit for the subscribers.
+ *
+ * @param spec the replies a subscriber may have queued and the policy
+ * for a slow one, "32,drop"; the policy defaults to lag
+ * @return the hub, NULL if the spec is malformed
+ */
+pubsub* pubsub_new(const char *spec) {
+    struct rlimit rl;
+    pubsub *ps;
+    char *end;
+    long depth;
+    int i;
+
+    depth = strtol(spec, &end, 10);
+    if (end == spec || depth < 1 || depth > REPLY_QUEUE_LEN)
+        return NULL;
+    if ((ps = calloc(1, sizeof (pubsub))) == NULL)
+        return NULL;
+    ps->depth = depth;
+    ps->policy = PUBSUB_LAG;
+
+    if (*end == ',') {
+        for (i = PUBSUB_LAG; i <= PUBSUB_DROP; i++) {
+            if (strcmp(end + 1, pubsub_policies[i]) == 0)
+                break;
+        }
+        if (i > PUBSUB_DROP) {
+            free(ps);
+            return NULL;
+        }
+        ps->policy = i;
+    } else if (*end != '\0') {
+        free(ps);
+        return NULL;
+    }
+    if (pthread_mutex_init(&ps->lock, NULL) != 0) {
+        free(ps);
+        return NULL;
+    }
+    hist_init(&ps->fanout);
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    return ps;
+}
+
+/**
+ * pubsub_join
+ *
+ * Adds a reactor to the hub, before it takes connections.
+ *
+ * @param ps the hub
+ * @return the reactor's end of the hub
+ */
+ps_node* pubsub_join(pubsub *ps) {
+    ps_node *n;
+
+    if ((n = aligned_alloc(CACHE_LINE, sizeof (ps_node))) == NULL)
+        SystemFatal("pubsub_join(): Failed");
+    bzero(n, sizeof (ps_node));
+    if ((n->efd = eventfd(0, EFD_NONBLOCK)) < 0)
+        SystemFatal("eventfd(): Failed");
+    if (pthread_mutex_init(&n->lock, NULL) != 0)
+        SystemFatal("pthread_mutex_init() Failed\n");
+    n->hub = ps;
+
+    pthread_mutex_lock(&ps->lock);
+    if (ps->n_nodes == PUBSUB_MAX_NODES)
+        SystemFatal("pubsub_join(): Too many reactors");
+    ps->nodes[ps->n_nodes++] = n;
+    pthread_mutex_unlock(&ps->lock);
+    return n;
+}
+
+/**
+ * ps_msg_put
+ *
+ * Drops references to a message, and frees it after the last one, which
+ * ends its fan out.
+ *
+ * @param m the message
+ * @param refs the references dropped
+ */
+void ps_msg_put(ps_msg *m, int refs) {
+    pubsub *ps = m->hub;
+    uint64_t ns;
+
+    if (refs == 0 || __atomic_sub_fetch(&m->refs, refs, __ATOMIC_ACQ_REL) != 0)
+        return;
+    ns = overload_now() - m->published_ns;
+    pthread_mutex_lock(&ps->lock);
+    hist_add(&ps->fanout, ns);
+    pthread_mutex_unlock(&ps->lock);
+    free(m);
+}
+
+/**
+ * pubsub_subscribe
+ *
+ * @param n the reactor's end of the hub
+ * @param c the client to send the messages to
+ * @return true if the reply was queued
+ */
+bool pubsub_subscribe(ps_node *n, client *c) {
+    if (c->n_pending == REPLY_QUEUE_LEN)
+        return false;
+    if (c->cold->sub < 0) {
+        if (n->n_subs == n->cap_subs) {
+            n->cap_subs = n->cap_subs ? 2 * n->cap_subs : 1024;
+            if ((n->subs = realloc(n->subs, n->cap_subs * sizeof (client *))) == NULL)
+                SystemFatal("realloc(): Failed");
+        }
+        c->cold->sub = n->n_subs;
+        n->subs[n->n_subs++] = c;
+        if (n->n_subs > n->max_subs)
+            n->max_subs = n->n_subs;
+    }
+    client_queue_reply(c, "subscribed\n", 11);
+    return true;
+}
+
+/**
+ * pubsub_leave
+ *
+ * Takes a client that goes away off the subscribers, the last one taking
+ * its place.
+ *
+ * @param n the reactor's end of the hub
+ * @param c the client
+ */
+void pubsub_leave(ps_node *n, client *c) {
+    int i = c->cold->sub;
+
+    if (i < 0)
+        return;
+    n->subs[i] = n->subs[--n->n_subs];
+    n->subs[i]->cold->sub = i;
+    c->cold->sub = -1;
+}
+
+/**
+ * pubsub_fanout
+ *
+ * Queues a message on every subscriber of this reactor and writes what
+ * the sockets take. A dropped subscriber is shut down and removed by the
+ * loop when the hang up comes, as any other.
+ *
+ * @param s the reactor
+ * @param m the message, of which the caller holds a reference
+ * @param from the client publishing it, which is never removed here and
+ * keeps room for its own reply
+ */
+static void pubsub_fanout(server *s, ps_msg *m, client *from) {
+    ps_node *n = s->ps_local;
+    int i, queued = 0, subs = n->n_subs;
+    client *c;
+
+    /* take a reference for every subscriber at once, and give back the
+     * unused ones after, so the writes may drop theirs as they go */
+    __atomic_add_fetch(&m->refs, subs, __ATOMIC_RELAXED);
+    for (i = subs - 1; i >= 0; i--) {
+        c = n->subs[i];
+        if (c->quit)
+            continue;
+        if (c->n_pending >= n->hub->depth ||
+                (c == from && c->n_pending + 1 == REPLY_QUEUE_LEN)) {
+            if (n->hub->policy == PUBSUB_LAG || c == from) {
+                n->n_lagged++;
+                continue;
+            }
+            n->n_dropped++;
+            c->quit = true;
+        } else {
+            client_queue_reply(c, m->data, m->len);
+            c->replies[(c->reply_head + c->n_pending - 1) % REPLY_QUEUE_LEN].msg = m;
+            queued++;
+            client_flush(c, s);
+        }
+
+        /* the hang up brings the loop back to remove the client */
+        if (c->quit && c != from)
+            shutdown(c->fd, SHUT_RDWR);
+    }
+    n->n_delivered += queued;
+    ps_msg_put(m, subs - queued);
+}
+
+/**
+ * pubsub_publish
+ *
+ * Answers "publish MESSAGE": sends the message to the subscribers of
+ * this reactor and hands it to the other reactors.
+ *
+ * @param s the reactor
+ * @param c the publishing client
+ * @param r the request
+ * @return true if the reply was queued
+ */
+bool pubsub_publish(server *s, client *c, proto_req *r) {
+    ps_node *n = s->ps_local, *o;
+    pubsub *ps = n->hub;
+    uint64_t one = 1;
+    long len = r->cmd_len - r->arg;
+    ps_msg *m;
+    int i;
+
+    if (c->n_pending == REPLY_QUEUE_LEN)
+        return false;
+    if ((m = malloc(sizeof (ps_msg) + len + 1)) == NULL)
+        SystemFatal("malloc(): Failed");
+    memcpy(m->data, r->cmd + r->arg, len);
+    m->data[len] = '\n';
+    m->len = len + 1;
+    m->hub = ps;
+    m->published_ns = overload_now();
+
+    /* a reference for this reactor and one for each of the others */
+    pthread_mutex_lock(&ps->lock);
+    m->refs = ps->n_nodes;
+    for (i = 0; i < ps->n_nodes; i++) {
+        if ((o = ps->nodes[i]) == n)
+            continue;
+        pthread_mutex_lock(&o->lock);
+        if (o->n_inbox == o->cap_inbox) {
+            o->cap_inbox = o->cap_inbox ? 2 * o->cap_inbox : 64;
+            if ((o->inbox = realloc(o->inbox, o->cap_inbox * sizeof (ps_msg *))) == NULL)
+                SystemFatal("realloc(): Failed");
+        }
+        o->inbox[o->n_inbox++] = m;
+        pthread_mutex_unlock(&o->lock);
+        if (write(o->efd, &one, sizeof (one)) < 0 && errno != EAGAIN)
+            SystemFatal("write(): eventfd Failed");
+    }
+    pthread_mutex_unlock(&ps->lock);
+
+    n->n_published++;
+    pubsub_fanout(s, m, c);
+    ps_msg_put(m, 1);
+    client_queue_reply(c, "published\n", 10);
+    return true;
+}
+
+/**
+ * pubsub_deliver
+ *
+ * Sends the messages other reactors handed to this one, when its eventfd
+ * wakes it.
+ *
+ * @param s the reactor
+ */
+void pubsub_deliver(server *s) {
+    ps_node *n = s->ps_local;
+    ps_msg **inbox;
+    uint64_t count;
+    int i, len;
+
+    if (read(n->efd, &count, sizeof (count)) < 0 && errno != EAGAIN)
+        SystemFatal("read(): eventfd Failed");
+    pthread_mutex_lock(&n->lock);
+    inbox = n->inbox;
+    len = n->n_inbox;
+    n->inbox = NULL;
+    n->n_inbox = n->cap_inbox = 0;
+    pthread_mutex_unlock(&n->lock);
+
+    for (i = 0; i < len; i++) {
+        pubsub_fanout(s, inbox[i], NULL);
+        ps_msg_put(inbox[i], 1);
+    }
+    free(inbox);
+}
+
+/**
+ * pubsub_print
+ *
+ * Prints the reactors' counters added up and the fan out times. The lock
+ * is only tried, as the servers print from their SIGINT handler, which
+ * may interrupt a reactor holding it.
+ *
+ * @param ps the hub
+ */
+void pubsub_print(pubsub *ps) {
+    bool locked = pthread_mutex_trylock(&ps->lock) == 0;
+    unsigned long published = 0, delivered = 0, lagged = 0, dropped = 0;
+    int i, subs = 0;
+
+    for (i = 0; i < ps->n_nodes; i++) {
+        published += ps->nodes[i]->n_published;
+        delivered += ps->nodes[i]->n_delivered;
+        lagged += ps->nodes[i]->n_lagged;
+        dropped += ps->nodes[i]->n_dropped;
+        subs += ps->nodes[i]->max_subs;
+    }
+    fprintf(stdout, "[ Pub/Sub: %lu messages, %lu deliveries to up to %d subscribers, %s "
+            "policy at %d queued\n", published, delivered, subs, pubsub_policies[ps->policy],
+            ps->depth);
+    fprintf(stdout, "[ Pub/Sub Slow Subscribers: %lu messages missed, %lu dropped\n",
+            lagged, dropped);
+    hist_print(&ps->fanout, "Publish to Last Write", "ns");
+    if (locked)
+        pthread_mutex_unlock(&ps->lock);
+}
@@ -0,0 +1,660 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		replay_clnt.c - Replays a trace captured by a server
+--
+--	PROGRAM:			replay_clnt
+--						./replay_clnt [-s speed] TRACE HOST PORT
+--
+--	FUNCTIONS:			epoll_wait, clock_gettime
+--
+--	DATE:				October 19, 2026
+--
+--	PROGRAMMERS:		Jivanjot Brar & Shan Bains
+--
+--	NOTES:
+--	Plays back a trace written by a server started with -R, see trace.c,
+--	against any server: every connection is opened, sends its commands
+--	and closes at the time it did in the trace, divided by -s. -s 2
+--	replays twice as fast, -s 0 as fast as the server allows. Each command
+--	goes out as it came in: its text, its framing and its NUL padding. A
+--	connection sends a command once no more of its replies are
+--	outstanding than were when the server read it in the trace, so a
+--	client that waited for every reply is replayed waiting and one that
+--	pipelined is replayed pipelining to the same depth. A command may then
+--	go out later than its time; that delay is reported as the schedule
+--	lag. No more connections are open at once than there were in the
+--	trace, which keeps -s 0 from opening every connection at once.
+--
+--	The same trace replayed against two builds of a server is the same
+--	workload, down to the order of the commands and their sizes. The
+--	replies are read by their form: the bytes of a request, a line, or a
+--	size line and that many bytes for a value or a file, so the server
+--	must run with the options of the traced one (-K, -f, -S) and must not
+--	shed load with -O. Once a connection subscribes its replies and the
+--	messages published to it cannot be told apart, and are only counted.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+#include <sys/resource.h>
+
+#define USAGE "Usage: %s [-s speed] TRACE HOST PORT\n"
+
+#define REPLAY_RBUF 65536
+#define REPLAY_QUEUE (UINT8_MAX + 1) // replies a connection may have outstanding
+
+/* a record of the trace, with the text of its command */
+typedef struct {
+    uint64_t at; /* from the start of the trace */
+    uint32_t conn;
+    uint32_t arg;
+    uint8_t kind;
+    uint8_t cmd;
+    uint8_t depth;
+    bool binary;
+    int len;
+    char *text; /* NULL if the command is made up from the record */
+    int text_len;
+} replay_rec;
+
+/* a reply a connection is waiting for */
+typedef struct {
+    long want; /* bytes still to read, -1 while its line is read */
+    bool stream; /* its data goes on until the server closes */
+    uint64_t sent_us;
+} replay_expect;
+
+typedef struct {
+    int fd; /* -1 before it opens and after it closes */
+    long next; /* its next record to send, -1 for none */
+    int n_due; /* records of it due and not sent yet */
+    replay_expect *out; /* REPLAY_QUEUE ring of the replies outstanding */
+    int out_head, n_out;
+    bool subscribed; /* replies are no longer read */
+    bool quit; /* the server closes it */
+    char line[32]; /* the start of a reply's line */
+    int line_len;
+    char *obuf; /* commands the socket has not taken yet */
+    int olen, ocap;
+    bool want_out; /* waiting for EPOLLOUT */
+    uint32_t id; /* of the next frame */
+} replay_conn;
+
+replay_rec *recs;
+long *next_rec; /* the next record of the same connection, -1 for none */
+replay_conn *conns;
+hist latency_us, lag_us;
+double speed = 1.0;
+uint64_t start;
+long n_work; /* records due and not finished */
+int epfd, n_open, n_lost;
+unsigned long n_requests, n_bytes;
+
+/**
+ * now_us
+ *
+ * @return the monotonic clock in microseconds
+ */
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * due_us
+ *
+ * @param i a record
+ * @return when the record is due in the replay
+ */
+static uint64_t due_us(long i) {
+    return speed > 0 ? start + (uint64_t) (recs[i].at / speed) : start;
+}
+
+/**
+ * conn_close
+ *
+ * Closes a connection and drops the records it has not sent.
+ *
+ * @param c the connection
+ * @param lost true if the server closed it before the trace did
+ */
+static void conn_close(replay_conn *c, bool lost) {
+    if (c->fd < 0)
+        return;
+    close(c->fd);
+    c->fd = -1;
+    n_open--;
+    n_work -= c->n_due + c->n_out;
+    n_lost += lost;
+    c->n_due = 0;
+    c->n_out = 0;
+    c->next = -1;
+    free(c->out);
+    free(c->obuf);
+    c->out = NULL;
+    c->obuf = NULL;
+    c->olen = c->ocap = 0;
+}
+
+/**
+ * conn_put
+ *
+ * Adds bytes to what the connection has to send.
+ *
+ * @param c the connection
+ * @param data the bytes, NULL for NUL padding
+ * @param len their number
+ */
+static void conn_put(replay_conn *c, const void *data, int len) {
+    if (len <= 0)
+        return;
+    if (c->olen + len > c->ocap) {
+        c->ocap = c->olen + len > 2 * c->ocap ? c->olen + len : 2 * c->ocap;
+        if ((c->obuf = realloc(c->obuf, c->ocap)) == NULL)
+            SystemFatal("realloc(): Failed");
+    }
+    if (data != NULL)
+        memcpy(c->obuf + c->olen, data, len);
+    else
+        bzero(c->obuf + c->olen, len);
+    c->olen += len;
+}
+
+/**
+ * conn_write
+ *
+ * Writes what the connection has to send, and waits for EPOLLOUT when the
+ * socket does not take it all.
+ *
+ * @param c the connection
+ */
+static void conn_write(replay_conn *c) {
+    struct epoll_event ev;
+    ssize_t w = 0;
+
+    if (c->fd < 0)
+        return;
+    if (c->olen > 0 && (w = write(c->fd, c->obuf, c->olen)) < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            conn_close(c, true);
+            return;
+        }
+        w = 0;
+    }
+    c->olen -= w;
+    memmove(c->obuf, c->obuf + w, c->olen);
+    if ((c->olen > 0) != c->want_out) {
+        c->want_out = c->olen > 0;
+        ev.events = EPOLLIN | (c->want_out ? EPOLLOUT : 0);
+        ev.data.u32 = c - conns;
+        if (epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev) == -1)
+            SystemFatal("epoll_ctl() error");
+    }
+}
+
+/**
+ * conn_expect
+ *
+ * Queues a reply the connection waits for.
+ *
+ * @param c the connection
+ * @param want its length, -1 for a line and what it announces
+ * @param sent_us when its command went out
+ */
+static void conn_expect(replay_conn *c, long want, uint64_t sent_us) {
+    replay_expect *e = &c->out[(c->out_head + c->n_out++) % REPLAY_QUEUE];
+
+    e->want = want;
+    e->stream = false;
+    e->sent_us = sent_us;
+}
+
+/**
+ * conn_command
+ *
+ * Puts a command on the connection the way it came in the trace, and
+ * queues the reply it waits for.
+ *
+ * @param c the connection
+ * @param r the command's record
+ * @param now the time
+ */
+static void conn_command(replay_conn *c, replay_rec *r, uint64_t now) {
+    char hdr[FRAME_HDR_LEN], msg[32];
+    long reply = r->arg == 0 ? BUFLEN : r->arg;
+    uint32_t v;
+    int len, plen;
+
+    if (r->binary) {
+        /* a request frame carries its reply size, padded as it was; any
+         * other frame is one the server does not know, answered OP_ERROR */
+        plen = r->len - FRAME_HDR_LEN;
+        if (r->cmd == CMD_QUIT) {
+            proto_frame_hdr(hdr, OP_QUIT, plen, c->id++);
+            conn_put(c, hdr, FRAME_HDR_LEN);
+            conn_put(c, NULL, plen);
+            c->quit = true;
+            return;
+        } else if (r->cmd == CMD_REQUEST) {
+            plen = plen < 4 ? 4 : plen;
+            proto_frame_hdr(hdr, OP_REQUEST, plen, c->id++);
+            v = htonl(reply);
+            conn_put(c, hdr, FRAME_HDR_LEN);
+            conn_put(c, &v, 4);
+            conn_put(c, NULL, plen - 4);
+        } else {
+            plen = plen < r->text_len ? r->text_len : plen;
+            proto_frame_hdr(hdr, OP_ERROR, plen, c->id++);
+            conn_put(c, hdr, FRAME_HDR_LEN);
+            conn_put(c, r->text, r->text_len);
+            conn_put(c, NULL, plen - r->text_len);
+        }
+        if (!c->subscribed)
+            conn_expect(c, FRAME_HDR_LEN + (r->cmd == CMD_REQUEST ? reply : 0), now);
+        return;
+    }
+
+    switch (r->cmd) {
+        case CMD_REQUEST:
+            len = r->arg == 0 ? snprintf(msg, sizeof (msg), "request\n") :
+                    snprintf(msg, sizeof (msg), "request %u\n", r->arg);
+            break;
+        case CMD_BINARY:
+            len = snprintf(msg, sizeof (msg), "binary %u\n", r->arg);
+            break;
+        case CMD_SUBSCRIBE:
+            len = snprintf(msg, sizeof (msg), "subscribe\n");
+            break;
+        case CMD_QUIT:
+            len = snprintf(msg, sizeof (msg), "quit\n");
+            c->quit = true;
+            break;
+        default:
+            conn_put(c, r->text, r->text_len);
+            msg[0] = '\n';
+            len = 1;
+            break;
+    }
+    conn_put(c, msg, len);
+
+    /* the padding of fixed size requests */
+    if (r->cmd == CMD_REQUEST || r->cmd == CMD_BINARY || r->cmd == CMD_SUBSCRIBE ||
+            r->cmd == CMD_QUIT)
+        conn_put(c, NULL, r->len - len);
+    else
+        conn_put(c, NULL, r->len - r->text_len - len);
+
+    /* unknown text and quit are not answered, the rest by a line and what
+     * it says */
+    if (c->subscribed || r->cmd == CMD_UNKNOWN || r->cmd == CMD_QUIT)
+        return;
+    conn_expect(c, r->cmd == CMD_REQUEST ? reply : -1, now);
+    if (r->cmd == CMD_SUBSCRIBE)
+        c->subscribed = true;
+}
+
+/**
+ * conn_send
+ *
+ * Sends the due records of a connection, up to the first one that was
+ * read in the trace with fewer replies outstanding than there are now.
+ *
+ * @param c the connection
+ */
+static void conn_send(replay_conn *c) {
+    replay_rec *r;
+    uint64_t now;
+    int n_out;
+    long i;
+
+    while (c->fd >= 0 && c->n_due > 0 && c->next >= 0) {
+        i = c->next;
+        r = &recs[i];
+        if (r->kind == TRACE_REQUEST && c->n_out > r->depth)
+            break;
+        c->next = next_rec[i];
+        c->n_due--;
+
+        if (r->kind == TRACE_CLOSE) {
+            n_work--;
+            conn_write(c);
+            conn_close(c, false);
+            return;
+        }
+        if (r->kind != TRACE_REQUEST) {
+            n_work--;
+            continue;
+        }
+        now = now_us();
+        n_out = c->n_out;
+        conn_command(c, r, now);
+        if (c->n_out == n_out)
+            n_work--;
+        if (speed > 0)
+            hist_add(&lag_us, now - due_us(i));
+        n_requests++;
+    }
+    conn_write(c);
+}
+
+/**
+ * conn_replied
+ *
+ * Finishes the oldest reply of a connection.
+ *
+ * @param c the connection
+ */
+static void conn_replied(replay_conn *c) {
+    hist_add(&latency_us, now_us() - c->out[c->out_head].sent_us);
+    c->out_head = (c->out_head + 1) % REPLAY_QUEUE;
+    c->n_out--;
+    c->line_len = 0;
+    n_work--;
+}
+
+/**
+ * conn_parse
+ *
+ * Takes received bytes off the replies a connection waits for.
+ *
+ * @param c the connection
+ * @param p the bytes
+ * @param n their number
+ * @return false if more arrived than was asked for
+ */
+static bool conn_parse(replay_conn *c, const char *p, long n) {
+    replay_expect *e;
+    const char *nl;
+    long k;
+    int i;
+
+    while (n > 0) {
+        if (c->n_out == 0)
+            return c->subscribed;
+        e = &c->out[c->out_head];
+        if (e->stream)
+            return true;
+        if (e->want > 0) {
+            k = n < e->want ? n : e->want;
+            e->want -= k;
+            p += k;
+            n -= k;
+            if (e->want == 0)
+                conn_replied(c);
+            continue;
+        }
+
+        /* a line: a size announces that many bytes, "stream" the rest of
+         * the connection, anything else is the whole reply */
+        nl = memchr(p, '\n', n);
+        k = nl != NULL ? nl - p + 1 : n;
+        for (i = 0; i < k && c->line_len < (int) sizeof (c->line) - 1; i++)
+            c->line[c->line_len++] = p[i];
+        p += k;
+        n -= k;
+        if (nl == NULL)
+            continue;
+        c->line[c->line_len] = '\0';
+        for (i = 0; c->line[i] >= '0' && c->line[i] <= '9'; i++)
+            ;
+        if (i > 0 && c->line[i] == '\n' && (e->want = atol(c->line)) > 0)
+            c->line_len = 0;
+        else if (strcmp(c->line, "stream\n") == 0)
+            e->stream = true;
+        else
+            conn_replied(c);
+    }
+    return true;
+}
+
+/**
+ * conn_read
+ *
+ * Reads a connection's replies and sends its next records as they come.
+ *
+ * @param c the connection
+ */
+static void conn_read(replay_conn *c) {
+    char buf[REPLAY_RBUF];
+    ssize_t r;
+
+    while (c->fd >= 0 && (r = read(c->fd, buf, sizeof (buf))) != 0) {
+        if (r < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                conn_close(c, true);
+            return;
+        }
+        n_bytes += r;
+        if (!conn_parse(c, buf, r)) {
+            fprintf(stderr, "Reply longer than requested, is the server shedding load?\n");
+            exit(1);
+        }
+        conn_send(c);
+    }
+
+    /* a piped file ends with the connection, and so does quit */
+    if (c->fd >= 0 && c->n_out == 1 && c->out[c->out_head].stream) {
+        conn_replied(c);
+        conn_close(c, false);
+    } else if (c->fd >= 0) {
+        conn_close(c, !c->quit);
+    }
+}
+
+/**
+ * load
+ *
+ * Reads a trace and joins the text records to their commands.
+ *
+ * @param path the trace file
+ * @return the number of records, -1 if the file is not a trace
+ */
+static long load(const char *path) {
+    trace_rec *t;
+    replay_rec *r = NULL;
+    uint64_t at = 0;
+    long n, i, m = 0;
+
+    if ((t = trace_load(path, &n)) == NULL)
+        return -1;
+    if ((recs = calloc(n + 1, sizeof (replay_rec))) == NULL)
+        SystemFatal("malloc(): Failed");
+    for (i = 0; i < n; i++) {
+        if (t[i].kind == TRACE_TEXT) {
+            if (r == NULL || t[i].len > sizeof (t[i].text))
+                continue;
+            if ((r->text = realloc(r->text, r->text_len + t[i].len)) == NULL)
+                SystemFatal("realloc(): Failed");
+            memcpy(r->text + r->text_len, t[i].text, t[i].len);
+            r->text_len += t[i].len;
+            continue;
+        }
+        at += t[i].delta_us;
+        r = &recs[m++];
+        r->at = at;
+        r->conn = t[i].conn;
+        r->arg = t[i].arg;
+        r->kind = t[i].kind;
+        r->cmd = t[i].cmd;
+        r->depth = t[i].depth;
+        r->binary = t[i].binary;
+        r->len = t[i].len;
+        if (r->kind != TRACE_REQUEST)
+            r = NULL;
+    }
+    free(t);
+    return m;
+}
+
+/**
+ * main
+ *
+ * @param argc
+ * @param argv
+ * @return
+ */
+int main(int argc, char **argv) {
+    long n, i, cursor = 0, *last;
+    int opt, ready, j, n_conns = 0, in_trace = 0, max_open = 0, wait_ms;
+    uint64_t now, due;
+    struct sockaddr_in server_addr;
+    struct epoll_event ev, *events;
+    struct rlimit rl;
+    struct hostent *hp;
+    replay_conn *c;
+
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        switch (opt) {
+            case 's':
+                speed = atof(optarg); // times the trace's speed, 0 for the most
+                break;
+            default:
+                fprintf(stderr, USAGE, argv[0]);
+                exit(1);
+        }
+    }
+    if (argc - optind != 3 || speed < 0) {
+        fprintf(stderr, USAGE, argv[0]);
+        exit(1);
+    }
+    if ((n = load(argv[optind])) < 0) {
+        fprintf(stderr, "%s is not a trace\n", argv[optind]);
+        exit(1);
+    }
+
+    /* the records of a connection are chained, and the most connections
+     * the trace had open at once bound the replay's */
+    for (i = 0; i < n; i++) {
+        if ((int) recs[i].conn >= n_conns)
+            n_conns = recs[i].conn + 1;
+    }
+    next_rec = malloc((n + 1) * sizeof (long));
+    last = malloc((n_conns + 1) * sizeof (long));
+    conns = calloc(n_conns + 1, sizeof (replay_conn));
+    events = malloc(EPOLL_MAX_EVENTS * sizeof (struct epoll_event));
+    if (next_rec == NULL || last == NULL || conns == NULL || events == NULL)
+        SystemFatal("malloc(): Failed");
+    for (j = 0; j < n_conns; j++) {
+        last[j] = -1;
+        conns[j].fd = -1;
+        conns[j].next = -1;
+    }
+    for (i = 0; i < n; i++) {
+        next_rec[i] = -1;
+        if (last[recs[i].conn] >= 0)
+            next_rec[last[recs[i].conn]] = i;
+        last[recs[i].conn] = i;
+        if (recs[i].kind == TRACE_CONNECT && ++in_trace > max_open)
+            max_open = in_trace;
+        else if (recs[i].kind == TRACE_CLOSE)
+            in_trace--;
+        else if (recs[i].kind == TRACE_REQUEST)
+            n_requests++;
+    }
+    free(last);
+    fprintf(stdout, "[ Trace: %ld records, %d connections, %lu commands over %.3lf s, "
+            "up to %d open\n", n, n_conns, n_requests, n > 0 ? recs[n - 1].at / 1e6 : 0.0,
+            max_open);
+    n_requests = 0;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    bzero((char *) &server_addr, sizeof (struct sockaddr_in));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(atoi(argv[optind + 2]));
+    if ((hp = gethostbyname(argv[optind + 1])) == NULL) {
+        fprintf(stderr, "Unknown server address\n");
+        exit(1);
+    }
+    bcopy(hp->h_addr, (char *) &server_addr.sin_addr, hp->h_length);
+    if ((epfd = epoll_create1(0)) < 0)
+        SystemFatal("epoll_create1(): Failed");
+
+    hist_init(&latency_us);
+    hist_init(&lag_us);
+    start = now_us();
+    while (cursor < n || n_work > 0) {
+        /* the records fall due in the order of the trace */
+        for (now = now_us(); cursor < n && due_us(cursor) <= now; cursor++) {
+            c = &conns[recs[cursor].conn];
+            if (recs[cursor].kind != TRACE_CONNECT) {
+                if (c->fd < 0)
+                    continue;
+                c->n_due++;
+                n_work++;
+                conn_send(c);
+                continue;
+            }
+            if (n_open >= max_open)
+                break;
+            if ((c->fd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+                SystemFatal("Cannot Create Socket!");
+            if (connect(c->fd, (struct sockaddr *) &server_addr, sizeof (server_addr)) < 0)
+                SystemFatal("Can't connect to server");
+            if (fcntl(c->fd, F_SETFL, O_NONBLOCK | fcntl(c->fd, F_GETFL, 0)) == -1)
+                SystemFatal("fcntl(): Non-Block Failed");
+            if ((c->out = malloc(REPLAY_QUEUE * sizeof (replay_expect))) == NULL)
+                SystemFatal("malloc(): Failed");
+            ev.events = EPOLLIN;
+            ev.data.u32 = recs[cursor].conn;
+            if (epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev) == -1)
+                SystemFatal("epoll_ctl() error");
+            c->next = next_rec[cursor];
+            c->out_head = c->n_out = c->line_len = 0;
+            c->subscribed = c->want_out = false;
+            c->id = 0;
+            n_open++;
+        }
+
+        /* wake for the next record, unless it waits for a connection to close */
+        wait_ms = -1;
+        if (cursor < n && (recs[cursor].kind != TRACE_CONNECT || n_open < max_open)) {
+            due = due_us(cursor);
+            now = now_us();
+            wait_ms = due > now ? (due - now + 999) / 1000 : 0;
+        } else if (cursor == n && n_work == 0) {
+            break;
+        }
+        if ((ready = epoll_wait(epfd, events, EPOLL_MAX_EVENTS, wait_ms)) < 0 && errno != EINTR)
+            SystemFatal("epoll_wait(): Failed");
+        for (j = 0; j < ready; j++) {
+            c = &conns[events[j].data.u32];
+            if (events[j].events & EPOLLOUT)
+                conn_write(c);
+            if (events[j].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                conn_read(c);
+        }
+    }
+    now = now_us() - start;
+
+    for (j = 0; j < n_conns; j++)
+        conn_close(&conns[j], false);
+    fprintf(stdout, "[ Replay: %lu commands, %lu bytes in %.3lf s, %.2lfx the trace's speed, "
+            "%d connections lost\n", n_requests, n_bytes, now / 1e6,
+            n > 0 && now > 0 ? (double) recs[n - 1].at / now : 0.0, n_lost);
+    hist_print(&latency_us, "Request Latency", "us");
+    hist_print(&lag_us, "Schedule Lag", "us");
+
+    for (i = 0; i < n; i++)
+        free(recs[i].text);
+    free(recs);
+    free(next_rec);
+    free(conns);
+    free(events);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * SystemFatal
+ *
+ * Displays a perror message and exits the program.
+ *
+ * @param message takes in a string message
+ */
+void SystemFatal(const char* message) {
+    perror(message);
+    exit(EXIT_FAILURE);
+}
@@ -0,0 +1,139 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		reply_cache.c - Pre-generated replies bucketed by size class
+--
+--	FUNCTIONS:			mmap
+--
+--	DATE:				October 19, 2026
+--
+--	NOTES:
+--	A client asks for N bytes with "request N\n". Replies are served from
+--	page-aligned buffers generated once at start up, one per power of two
+--	size class from 64 B to 8 MB; a reply of N bytes is the first N bytes of
+--	the smallest class that holds it. The buffers are read only and shared
+--	by every connection, so a reply costs no allocation or fill. Replies
+--	larger than the biggest class are queued as several chunks of it.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+#include <sys/mman.h>
+
+/**
+ * reply_cache_new
+ *
+ * Generates the buffer of every size class.
+ *
+ * @param legacy the BUFLEN reply to a plain "request"
+ * @return the reply cache, NULL on failure
+ */
+reply_cache* reply_cache_new(const char *legacy) {
+    int i, size;
+    char *p;
+    const char line[] = "012345678901234567890123456789012345678901234567890123456789012\n";
+    reply_cache *rc = malloc(sizeof (reply_cache));
+    if (rc == NULL)
+        return NULL;
+
+    memset(rc, 0, sizeof (reply_cache));
+    rc->legacy = legacy;
+
+    for (i = 0; i < REPLY_CLASSES; i++) {
+        size = 1 << (REPLY_MIN_SHIFT + i);
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            return NULL;
+
+        /* 64 byte lines, so every class holds whole lines */
+        for (size -= sizeof (line) - 1; size >= 0; size -= sizeof (line) - 1)
+            memcpy(p + size, line, sizeof (line) - 1);
+
+        mprotect(p, 1 << (REPLY_MIN_SHIFT + i), PROT_READ);
+        rc->buf[i] = p;
+    }
+    return rc;
+}
+
+/**
+ * reply_class
+ *
+ * @param len the reply length, 1 to REPLY_CLASS_MAX
+ * @return the index of the smallest size class that holds len bytes
+ */
+int reply_class(int len) {
+    int i = 0;
+    while ((1 << (REPLY_MIN_SHIFT + i)) < len)
+        i++;
+    return i;
+}
+
+/**
+ * reply_cache_get
+ *
+ * Looks up the buffer for a reply and counts it in its size class.
+ *
+ * @param rc the reply cache
+ * @param len the reply length, 1 to REPLY_CLASS_MAX
+ * @return the start of the reply
+ */
+const char* reply_cache_get(reply_cache *rc, int len) {
+    int i = reply_class(len);
+
+    __sync_fetch_and_add(&rc->n_replies[i], 1);
+    __sync_fetch_and_add(&rc->n_bytes[i], len);
+    return rc->buf[i];
+}
+
+/**
+ * reply_cache_print
+ *
+ * Prints the replies served from every size class that was used.
+ *
+ * @param rc the reply cache
+ */
+void reply_cache_print(reply_cache *rc) {
+    int i, size;
+
+    for (i = 0; i < REPLY_CLASSES; i++) {
+        if (rc->n_replies[i] == 0)
+            continue;
+        size = 1 << (REPLY_MIN_SHIFT + i);
+        fprintf(stdout, "[ Replies <= %d%s: %lu (%llu bytes)\n",
+                size >= 1 << 20 ? size >> 20 : size >= 1 << 10 ? size >> 10 : size,
+                size >= 1 << 20 ? "MB" : size >= 1 << 10 ? "KB" : "B",
+                rc->n_replies[i], rc->n_bytes[i]);
+    }
+}
+
+/**
+ * client_queue_request
+ *
+ * Queues the reply to a request for len bytes, or the legacy BUFLEN reply
+ * when len is 0, behind a frame header on a binary connection. Fails
+ * without queuing anything when the client's reply queue has no room for
+ * every chunk of the reply.
+ *
+ * @param c the client
+ * @param rc the reply cache
+ * @param len the requested reply length
+ * @param id the request id of a binary request
+ * @return true if the reply was queued
+ */
+bool client_queue_request(client *c, reply_cache *rc, long len, uint32_t id) {
+    int chunk;
+
+    if (REPLY_QUEUE_LEN - c->n_pending < c->binary +
+            (len == 0 ? 1 : (len + REPLY_CLASS_MAX - 1) / REPLY_CLASS_MAX))
+        return false;
+    if (c->binary)
+        client_queue_frame_hdr(c, OP_REPLY, len == 0 ? BUFLEN : len, id);
+
+    if (len == 0) {
+        client_queue_reply(c, rc->legacy, BUFLEN);
+        return true;
+    }
+
+    for (; len > 0; len -= chunk) {
+        chunk = len > REPLY_CLASS_MAX ? REPLY_CLASS_MAX : len;
+        client_queue_reply(c, reply_cache_get(rc, chunk), chunk);
+    }
+    return true;
+}
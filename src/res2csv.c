@@ -0,0 +1,46 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		res2csv.c - Converts a client result log to CSV
+--
+--	PROGRAM:			res2csv
+--						./res2csv LOG [CSV]
+--
+--	DATE:				October 19, 2026
+--
+--	NOTES:
+--	Reads the memory-mapped result log written by tcp_clnt and t_clnt
+--	(see reslog.c) and prints one CSV row per client, to stdout or to CSV.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+
+/**
+ * main
+ * 
+ * @param argc
+ * @param argv
+ * @return 
+ */
+int main(int argc, char **argv) {
+    reslog *log;
+    FILE *fp = stdout;
+
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "USAGE: %s LOG [CSV]\n", argv[0]);
+        exit(1);
+    }
+
+    if ((log = reslog_open(argv[1])) == NULL) {
+        fprintf(stderr, "%s: not a result log\n", argv[1]);
+        exit(EXIT_FAILURE);
+    }
+    if (argc == 3 && (fp = fopen(argv[2], "w")) == NULL) {
+        perror("fopen(): Unable to open the file");
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(stderr, "%d results\n", reslog_to_csv(log, fp));
+
+    fclose(fp);
+    reslog_close(log);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,192 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		reslog.c - Shared memory-mapped client result log
+--
+--	FUNCTIONS:			mmap, __atomic builtins
+--
+--	DATE:				October 19, 2026
+--
+--	NOTES:
+--	The client processes append their results to one file of fixed size
+--	binary records mapped MAP_SHARED into every process. A writer claims a
+--	slot with an atomic fetch-add on the header and marks the record valid
+--	once it is filled, so logging a result needs no lock and no system call.
+--	Results that do not fit in the capacity are counted as dropped.
+--	reslog_to_csv turns the log into the CSV files the clients used to write.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * reslog_map
+ *
+ * Maps an open log file.
+ *
+ * @param fd the log file
+ * @param size the file size
+ * @return the log, NULL on failure
+ */
+static reslog* reslog_map(int fd, size_t size) {
+    reslog *log;
+    void *p;
+
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return NULL;
+
+    if ((log = malloc(sizeof (reslog))) == NULL) {
+        munmap(p, size);
+        return NULL;
+    }
+    log->hdr = (reslog_hdr *) p;
+    log->rec = (reslog_rec *) (log->hdr + 1);
+    log->size = size;
+    return log;
+}
+
+/**
+ * reslog_create
+ *
+ * Creates a log with room for capacity results. The file is initialised
+ * under a temporary name and linked into place, so a process that opens
+ * the log never sees a partial header. An existing log is opened instead.
+ *
+ * @param path the log file
+ * @param capacity the number of records
+ * @return the log, NULL on failure
+ */
+reslog* reslog_create(const char *path, int capacity) {
+    char tmp[256];
+    size_t size = sizeof (reslog_hdr) + (size_t) capacity * sizeof (reslog_rec);
+    reslog *log;
+    int fd;
+
+    snprintf(tmp, sizeof (tmp), "%s.%d", path, (int) getpid());
+    if ((fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0)
+        return NULL;
+    if (ftruncate(fd, size) < 0 || (log = reslog_map(fd, size)) == NULL) {
+        unlink(tmp);
+        return NULL;
+    }
+
+    log->hdr->magic = RESLOG_MAGIC;
+    log->hdr->record_size = sizeof (reslog_rec);
+    log->hdr->capacity = capacity;
+    log->hdr->next = 0;
+    log->hdr->dropped = 0;
+
+    if (link(tmp, path) < 0) {
+        unlink(tmp);
+        reslog_close(log);
+        return errno == EEXIST ? reslog_open(path) : NULL;
+    }
+    unlink(tmp);
+    return log;
+}
+
+/**
+ * reslog_open
+ *
+ * Opens an existing log.
+ *
+ * @param path the log file
+ * @return the log, NULL if it does not exist or is not a result log
+ */
+reslog* reslog_open(const char *path) {
+    struct stat st;
+    reslog *log;
+    int fd;
+
+    if ((fd = open(path, O_RDWR)) < 0)
+        return NULL;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof (reslog_hdr)) {
+        close(fd);
+        return NULL;
+    }
+    if ((log = reslog_map(fd, st.st_size)) == NULL)
+        return NULL;
+
+    if (log->hdr->magic != RESLOG_MAGIC || log->hdr->record_size != sizeof (reslog_rec) ||
+            log->size < sizeof (reslog_hdr) + (size_t) log->hdr->capacity * sizeof (reslog_rec)) {
+        reslog_close(log);
+        return NULL;
+    }
+    return log;
+}
+
+/**
+ * reslog_close
+ *
+ * Unmaps a log, the records stay in the file.
+ *
+ * @param log the log
+ */
+void reslog_close(reslog *log) {
+    munmap(log->hdr, log->size);
+    free(log);
+}
+
+/**
+ * reslog_claim
+ *
+ * Claims the next free record.
+ *
+ * @param log the log
+ * @return the record to fill, NULL if the log is full
+ */
+reslog_rec* reslog_claim(reslog *log) {
+    uint32_t i = __atomic_fetch_add(&log->hdr->next, 1, __ATOMIC_RELAXED);
+
+    if (i >= log->hdr->capacity) {
+        __atomic_fetch_add(&log->hdr->dropped, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    return &log->rec[i];
+}
+
+/**
+ * reslog_commit
+ *
+ * Publishes a filled record.
+ *
+ * @param r the record
+ */
+void reslog_commit(reslog_rec *r) {
+    __atomic_store_n(&r->valid, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * reslog_to_csv
+ *
+ * Writes every published record as a CSV row.
+ *
+ * @param log the log
+ * @param fp the CSV file
+ * @return the number of rows written
+ */
+int reslog_to_csv(reslog *log, FILE *fp) {
+    uint32_t i, n = log->hdr->next;
+    int rows = 0;
+    reslog_rec *r;
+
+    if (n > log->hdr->capacity)
+        n = log->hdr->capacity;
+
+    fprintf(fp, "ProcessID,Data(Bytes),Time(Seconds),Requests,Replies,Received(Bytes),"
+            "MeanLatency(us),P50Latency(us),P99Latency(us),MaxLatency(us),Busy\n");
+    for (i = 0; i < n; i++) {
+        r = &log->rec[i];
+        if (!__atomic_load_n(&r->valid, __ATOMIC_ACQUIRE))
+            continue;
+        fprintf(fp, "%d,%lld,%lf,%d,%d,%lld,%.1lf,%u,%u,%u,%u\n", r->pid,
+                (long long) r->dataSent, r->time, r->requests, r->replies,
+                (long long) r->dataReceived, r->meanLatency, r->p50Latency,
+                r->p99Latency, r->maxLatency, r->busy);
+        rows++;
+    }
+    if (log->hdr->dropped > 0)
+        fprintf(stderr, "reslog: %u results did not fit in the log\n", log->hdr->dropped);
+    return rows;
+}
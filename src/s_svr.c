@@ -47,7 +47,7 @@ server *serv;
  */
 int main(int argc, char** argv) {
 
-	int ret;
+	int ret, opt, cost_interval = 0;
 	struct sigaction act;
 	server *s;
 
@@ -67,18 +67,75 @@ int main(int argc, char** argv) {
 	s = server_new();
 	serv = s;
 
-	switch (argc) {
-	case 1:
+	while ((opt = getopt(argc, argv, "c:qa:O:u:U:K:T:R:")) != -1) {
+		switch (opt) {
+		case 'c':
+			cost_interval = atoi(optarg); // CPU cost sampling interval
+			break;
+		case 'q':
+			s->quiet = true; // no per-connection logging
+			break;
+		case 'a':
+			if (affinity_parse(optarg, &s->cpus) < 0) {
+				fprintf(stderr, "Bad CPU list: %s\n", optarg);
+				exit(1);
+			}
+			s->cpu = affinity_cpu(&s->cpus, 0); // the first CPU in the list
+			break;
+		case 'O':
+			if ((s->load = overload_new(optarg)) == NULL) { // admission control
+				fprintf(stderr, "Usage: %s [-c interval_ms] [-a cpus] [-O lag_us[,reject|busy]] [-u|-U name] [-K megabytes] [-T interval_ms[,conns]] [-R trace] [-q] [port]\n", argv[0]);
+				exit(1);
+			}
+			break;
+		case 'u':
+			s->unix_path = optarg; // Unix socket next to the TCP port
+			break;
+		case 'U':
+			s->unix_path = optarg; // Unix socket instead of the TCP port
+			s->tcp = false;
+			break;
+		case 'K':
+			if ((s->kv = kv_new(atol(optarg))) == NULL) { // key value cache
+				fprintf(stderr, "Usage: %s [-c interval_ms] [-a cpus] [-O lag_us[,reject|busy]] [-u|-U name] [-K megabytes] [-T interval_ms[,conns]] [-R trace] [-q] [port]\n", argv[0]);
+				exit(1);
+			}
+			break;
+		case 'T':
+			if ((s->tcp_samples = tcp_sampler_new(optarg)) == NULL) { // TCP_INFO sampling
+				fprintf(stderr, "Usage: %s [-c interval_ms] [-a cpus] [-O lag_us[,reject|busy]] [-u|-U name] [-K megabytes] [-T interval_ms[,conns]] [-R trace] [-q] [port]\n", argv[0]);
+				exit(1);
+			}
+			break;
+		case 'R':
+			if ((s->trace = trace_new(optarg)) == NULL) // capture to a trace file
+				SystemFatal("trace_new(): Failed");
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-c interval_ms] [-a cpus] [-O lag_us[,reject|busy]] [-u|-U name] [-K megabytes] [-T interval_ms[,conns]] [-R trace] [-q] [port]\n", argv[0]);
+			exit(1);
+		}
+	}
+
+	switch (argc - optind) {
+	case 0:
 		s->port = SERVER_TCP_PORT; // Use the default port
 		break;
-	case 2:
-		s->port = atoi(argv[1]); // Get user specified port
+	case 1:
+		s->port = atoi(argv[optind]); // Get user specified port
 		break;
 	default:
-		fprintf(stderr, "Usage: %s [port]\n", argv[0]);
+		fprintf(stderr, "Usage: %s [-c interval_ms] [-a cpus] [-O lag_us[,reject|busy]] [-u|-U name] [-K megabytes] [-T interval_ms[,conns]] [-R trace] [-q] [port]\n", argv[0]);
 		exit(1);
 	}
 
+	/* open the cost counters before any thread exists so they are inherited */
+	if (cost_interval > 0) {
+		if ((s->cost = cpu_cost_new(cost_interval, &s->n_requests)) == NULL)
+			SystemFatal("cpu_cost_new() Failed\n");
+		cpu_cost_start(s->cost);
+	}
+
 	ret = pthread_create(&master_manager, NULL, client_manager, s);
 	if (ret != 0)
 		SystemFatal("Unable to create client management thread\n");
@@ -99,7 +156,7 @@ int main(int argc, char** argv) {
  */
 server* server_new(void) {
 	//int i;
-	server *s = malloc(sizeof (server));
+	server *s = aligned_alloc(CACHE_LINE, sizeof (server));
 	if (s == NULL)
 		SystemFatal("Malloc() Failed \n");
 
@@ -107,8 +164,35 @@ server* server_new(void) {
 	s->n_clients = 0;
 	s->n_max_connected = 0;
 	s->n_max_bytes_received = 0;
+	s->n_requests = 0;
+	s->n_write_calls = 0;
+	s->kv = NULL;
+	s->tcp_samples = NULL;
+	s->trace = NULL;
+	s->n_segs_out = 0;
+	s->cost = NULL;
+	s->file_dir = -1;
+	s->quiet = false;
+	CPU_ZERO(&s->cpus);
+	s->cpu = -1;
+	s->node = -1;
+	s->n_workers = 1;
+	s->workers = NULL;
+	s->parent = NULL;
+	s->accept_mode = ACCEPT_SHARE;
+	s->n_procs = 0;
+	s->slot = NULL;
+	s->slots = NULL;
+	s->load = NULL;
+	s->listen_sd = -1;
+	s->unix_sd = -1;
+	s->tcp = true;
+	s->unix_path = NULL;
 
 	s->client_list = llist_new();
+	s->replies = reply_cache_new(client_msg);
+	if (s->replies == NULL)
+		SystemFatal("Reply Cache Failed\n");
 
 	/*for (i = 0; i <= FD_SETSIZE; i++) {
 		s->clients[i] = -1;
@@ -125,7 +209,8 @@ server* server_new(void) {
 /**
  * server_init
  *
- * Creates a socket and puts the socket into a listening mode
+ * Creates a socket and puts the socket into a listening mode, and the Unix
+ * socket next to it or in its place.
  *
  * @param s server structure variable.
  */
@@ -133,6 +218,17 @@ void server_init(server *s) {
 	const int on = 1;
 	struct sockaddr_in servaddr;
 
+	if (s->unix_path != NULL) {
+		if ((s->unix_sd = unix_listen(s->unix_path)) < 0)
+			SystemFatal("unix_listen(): Failed\n");
+		if (fcntl(s->unix_sd, F_SETFL, O_NONBLOCK | fcntl(s->unix_sd, F_GETFL, 0)) == -1)
+			SystemFatal("fcntl(): Server Non-Block Failed\n");
+		fprintf(stderr, "Listening on Unix socket %s\n", s->unix_path);
+		s->maxfd = s->unix_sd;
+	}
+	if (!s->tcp)
+		return;
+
 	/* create TCP socket to listen for client connections */
 	fprintf(stderr, "Creating TCP socket\n");
 	s->listen_sd = socket(AF_INET, SOCK_STREAM, 0);
@@ -158,8 +254,9 @@ void server_init(server *s) {
 	if (listen(s->listen_sd, LISTENQ) < 0)
 		SystemFatal("Unable to listen on socket \n");
 
-	/* right now the listening socket is the max */
-	s->maxfd = s->listen_sd;
+	/* right now the listening sockets are the max */
+	if (s->listen_sd > s->maxfd)
+		s->maxfd = s->listen_sd;
 
 }
 
@@ -171,9 +268,30 @@ void server_init(server *s) {
  * @return c returns the client struct
  */
 client* client_new(void) {
-	client *c = malloc(sizeof (client));
-	c->sa_len = sizeof (c->sa);
+	client *c;
+	size_t size = sizeof (client) + REPLY_QUEUE_LEN * sizeof (reply) +
+		sizeof (client_cold) + RECV_BUFLEN + REPLY_QUEUE_LEN * FRAME_HDR_LEN;
+
+	/* one block: the hot line, the reply ring, the cold state, the buffer
+	 * and the frame headers */
+	if (posix_memalign((void **) &c, CACHE_LINE, size) != 0)
+		SystemFatal("Client Malloc() Failed\n");
+	c->replies = (reply *) (c + 1);
+	c->cold = (client_cold *) (c->replies + REPLY_QUEUE_LEN);
+	c->rbuf = (char *) (c->cold + 1);
+	c->cold->frames = c->rbuf + RECV_BUFLEN;
+	c->cold->sub = -1;
+	c->cold->n_owed = 0;
+
+	c->cold->sa_len = sizeof (c->cold->sa);
 	c->quit = false;
+	c->rlen = 0;
+	c->reply_head = 0;
+	c->n_pending = 0;
+	c->reply_off = 0;
+	c->file_fd = -1;
+	c->file_pipe = false;
+	c->binary = false;
 	return c;
 }
 
@@ -218,28 +336,98 @@ void process_client_data(client *c, server *s) {
  * @param s server information
  */
 void process_client_req(client *c, server *s) {
-	ssize_t r, w;
-	char *recv;
-	//int bytes_to_read = BUFLEN;
-	char error[100];
+	int off, used, depth, queued;
+	bool blocked, binary;
+	proto_req r;
 
-	recv = malloc(BUFLEN * sizeof (char));
+	/* send what the client is still owed before taking more requests */
+	if (!client_flush(c, s))
+		return;
 
-	while ((r = read(c->fd, recv, BUFLEN)) > 0) {
-		s->n_max_bytes_received += r;
-	}
+	s->n_max_bytes_received += client_fill(c);
+
+	do {
+		/* handle complete requests while the reply queue has room, the
+		 * rest stays buffered until the replies are written */
+		off = 0;
+		blocked = false;
+		while ((used = proto_next_req(c->binary, c->rbuf + off, c->rlen - off, &r)) > 0) {
+			if (r.type == CMD_NONE) {
+				off += used;
+				break;
+			}
+
+			/* the requests still owed replies came before this one */
+			depth = c->cold->n_owed;
+			queued = c->n_pending;
+			binary = c->binary;
+			switch (r.type) {
+			case CMD_REQUEST:
+				/* a shed request costs a five byte reply */
+				if (s->load != NULL && c->n_pending < REPLY_QUEUE_LEN &&
+					overload_busy(s->load))
+					client_queue_status(c, OP_BUSY, r.id);
+				else if (client_queue_request(c, s->replies, r.arg, r.id))
+					s->n_requests++;
+				else
+					blocked = true;
+				break;
+			case CMD_GET:
+			case CMD_SET:
+			case CMD_DEL:
+				/* without the cache the command is answered as a bad
+				 * one, a pipelining client waits for every reply */
+				if (s->kv == NULL) {
+					if (!client_queue_status(c, OP_ERROR, r.id))
+						blocked = true;
+					break;
+				}
+				if (!client_queue_kv(c, s->kv, &r)) {
+					blocked = true;
+					break;
+				}
+				s->n_requests++;
+				break;
+			case CMD_QUIT:
+				c->quit = true;
+				break;
+			case CMD_BINARY:
+				if (!client_negotiate(c, r.arg))
+					blocked = true;
+				break;
+			case CMD_INVALID:
+				fprintf(stderr, "[%5d]Bad frame\n", c->fd);
+				c->quit = true;
+				return;
+			default:
+				/* every frame is answered, unknown text is ignored */
+				if (c->binary && !client_queue_status(c, OP_ERROR, r.id))
+					blocked = true;
+				break;
+			}
+			if (blocked)
+				break;
+			if (s->trace != NULL) {
+				trace_request(s->trace, c->cold->trace_id, &r, binary,
+					proto_wire_len(binary, c->rbuf + off + used, c->rlen - off - used, used),
+					depth);
+				client_owe(c, queued);
+			}
+			if (c->quit)
+				return;
+			off += used;
+		}
+		client_consume(c, off);
 
-	if (strcmp(recv, "request\n") == 0) {
-		if ((w = write(c->fd, client_msg, BUFLEN)) != BUFLEN) {
-			strcpy(error, "write(): Client Write Error - ");
-			sscanf(error, "%d != %d\n", (int *)strlen(recv), (int *)w);
-			SystemFatal(error);
+		/* a command that does not fit in the buffer can never complete */
+		if (c->rlen == RECV_BUFLEN && !blocked) {
+			fprintf(stderr, "[%5d]Request too long\n", c->fd);
+			c->quit = true;
+			return;
 		}
-	}
-	else if (strcmp(recv, "quit\n") == 0) {
-		c->quit = true;
-		return;
-	}
+
+		/* select reports the socket writable again if replies are left */
+	} while (client_flush(c, s) && blocked);
 }
 
 /**
@@ -250,11 +438,22 @@ void process_client_req(client *c, server *s) {
  * @param data Thread data for the function
  */
 void* client_manager(void *data) {
-	int nready;
+	int nready, wait_ms;
+	struct timeval timeout;
 	client *c = NULL;
 	node *n = NULL;
 	server *s = (server *)data;
 
+	/* pin the select loop, its client buffers are then allocated locally */
+	if (s->cpu >= 0) {
+		if (affinity_pin(s->cpu) < 0) {
+			fprintf(stderr, "CPU %d: pinning failed, running unpinned\n", s->cpu);
+			s->cpu = -1;
+		} else {
+			s->node = affinity_node(s->cpu);
+		}
+	}
+
 	/* set up as a tcp server */
 	server_init(s);
 
@@ -262,22 +461,41 @@ void* client_manager(void *data) {
 		pthread_mutex_lock(&s->dataLock);
 
 		FD_ZERO(&s->allset);
-		FD_SET(s->listen_sd, &s->allset);
+		FD_ZERO(&s->writeset);
+		if (s->listen_sd >= 0)
+			FD_SET(s->listen_sd, &s->allset);
+		if (s->unix_sd >= 0)
+			FD_SET(s->unix_sd, &s->allset);
 
 		/* loop through all possible socket connections and add
-		 * them to fd_set */
+		 * them to fd_set. Every request handled ends in a flush, so a
+		 * client still owed replies filled its socket buffer; it waits
+		 * for writability only, as its requests stay unread until the
+		 * replies drain and a readable socket would wake select at once */
 		for (n = s->client_list->link; n != NULL; n = n->next) {
 			c = (client *)n->data;
-			FD_SET(c->fd, &s->allset);
+			if (c->n_pending > 0)
+				FD_SET(c->fd, &s->writeset);
+			else
+				FD_SET(c->fd, &s->allset);
 			if (c->fd > s->maxfd)
 				s->maxfd = c->fd;
 		}
 
 		/* Monitor sockets for any activity of new connections or data transfer */
-		nready = select(s->maxfd + 1, &s->allset, NULL, NULL, NULL);
+		/* with -T select returns in time for the next TCP_INFO round */
+		if ((wait_ms = tcp_sample_wait(s->tcp_samples)) >= 0) {
+			timeout.tv_sec = wait_ms / 1000;
+			timeout.tv_usec = wait_ms % 1000 * 1000;
+		}
+		nready = select(s->maxfd + 1, &s->allset, &s->writeset, NULL,
+			wait_ms >= 0 ? &timeout : NULL);
 
 		pthread_mutex_unlock(&s->dataLock);
 
+		if (s->tcp_samples != NULL)
+			tcp_sample_round(s->tcp_samples, s->client_list);
+
 		if (nready < 0) {
 			/* Something interrupted the call, cause EINTR, continue */
 			if (errno == EINTR)
@@ -291,6 +509,8 @@ void* client_manager(void *data) {
 		}
 		else {
 			/* There is an activity on one or more sockets. */
+			if (s->load != NULL)
+				s->wake_ns = overload_now();
 			read_from_socket(s);
 		}
 	}
@@ -312,34 +532,58 @@ void* client_manager(void *data) {
  */
 void read_from_socket(server *s) {
 	//int ret, maxi;
+	int sd = -1;
 	client *c = NULL;
-	node *n = NULL;
+	node *n = NULL, *next = NULL;
 
 	//maxi = 0;
 
 	/* Check if a client is trying to connect */
 	pthread_mutex_trylock(&s->dataLock);
-	if (FD_ISSET(s->listen_sd, &s->allset)) {
+	if (s->listen_sd >= 0 && FD_ISSET(s->listen_sd, &s->allset))
+		sd = s->listen_sd;
+	else if (s->unix_sd >= 0 && FD_ISSET(s->unix_sd, &s->allset))
+		sd = s->unix_sd;
+	if (sd >= 0) {
 
 		/* get the client data ready */
 		c = client_new();
 
 		/* blocking call waiting for connections */
-		c->fd = accept(s->listen_sd, (struct sockaddr *) &c->sa, &c->sa_len);
+		c->fd = accept(sd, (struct sockaddr *) &c->cold->sa, &c->cold->sa_len);
+
+		/* reset the connection at once while the loop lags */
+		if (s->load != NULL) {
+			if (sd == s->listen_sd)
+				overload_queue(s->load, s->listen_sd);
+			overload_lag(s->load, overload_now() - s->wake_ns);
+			if (!overload_admit(s->load, c->fd)) {
+				free(c);
+				c = NULL;
+			}
+		}
+	}
+	if (c != NULL) {
 		/* make the client Socket non-blocking */
 		if (fcntl(c->fd, F_SETFL, O_NONBLOCK | fcntl(c->fd, F_GETFL, 0)) == -1)
 			SystemFatal("fcntl(): Client Non-Block Failed\n");
 
-		fprintf(stdout, "Received connection from (%s, %d)\n",
-			inet_ntoa(c->sa.sin_addr),
-			ntohs(c->sa.sin_port));
+		if (!s->quiet && sd == s->unix_sd)
+			fprintf(stdout, "Received connection on %s\n", s->unix_path);
+		else if (!s->quiet)
+			fprintf(stdout, "Received connection from (%s, %d)\n",
+				inet_ntoa(c->cold->sa.sin_addr),
+				ntohs(c->cold->sa.sin_port));
 		s->n_clients++;
 		s->n_max_connected++;
 		/*s->n_max_connected = (s->n_clients > s->n_max_connected) ?
 				s->n_clients : s->n_max_connected;*/
 		s->client_list = llist_append(s->client_list, (void *)c);
-		fprintf(stdout, "Added client to list, new size: %d\n",
-			llist_length(s->client_list));
+		if (s->trace != NULL)
+			c->cold->trace_id = trace_connect(s->trace);
+		if (!s->quiet)
+			fprintf(stdout, "Added client to list, new size: %d\n",
+				llist_length(s->client_list));
 		/* add the client to the list */
 		/*for (i = 0; i < FD_SETSIZE; i++) {
 			if (s->clientConn[i] == NULL) {
@@ -363,12 +607,17 @@ void read_from_socket(server *s) {
 	}
 	pthread_mutex_unlock(&s->dataLock);
 
-	for (n = s->client_list->link; n != NULL; n = n->next) {
+	for (n = s->client_list->link; n != NULL; n = next) {
+		/* the node is freed when the client is removed */
+		next = n->next;
 
 		/* check if the client cause an event */
 		pthread_mutex_trylock(&s->dataLock);
 		c = (client *)n->data;
-		if (FD_ISSET(c->fd, &s->allset)) {
+		if (FD_ISSET(c->fd, &s->allset) || FD_ISSET(c->fd, &s->writeset)) {
+			/* the socket waited for every one handled before it */
+			if (s->load != NULL)
+				overload_lag(s->load, overload_now() - s->wake_ns);
 			process_client_req(c, s);
 			//process_client_data(c, s);
 		}
@@ -378,9 +627,16 @@ void read_from_socket(server *s) {
 		if (c->quit) {
 			pthread_mutex_trylock(&s->dataLock);
 			s->n_clients--;
+			if (s->tcp_samples != NULL)
+				tcp_sample_forget(s->tcp_samples, c);
 			s->client_list = llist_remove(s->client_list, (void *)c, client_compare);
-			fprintf(stderr, "[%5d]Removed client from list, new size: %d\n",
-				c->fd, llist_length(s->client_list));
+			if (!s->quiet)
+				fprintf(stderr, "[%5d]Removed client from list, new size: %d\n",
+					c->fd, llist_length(s->client_list));
+			s->n_segs_out += client_segs_out(c->fd);
+			if (s->trace != NULL)
+				trace_event(s->trace, c->cold->trace_id, TRACE_CLOSE, 0);
+			client_drop_replies(c);
 			close(c->fd);
 			free(c);
 			c = NULL;
@@ -405,6 +661,20 @@ void print_server_data(server *s) {
 	fprintf(stdout, "[ Total Clients Connected: %d\n", s->n_max_connected);
 	fprintf(stdout, "[ Total Bytes Received: %d\n", s->n_max_bytes_received);
 	fprintf(stdout, "[ Total Active Clients: %d\n", s->n_clients);
+	if (s->cpu >= 0)
+		fprintf(stdout, "[ Server CPU: %d (node %d)\n", s->cpu, s->node);
+	client_flush_print(s);
+	if (s->kv != NULL)
+		kv_print(s->kv);
+	if (s->tcp_samples != NULL)
+		tcp_sample_print(s->tcp_samples);
+	if (s->trace != NULL)
+		trace_print(s->trace);
+	if (s->load != NULL)
+		overload_print(s->load);
+	reply_cache_print(s->replies);
+	if (s->cost != NULL)
+		cpu_cost_print(s->cost);
 	fprintf(stdout, "[===========================================]\n\n");
 }
 
@@ -421,6 +691,7 @@ void signal_Handler(int signo) {
 		fprintf(stderr, "\nReceived SIGINT signal\n");
 		running = false;
 		close(serv->listen_sd);
+		unix_unlink(serv->unix_path);
 		print_server_data(serv);
 		exit(EXIT_FAILURE);
 		break;
@@ -19,6 +19,18 @@
 --                      * Monitors number of connections made
 --                      * Gets total bytes of data sent
 --						* Forks and executes child processes to connect to server
+--						October 2026
+--						* Pipelined mode: -d requests in flight, -b requests per
+--						  write, -r requests per second and -s request size
+--						* Per request round trip latency in the CSV
+--						* -n asks the server for replies of that many bytes
+--						* -g gets a file from the server's file directory
+--						* Results go to the shared log FILE.dat, see res2csv
+--						* "busy" replies of a server shedding load are counted
+--						  apart and left out of the latencies
+--						* -x negotiates the binary framing and sends frames
+--						  with request ids instead of text requests
+--						* HOST may name a Unix socket, see unix_sock.c
 --
 --
 --	PROGRAMMERS:		Jivanjot Brar & Shan Bains
@@ -32,17 +44,19 @@
 ---------------------------------------------------------------------------------------*/
 
 #include "common.h"
-#include <semaphore.h>
+#include <poll.h>
+#include <limits.h>
+
+#define USAGE "Usage: %s [-d depth] [-b batch] [-r rate] [-s size] [-n reply | -g file] [-x] HOST PORT SECONDS FILE\n"
 
 const char client_msg[BUFLEN] =
         "012345678901234567890123456789012345678901234567890123456789012\n";
 const char request[BUFLEN] = "request\n";
 const char quit[BUFLEN] = "quit\n";
 
-sem_t mutex;
 bool running = true;
 data *d;
-FILE *fp;
+reslog *results;
 
 /**
  * main
@@ -52,10 +66,10 @@ FILE *fp;
  * @return 
  */
 int main(int argc, char **argv) {
-    int n, bytes_to_read, port;
+    int port, opt;
     struct hostent *hp;
     struct sockaddr_in server;
-    char *bp, rbuf[BUFLEN], **pptr, *host, *data_file, str[16];
+    char **pptr, *host, *data_file, str[16];
     double t1, t2;
     struct sigaction act;
 
@@ -64,10 +78,60 @@ int main(int argc, char **argv) {
     d->numOfRequests = 0;
     d->dataSent = 0;
     d->time = 0;
+    d->depth = 1;
+    d->batch = 0;
+    d->rate = 4; // one request every 250 ms
+    d->payload = BUFLEN;
+    d->replySize = 0;
+    d->file = NULL;
+    d->numOfReplies = 0;
+    d->numOfBusy = 0;
+    d->binary = false;
+    d->dataReceived = 0;
+    d->latencyCap = 1024;
+    d->latency = malloc(d->latencyCap * sizeof (unsigned int));
 
-    host = argv[1];
-    port = atoi(argv[2]);
-    d->interval = atoi(argv[3]);
+    while ((opt = getopt(argc, argv, "d:b:r:s:n:g:x")) != -1) {
+        switch (opt) {
+            case 'd':
+                d->depth = atoi(optarg); // requests in flight
+                break;
+            case 'b':
+                d->batch = atoi(optarg); // requests per write
+                break;
+            case 'r':
+                d->rate = atoi(optarg); // requests per second, 0 unlimited
+                break;
+            case 's':
+                d->payload = atoi(optarg); // bytes per request
+                break;
+            case 'n':
+                d->replySize = atoi(optarg); // bytes per reply
+                break;
+            case 'g':
+                d->file = optarg; // file to get from the server
+                break;
+            case 'x':
+                d->binary = true; // binary framing
+                break;
+            default:
+                fprintf(stderr, USAGE, argv[0]);
+                exit(1);
+        }
+    }
+    if (argc - optind != 4 || d->depth < 1 || d->rate < 0 || d->replySize < 0 ||
+            d->payload < (int) strlen(request) + (d->replySize > 0 ? 11 : 0) ||
+            (d->file != NULL && d->payload < (int) strlen(d->file) + 5) ||
+            (d->binary && (d->file != NULL || d->payload < FRAME_HDR_LEN + 4))) {
+        fprintf(stderr, USAGE, argv[0]);
+        exit(1);
+    }
+    if (d->batch < 1 || d->batch > d->depth)
+        d->batch = d->depth;
+
+    host = argv[optind];
+    port = atoi(argv[optind + 1]);
+    d->interval = atoi(argv[optind + 2]);
 
     // set up the signal handler to close the server socket when CTRL-c is received
     act.sa_handler = signal_handler;
@@ -81,78 +145,70 @@ int main(int argc, char **argv) {
         exit(EXIT_FAILURE);
     }
 
-    if (sem_init(&mutex, 1, 1) < 0) {
-        perror("sem_init(): semaphore initialization failed");
-        exit(EXIT_FAILURE);
+    // results go to the log shared with the other clients, see res2csv
+    data_file = malloc(strlen(argv[optind + 3]) + 8);
+    sprintf(data_file, "./%s.dat", argv[optind + 3]);
+    if ((results = reslog_open(data_file)) == NULL &&
+            (results = reslog_create(data_file, RESLOG_CAPACITY)) == NULL) {
+        SystemFatal("reslog_create(): Unable to open the result log");
     }
+    free(data_file);
 
-    data_file = malloc(sizeof (char *));
-    sprintf(data_file, "./%s.csv", argv[4]);
-    if ((fp = fopen(data_file, "a+")) == NULL) {
-        SystemFatal("fopen(): Unable to open the file");
-    }
+    // a Unix socket name in place of the host skips the TCP/IP stack
+    if (unix_name(host)) {
+        if ((d->sd = unix_connect(host)) == -1) {
+            fprintf(stderr, "Can't connect to server\n");
+            perror("connect");
+            exit(1);
+        }
+        printf("Connected:    Unix Socket: %s\n", host);
+    } else {
+        // Create the socket
+        if ((d->sd = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
+            perror("Cannot create socket");
+            exit(1);
+        }
+        bzero((char *) &server, sizeof (struct sockaddr_in));
+        server.sin_family = AF_INET;
+        server.sin_port = htons(port);
+        if ((hp = gethostbyname(host)) == NULL) {
+            fprintf(stderr, "Unknown server address\n");
+            exit(1);
+        }
+        bcopy(hp->h_addr, (char *) &server.sin_addr, hp->h_length);
 
-    // Create the socket
-    if ((d->sd = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
-        perror("Cannot create socket");
-        exit(1);
-    }
-    bzero((char *) &server, sizeof (struct sockaddr_in));
-    server.sin_family = AF_INET;
-    server.sin_port = htons(port);
-    if ((hp = gethostbyname(host)) == NULL) {
-        fprintf(stderr, "Unknown server address\n");
-        exit(1);
+        // Connecting to the server
+        if (connect(d->sd, (struct sockaddr *) &server, sizeof (server)) == -1) {
+            fprintf(stderr, "Can't connect to server\n");
+            perror("connect");
+            exit(1);
+        }
+        printf("Connected:    Server Name: %s\n", hp->h_name);
+        pptr = hp->h_addr_list;
+        printf("\t\tIP Address: %s\n", inet_ntop(hp->h_addrtype, *pptr, str, sizeof (str)));
     }
-    bcopy(hp->h_addr, (char *) &server.sin_addr, hp->h_length);
-
-    // Connecting to the server
-    if (connect(d->sd, (struct sockaddr *) &server, sizeof (server)) == -1) {
-        fprintf(stderr, "Can't connect to server\n");
-        perror("connect");
+    if (d->binary && !negotiate_binary(d))
         exit(1);
-    }
-    // connect to server and increment counter
-    printf("Connected:    Server Name: %s\n", hp->h_name);
-    d->numOfRequests++;
-    pptr = hp->h_addr_list;
-    printf("\t\tIP Address: %s\n", inet_ntop(hp->h_addrtype, *pptr, str, sizeof (str)));
     printf("> Transmit: ");
     //fprintf(stdout, "%s\n", client_msg);
-    fprintf(stdout, "%s\n", request);
+    fprintf(stdout, "%s\n", d->binary ? "binary frames" : request);
     // send data to server through socket
     gettimeofday(&d->start, NULL);
 
     /* setting an alarm to shut down the server */
     alarm(d->interval);
 
-    //send(sd, d->sendBuff, BUFLEN, 0);
-    //write(sd, d->sendBuff, BUFLEN);
-
-    while (running) {
-        /* send a request */
-        write(d->sd, request, BUFLEN);
+    send_requests(d);
 
-        d->dataSent += BUFLEN;
-
-        // Receive data back from server
-        printf("> Receive: ");
-        bp = rbuf;
-        bytes_to_read = BUFLEN;
-
-        // client makes repeated calls to recv until no more data is expected to arrive.
-        n = 0;
-        while ((n = recv(d->sd, bp, bytes_to_read, 0)) < BUFLEN) {
-            bp += n;
-            bytes_to_read -= n;
-        }
-        printf("%s\n", rbuf);
-        usleep(250000);
-    }
     printf("> Transmit: ");
     fprintf(stdout, "%s\n", quit);
     /* send quit signal */
-    write(d->sd, quit, BUFLEN);
+    if (d->binary) {
+        proto_frame_hdr(str, OP_QUIT, 0, 0);
+        write(d->sd, str, FRAME_HDR_LEN);
+    } else {
+        write(d->sd, quit, BUFLEN);
+    }
 
     // get end time
     gettimeofday(&d->end, NULL);
@@ -168,11 +224,246 @@ int main(int argc, char **argv) {
 
     fflush(stdout);
     close(d->sd);
+    free(d->latency);
     free(d);
 
     return EXIT_SUCCESS;
 }
 
+/**
+ * now_ns
+ * 
+ * @return the monotonic clock in nanoseconds
+ */
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * negotiate_binary
+ *
+ * Asks the server for the binary framing. The answer is read a byte at a
+ * time so nothing after it is taken from the socket.
+ *
+ * @param d the client data
+ * @return true if the server speaks the framing
+ */
+bool negotiate_binary(data *d) {
+    char ack[32];
+    int n = 0;
+
+    if (write(d->sd, "binary 1\n", 9) != 9)
+        return false;
+    while (n < (int) sizeof (ack) - 1 && read(d->sd, ack + n, 1) == 1) {
+        if (ack[n++] == '\n')
+            break;
+    }
+    ack[n] = '\0';
+    if (strcmp(ack, "binary 1\n") != 0) {
+        fprintf(stderr, "Server refused the binary framing\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * send_requests
+ * 
+ * Sends requests until the alarm goes off, keeping up to d->depth requests
+ * in flight and coalescing up to d->batch of them into one write. Replies
+ * are reassembled from the stream, every d->replySize (or BUFLEN) bytes,
+ * or a file reply's header and data, complete the oldest request in flight.
+ * In the binary framing every request is a frame with its id and every
+ * reply a header and the length of data it gives. Outstanding replies are
+ * drained before returning.
+ * 
+ * @param d the client data and mode settings
+ */
+void send_requests(data *d) {
+    int i, k, n, len, hlen = 0, head = 0, in_flight = 0;
+    uint32_t v;
+    bool busy = false;
+    long reply = d->replySize > 0 ? d->replySize : BUFLEN;
+    long expect = d->file != NULL || d->binary ? -1 : reply, total = expect;
+    char cmd[300], hdr[32], *p, *nl;
+    uint64_t now, wait, next_send, gap, drain_end = 0, *sent;
+    char *sbuf, *rbuf;
+    struct pollfd pfd;
+    struct timespec ts, *timeout;
+
+    /* one write holds up to batch NUL padded requests */
+    if (d->file != NULL)
+        len = sprintf(cmd, "get %.255s\n", d->file);
+    else if (d->replySize > 0)
+        len = sprintf(cmd, "request %d\n", d->replySize);
+    else
+        len = sprintf(cmd, "%s", request);
+    if (d->binary) {
+        /* a frame carries the reply size and pads the rest of the payload */
+        proto_frame_hdr(cmd, OP_REQUEST, d->payload - FRAME_HDR_LEN, 0);
+        v = htonl(reply);
+        memcpy(cmd + FRAME_HDR_LEN, &v, 4);
+        len = FRAME_HDR_LEN + 4;
+    }
+    sbuf = calloc(d->batch, d->payload);
+    for (i = 0; i < d->batch; i++)
+        memcpy(sbuf + i * d->payload, cmd, len);
+    rbuf = malloc(RECV_BUFLEN);
+    sent = malloc(d->depth * sizeof (uint64_t));
+
+    gap = d->rate > 0 ? 1000000000ULL / d->rate : 0;
+    next_send = now_ns();
+    pfd.fd = d->sd;
+    pfd.events = POLLIN;
+
+    while (running || in_flight > 0) {
+        now = now_ns();
+
+        /* give up on replies that do not arrive within a second of the alarm */
+        if (!running) {
+            if (drain_end == 0)
+                drain_end = now + 1000000000ULL;
+            else if (now > drain_end)
+                break;
+        }
+
+        /* send what the pipeline and the rate allow in one write */
+        k = 0;
+        while (running && in_flight + k < d->depth && k < d->batch &&
+                (gap == 0 || next_send <= now)) {
+            sent[(head + in_flight + k) % d->depth] = now;
+            next_send += gap;
+            k++;
+        }
+        if (k > 0) {
+            for (i = 0; d->binary && i < k; i++) {
+                v = htonl(d->numOfRequests + i);
+                memcpy(sbuf + i * d->payload + 8, &v, 4);
+            }
+            if (send(d->sd, sbuf, k * d->payload, 0) != k * d->payload) {
+                perror("send");
+                break;
+            }
+            in_flight += k;
+            d->numOfRequests += k;
+            d->dataSent += k * d->payload;
+        }
+
+        /* a stalled pipeline does not earn a burst of missed send slots */
+        if (gap > 0 && next_send + gap < now)
+            next_send = now;
+
+        /* block while the pipeline is full, otherwise until the next send slot */
+        timeout = NULL;
+        if (!running || in_flight < d->depth) {
+            now = now_ns();
+            wait = 0;
+            if (!running)
+                wait = 100000000ULL;
+            else if (next_send > now)
+                wait = next_send - now;
+            ts.tv_sec = wait / 1000000000ULL;
+            ts.tv_nsec = wait % 1000000000ULL;
+            timeout = &ts;
+        }
+
+        if (ppoll(&pfd, 1, timeout, NULL) <= 0 || !(pfd.revents & (POLLIN | POLLHUP | POLLERR)))
+            continue;
+
+        if ((n = recv(d->sd, rbuf, RECV_BUFLEN, 0)) <= 0) {
+            if (n < 0 && errno == EINTR)
+                continue;
+            fprintf(stderr, "Server closed the connection\n");
+            break;
+        }
+        d->dataReceived += n;
+
+        /* every complete reply answers the oldest request in flight */
+        now = now_ns();
+        for (p = rbuf; n > 0 && in_flight > 0;) {
+            if (expect < 0 && d->binary) {
+                /* a reply frame header gives the length of its data */
+                k = FRAME_HDR_LEN - hlen < n ? FRAME_HDR_LEN - hlen : n;
+                memcpy(hdr + hlen, p, k);
+                hlen += k;
+                p += k;
+                n -= k;
+                if (hlen < FRAME_HDR_LEN)
+                    break;
+                hlen = 0;
+                /* an error frame is left out of the latencies as well */
+                busy = (unsigned char) hdr[1] != OP_REPLY;
+                memcpy(&v, hdr + 4, 4);
+                expect = total = ntohl(v);
+                if (expect > 0)
+                    continue;
+            } else if (expect < 0) {
+                /* a file reply starts with its size, "stream" or "error" */
+                nl = memchr(p, '\n', n);
+                k = nl != NULL ? nl - p + 1 : n;
+                for (i = 0; i < k && hlen < (int) sizeof (hdr) - 1; i++)
+                    hdr[hlen++] = p[i];
+                p += k;
+                n -= k;
+                if (nl == NULL)
+                    break;
+                hdr[hlen] = '\0';
+                hlen = 0;
+                busy = strncmp(hdr, "busy", 4) == 0;
+                expect = strncmp(hdr, "stream", 6) == 0 ? LONG_MAX : atol(hdr);
+                total = expect;
+                if (expect > 0)
+                    continue;
+            } else {
+                /* a shed request is answered "busy\n", replies start with a digit */
+                if (!d->binary && expect == total && !busy && *p == 'b') {
+                    busy = true;
+                    expect = total = OVERLOAD_BUSY_LEN;
+                }
+                k = n < expect ? n : expect;
+                p += k;
+                n -= k;
+                expect -= k;
+                if (expect > 0)
+                    break;
+            }
+
+            if (busy) {
+                d->numOfBusy++;
+                busy = false;
+            } else {
+                if (d->numOfReplies == d->latencyCap) {
+                    d->latencyCap *= 2;
+                    d->latency = realloc(d->latency, d->latencyCap * sizeof (unsigned int));
+                }
+                d->latency[d->numOfReplies++] = (now - sent[head]) / 1000;
+                if (d->depth == 1)
+                    printf("> Receive: %ld bytes in %u us\n", total,
+                        d->latency[d->numOfReplies - 1]);
+            }
+            head = (head + 1) % d->depth;
+            in_flight--;
+            expect = total = d->file != NULL || d->binary ? -1 : reply;
+        }
+    }
+
+    free(sbuf);
+    free(rbuf);
+    free(sent);
+}
+
+/**
+ * latency_compare
+ * 
+ * qsort comparison of two latencies.
+ */
+static int latency_compare(const void *a, const void *b) {
+    unsigned int x = *(const unsigned int *) a, y = *(const unsigned int *) b;
+    return (x > y) - (x < y);
+}
+
 /**
  * print_client_data
  * 
@@ -181,11 +472,35 @@ int main(int argc, char **argv) {
  * @param d
  */
 void print_client_data(data *d) {
-    pid_t pid;
-    sem_wait(&mutex);
-    pid = getpid();
-    fprintf(fp, "%d,%d,%lf\n", (int) pid, d->dataSent, d->time);
-    sem_post(&mutex);
+    reslog_rec *r;
+    int i;
+    double mean = 0;
+    unsigned int p50 = 0, p99 = 0, max = 0;
+
+    if (d->numOfReplies > 0) {
+        qsort(d->latency, d->numOfReplies, sizeof (unsigned int), latency_compare);
+        for (i = 0; i < d->numOfReplies; i++)
+            mean += d->latency[i];
+        mean /= d->numOfReplies;
+        p50 = d->latency[d->numOfReplies / 2];
+        p99 = d->latency[(int) (d->numOfReplies * 0.99)];
+        max = d->latency[d->numOfReplies - 1];
+    }
+
+    if ((r = reslog_claim(results)) == NULL)
+        return;
+    r->pid = getpid();
+    r->requests = d->numOfRequests;
+    r->replies = d->numOfReplies;
+    r->dataSent = d->dataSent;
+    r->dataReceived = d->dataReceived;
+    r->time = d->time;
+    r->meanLatency = mean;
+    r->p50Latency = p50;
+    r->p99Latency = p99;
+    r->maxLatency = max;
+    r->busy = d->numOfBusy;
+    reslog_commit(r);
     /*fprintf(fp, "Client Process ID: %d\n", (int) pid);
     fprintf(fp, "Number of Requests: %d\n", d->numOfRequests);
     fprintf(fp, "Data Sent: %d \n", d->dataSent);
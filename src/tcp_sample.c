@@ -0,0 +1,206 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		tcp_sample.c - TCP_INFO sampling of live connections
+--
+--	FUNCTIONS:			getsockopt(TCP_INFO)
+--
+--	DATE:				October 19, 2026
+--
+--	NOTES:
+--	With -T the servers read TCP_INFO of their connections while they
+--	run, so a run whose latency degrades shows whether the connections
+--	were waiting on the network: round trip times, retransmissions,
+--	segments in flight, data the socket holds that was not sent yet and
+--	the congestion window. Each value goes into a histogram.
+--
+--	A loop samples a few connections per interval, taking up where the
+--	last round stopped in its client list, so every connection comes up
+--	in turn and a round costs the same however many clients there are.
+--	The loop wakes for a round when it has nothing else to do.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+#include <linux/tcp.h>
+
+/**
+ * tcp_sampler_new
+ *
+ * @param spec the interval in milliseconds and the connections sampled
+ * per interval, "100,16"; the connections default to TCP_SAMPLE_PER_ROUND
+ * @return the sampler, NULL if the spec is malformed
+ */
+tcp_sampler* tcp_sampler_new(const char *spec) {
+    tcp_sampler *ts;
+    char *end;
+    long ms, per_round = TCP_SAMPLE_PER_ROUND;
+
+    ms = strtol(spec, &end, 10);
+    if (end == spec || ms <= 0)
+        return NULL;
+    if (*end == ',') {
+        per_round = strtol(end + 1, &end, 10);
+        if (per_round <= 0 || *end != '\0')
+            return NULL;
+    } else if (*end != '\0') {
+        return NULL;
+    }
+    if ((ts = calloc(1, sizeof (tcp_sampler))) == NULL)
+        return NULL;
+    ts->interval_ns = (uint64_t) ms * 1000000;
+    ts->per_round = per_round;
+    hist_init(&ts->rtt);
+    hist_init(&ts->retrans);
+    hist_init(&ts->unacked);
+    hist_init(&ts->notsent);
+    hist_init(&ts->cwnd);
+    return ts;
+}
+
+/**
+ * tcp_sampler_clone
+ *
+ * @param ts a sampler
+ * @return a sampler with the same interval for another loop
+ */
+tcp_sampler* tcp_sampler_clone(const tcp_sampler *ts) {
+    tcp_sampler *c = calloc(1, sizeof (tcp_sampler));
+
+    if (c == NULL)
+        SystemFatal("tcp_sampler_clone(): Failed");
+    c->interval_ns = ts->interval_ns;
+    c->per_round = ts->per_round;
+    return c;
+}
+
+/**
+ * tcp_sample_fd
+ *
+ * Reads TCP_INFO of one connection into the histograms.
+ *
+ * @param ts the sampler
+ * @param fd the connection
+ * @param lock taken around the histograms when threads share the
+ * sampler, NULL for none
+ * @return true if the connection was sampled, false for a Unix socket or
+ * a closed one
+ */
+bool tcp_sample_fd(tcp_sampler *ts, int fd, pthread_mutex_t *lock) {
+    struct tcp_info ti;
+    socklen_t len = sizeof (ti);
+    bool ok;
+
+    bzero(&ti, sizeof (ti));
+    ok = getsockopt(fd, IPPROTO_TCP, TCP_INFO, &ti, &len) == 0;
+    if (lock != NULL)
+        pthread_mutex_lock(lock);
+    if (ok) {
+        hist_add(&ts->rtt, ti.tcpi_rtt);
+        hist_add(&ts->retrans, ti.tcpi_total_retrans);
+        hist_add(&ts->unacked, ti.tcpi_unacked);
+        hist_add(&ts->notsent, ti.tcpi_notsent_bytes);
+        hist_add(&ts->cwnd, ti.tcpi_snd_cwnd);
+        ts->n_samples++;
+    } else {
+        ts->n_failed++;
+    }
+    if (lock != NULL)
+        pthread_mutex_unlock(lock);
+    return ok;
+}
+
+/**
+ * tcp_sample_round
+ *
+ * Samples the next connections of a client list, once the interval has
+ * passed since the last round.
+ *
+ * @param ts the sampler
+ * @param l the loop's clients
+ */
+void tcp_sample_round(tcp_sampler *ts, llist *l) {
+    uint64_t now = overload_now();
+    node *start;
+    int i;
+
+    if (now < ts->next_ns)
+        return;
+    ts->next_ns = now + ts->interval_ns;
+    ts->n_rounds++;
+
+    if (ts->cursor == NULL)
+        ts->cursor = l->link;
+    start = ts->cursor;
+    for (i = 0; i < ts->per_round && ts->cursor != NULL; i++) {
+        tcp_sample_fd(ts, ((client *) ts->cursor->data)->fd, NULL);
+        ts->cursor = ts->cursor->next != NULL ? ts->cursor->next : l->link;
+        if (ts->cursor == start)
+            break;
+    }
+}
+
+/**
+ * tcp_sample_forget
+ *
+ * Moves the round past a client that is about to leave its list.
+ *
+ * @param ts the sampler
+ * @param c the client
+ */
+void tcp_sample_forget(tcp_sampler *ts, client *c) {
+    if (ts->cursor != NULL && ts->cursor->data == c)
+        ts->cursor = ts->cursor->next;
+}
+
+/**
+ * tcp_sample_wait
+ *
+ * @param ts the sampler, NULL for none
+ * @return milliseconds until the next round, -1 without a sampler
+ */
+int tcp_sample_wait(tcp_sampler *ts) {
+    uint64_t now;
+
+    if (ts == NULL)
+        return -1;
+    now = overload_now();
+    return now >= ts->next_ns ? 0 : (int) ((ts->next_ns - now + 999999) / 1000000);
+}
+
+/**
+ * tcp_sample_merge
+ *
+ * Adds the samples of one loop to another's.
+ *
+ * @param ts the sampler to add to
+ * @param o the sampler to add
+ */
+void tcp_sample_merge(tcp_sampler *ts, const tcp_sampler *o) {
+    ts->n_rounds += o->n_rounds;
+    ts->n_samples += o->n_samples;
+    ts->n_failed += o->n_failed;
+    hist_merge(&ts->rtt, &o->rtt);
+    hist_merge(&ts->retrans, &o->retrans);
+    hist_merge(&ts->unacked, &o->unacked);
+    hist_merge(&ts->notsent, &o->notsent);
+    hist_merge(&ts->cwnd, &o->cwnd);
+}
+
+/**
+ * tcp_sample_print
+ *
+ * @param ts the sampler
+ */
+void tcp_sample_print(tcp_sampler *ts) {
+    /* a thread per connection samples its own, without rounds */
+    if (ts->n_rounds > 0)
+        fprintf(stdout, "[ TCP_INFO: %lu samples in %lu rounds of up to %d every %llu ms, "
+                "%lu not TCP\n", ts->n_samples, ts->n_rounds, ts->per_round,
+                (unsigned long long) ts->interval_ns / 1000000, ts->n_failed);
+    else
+        fprintf(stdout, "[ TCP_INFO: %lu samples, every %llu ms per connection, %lu not TCP\n",
+                ts->n_samples, (unsigned long long) ts->interval_ns / 1000000, ts->n_failed);
+    hist_print(&ts->rtt, "TCP RTT", "us");
+    hist_print(&ts->retrans, "TCP Retransmits", "segments");
+    hist_print(&ts->unacked, "TCP Unacked", "segments");
+    hist_print(&ts->notsent, "TCP Send Queue", "bytes");
+    hist_print(&ts->cwnd, "TCP Congestion Window", "segments");
+}
@@ -25,6 +25,7 @@
 --	from differnt computers. 
 ---------------------------------------------------------------------------------------*/
 
+#define _GNU_SOURCE	// sched_getcpu and the CPU_SET macros
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -35,21 +36,29 @@
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include "common.h"
 
-#define SERVER_TCP_PORT 7000 	//Default port
 #define BUF_LENGTH	255	//Buffer length off the socket
+#define MAX_HOSTS	10000	//Host records, reused oldest first
 
-int createSocket();
+int createSocket(int);
 int listenForClients(int);
-int checkConnection();
+void* listenThread(void *);
+int checkConnection(int);
 void* recieveFromClient(void *);
-static void SystemFatal(const char*) ;
+int serveRequests(int, char *, int, uint32_t);
+int sendStatus(int, bool, int, uint32_t);
+int sendAll(int, const char *, int);
+int sendFlags(int, const char *, int, int);
+void printServerData();
+void signalHandler(int);
 
 // struct to hold client info
 typedef struct
 {
 	char* 	ip;
 	int	socket;
+	uint64_t accepted;	// when accept returned, for the thread start lag
 }clientInfo;
 
 // struct to hold host info
@@ -66,29 +75,119 @@ pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 hostInfo* host;
 int totalHosts;
 int activeConnections;
+volatile unsigned long totalRequests;
+cpu_cost *cost;
+reply_cache *replies;
+bool quiet;	// no per-connection log lines
+cpu_set_t cpus;	// CPUs the client threads are spread over, empty for none
+int cpuConnections[CPU_SETSIZE];	// connections handled on each CPU
+overload *load;	// admission control on the thread start lag, NULL for none
+kv *cache;	// "get", "set" and "del", see kv.c, NULL for none
+tcp_sampler *samples;	// TCP_INFO of every connection per interval, NULL for none
+trace *capture;	// connections and requests recorded to a trace, see trace.c, NULL for none
+const char *unixPath;	// Unix socket to listen on, see unix_sock.c, NULL for none
+bool tcpPort = true;	// listen on the TCP port as well
+
+const char client_msg[BUFLEN] =
+"012345678901234567890123456789012345678901234567890123456789012\n";
 
 int main(int argc, char **argv) 
 {
     totalHosts = 0;
     int port = 0;
-    
-        switch(argc)
+    int opt, costInterval = 0;
+    struct sigaction act;
+
+	while ((opt = getopt(argc, argv, "c:qa:O:u:U:K:T:R:")) != -1)
 	{
-		case 1:
+		switch(opt)
+		{
+			case 'c':
+				costInterval = atoi(optarg);	// CPU cost sampling interval
+			break;
+			case 'q':
+				quiet = true;	// no per-connection logging
+			break;
+			case 'a':
+				if (affinity_parse(optarg, &cpus) < 0)
+				{
+					fprintf(stderr, "Bad CPU list: %s\n", optarg);
+					exit(1);
+				}
+			break;
+			case 'O':
+				if ((load = overload_new(optarg)) == NULL)	// admission control
+				{
+					fprintf(stderr, "Usage: %s [-c interval_ms] [-a cpus] [-O lag_us[,reject|busy]] [-u|-U name] [-K megabytes] [-T interval_ms[,conns]] [-R trace] [-q] [port]\n", argv[0]);
+					exit(1);
+				}
+			break;
+			case 'u':
+				unixPath = optarg;	// Unix socket next to the TCP port
+			break;
+			case 'U':
+				unixPath = optarg;	// Unix socket instead of the TCP port
+				tcpPort = false;
+			break;
+			case 'K':
+				if ((cache = kv_new(atol(optarg))) == NULL)	// key value cache
+				{
+					fprintf(stderr, "Usage: %s [-c interval_ms] [-a cpus] [-O lag_us[,reject|busy]] [-u|-U name] [-K megabytes] [-T interval_ms[,conns]] [-R trace] [-q] [port]\n", argv[0]);
+					exit(1);
+				}
+			break;
+			case 'T':
+				if ((samples = tcp_sampler_new(optarg)) == NULL)	// TCP_INFO sampling
+				{
+					fprintf(stderr, "Usage: %s [-c interval_ms] [-a cpus] [-O lag_us[,reject|busy]] [-u|-U name] [-K megabytes] [-T interval_ms[,conns]] [-R trace] [-q] [port]\n", argv[0]);
+					exit(1);
+				}
+			break;
+			case 'R':
+				if ((capture = trace_new(optarg)) == NULL)	// capture to a trace file
+					SystemFatal("trace_new(): Failed");
+			break;
+			default:
+				fprintf(stderr, "Usage: %s [-c interval_ms] [-a cpus] [-O lag_us[,reject|busy]] [-u|-U name] [-K megabytes] [-T interval_ms[,conns]] [-R trace] [-q] [port]\n", argv[0]);
+				exit(1);
+		}
+	}
+
+        switch(argc - optind)
+	{
+		case 0:
 			port = SERVER_TCP_PORT;	// use default port
 		break;
-		case 2:
-			port = atoi(argv[1]);	// get user specified port
+		case 1:
+			port = atoi(argv[optind]);	// get user specified port
 		break;
 		default:
-			fprintf(stderr, "Usage: %s [port]\n", argv[0]);
+			fprintf(stderr, "Usage: %s [-c interval_ms] [-a cpus] [-O lag_us[,reject|busy]] [-u|-U name] [-K megabytes] [-T interval_ms[,conns]] [-R trace] [-q] [port]\n", argv[0]);
 			exit(1);
 	}
+
+	// print the statistics when the server is stopped with CTRL-c
+	act.sa_handler = signalHandler;
+	act.sa_flags = 0;
+	sigemptyset(&act.sa_mask);
+	if (sigaction(SIGINT, &act, NULL) == -1)
+		SystemFatal("Failed to set SIGINT handler");
+
+	// open the cost counters before any client thread exists so they are inherited
+	if (costInterval > 0)
+	{
+		if ((cost = cpu_cost_new(costInterval, &totalRequests)) == NULL)
+			SystemFatal("cpu_cost_new() Failed");
+		cpu_cost_start(cost);
+	}
 	
-	host = malloc(10000 * sizeof(hostInfo)); // 10000 hosts max 
+	host = malloc(MAX_HOSTS * sizeof(hostInfo)); // MAX_HOSTS hosts max
 	
+	// replies to "request N" are shared by every client thread
+	if ((replies = reply_cache_new(client_msg)) == NULL)
+		SystemFatal("Reply Cache Failed");
 	
-	if(checkConnection() == -1)
+	if(checkConnection(port) == -1)
 	{
 		perror("Server Exited - Error occurred");
 		exit(1);
@@ -103,12 +202,28 @@ int main(int argc, char **argv)
  * Function to check if server encountered an error, if so exit and clear 
  * allocated memory 
  */ 
-int checkConnection()
+int checkConnection(int port)
 {
-	int socket;
+	int socket, unixSocket;
+	pthread_t unixThread;
+
+	// the Unix socket gets an accept thread of its own, or this one
+	if (unixPath != NULL)
+	{
+		if ((unixSocket = unix_listen(unixPath)) == -1)
+		{
+			perror("Can't listen on the Unix socket");
+			return(-1);
+		}
+		fprintf(stderr, "Listening on Unix socket %s\n", unixPath);
+		if (!tcpPort)
+			return listenForClients(unixSocket) == -1 ? -1 : 0;
+		if (pthread_create(&unixThread, NULL, listenThread, (void *)(intptr_t)unixSocket) != 0)
+			SystemFatal("Unable to create the Unix accept thread");
+	}
 
 	// create socket
-	socket = createSocket();
+	socket = createSocket(port);
 	if(socket == -1)
 	{
 		perror("Socket Error!");
@@ -127,14 +242,11 @@ int checkConnection()
 /*
  * Function to create socket, set options and bind name to socket
  */ 
-int createSocket()
+int createSocket(int port)
 {
-	int sd, port, arg;
+	int sd, arg;
 	struct	sockaddr_in server;
 
-	//Get port from global default
-	port = SERVER_TCP_PORT;
-
 	// Create a stream socket
 	if ((sd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
 	{
@@ -166,17 +278,28 @@ int createSocket()
 }
 
 
+/*
+ * Function to accept clients on a second listen socket in a thread of its own
+ */
+void* listenThread(void *sd)
+{
+	if (listenForClients((intptr_t)sd) == -1)
+		perror("Client Connection Error!");
+	return NULL;
+}
+
 /*
  * Function to listen for clients, accept clients and store connection information
  */
 int listenForClients(int sd)
 {
 	int	new_sd;
+	bool	admitted;
 	socklen_t client_len;
 	struct sockaddr_in client;
 
 	//listen for clients
-	listen(sd, 5);
+	listen(sd, LISTENQ);
 	while(1)
 	{
 		pthread_t clientThread;
@@ -187,16 +310,43 @@ int listenForClients(int sd)
 		// accept new connections on socket
 		if ((new_sd = accept (sd, (struct sockaddr *)&client, &client_len)) == -1)
 		{
+			// the client reset the connection before it was accepted
+			if (errno == EINTR || errno == ECONNABORTED)
+			{
+				free(cl);
+				continue;
+			}
 			fprintf(stderr, "Can't accept client\n");
 			return -1;
 		}
 
-		cl->ip = inet_ntoa(client.sin_addr);
+		// reset the connection instead of starting a thread while the threads lag
+		if (load != NULL)
+		{
+			pthread_mutex_lock(&mutex);
+			overload_queue(load, sd);
+			admitted = overload_admit(load, new_sd);
+			pthread_mutex_unlock(&mutex);
+			if (!admitted)
+			{
+				free(cl);
+				continue;
+			}
+			cl->accepted = overload_now();
+		}
+
+		// a Unix peer has no address to show
+		cl->ip = client.sin_family == AF_UNIX ? "unix" : inet_ntoa(client.sin_addr);
 		cl->socket = new_sd;
-		//increment number of active connections
-		activeConnections++;
 		//create a new thread for each connection
-		pthread_create(&clientThread, NULL, recieveFromClient, (void*)cl);
+		//nobody joins the client threads, so they release their stacks when they exit
+		if (pthread_create(&clientThread, NULL, recieveFromClient, (void*)cl) != 0)
+		{
+			close(new_sd);
+			free(cl);
+			continue;
+		}
+		pthread_detach(clientThread);
 
 	}
 	close(sd);
@@ -205,48 +355,89 @@ int listenForClients(int sd)
 
 /*
  * Function to recieve data from connected client, each connection is handled 
- * on a different thread. Client information is stored, mutex is locked, data
- * is recieved and set back to client. After data is recieved information is stored
- * in the appropriate structures. 
+ * on a different thread. Client information is stored, data is recieved and
+ * set back to client. A client that starts with "request" or "quit" is served
+ * with the request protocol, anything else is echoed back once. After data
+ * is recieved information is stored in the appropriate structures. 
  */
 void* recieveFromClient(void *client) 
 {
-	char		*bp, buf[BUF_LENGTH];
+	char		*bp, buf[BUF_LENGTH], *rbuf;
 	char* 		clientAddress;
-	int		n, bytes_to_read, socket, arrayPos;
+	int		n, bytes_to_read, socket, arrayPos, received, cpu;
+	uint32_t	traceId = 0;
         clientInfo 	*cl = (clientInfo *)client; 
 
 	socket 		= cl->socket;
 	clientAddress 	= cl->ip;
-	printf("Current Active Hosts: %d\n", ++activeConnections);
-	
-		arrayPos = totalHosts;
+
+	// mutex to lock the host records
+	pthread_mutex_lock(&mutex);
+	if (load != NULL)
+		overload_lag(load, overload_now() - cl->accepted);
+	++activeConnections;
+	if (!quiet)
+		printf("Current Active Hosts: %d\n", activeConnections);
+	//increment total host connections, the records wrap around after MAX_HOSTS
+	arrayPos = totalHosts++ % MAX_HOSTS;
+	cpu = affinity_cpu(&cpus, arrayPos);
 		host[arrayPos].status = "true";
 		host[arrayPos].ip = clientAddress;
-		host[arrayPos].numOfConnections = 0;
+		host[arrayPos].numOfConnections = 1;
 		host[arrayPos].numOfBytesSent = 0;
-		
-	// mutex to lock 
-	pthread_mutex_lock(&mutex);
-	//increment total host connections
-	totalHosts++;
-	
-	bp = buf;
-	bytes_to_read = BUF_LENGTH;
-	while ((n = recv (socket, bp, bytes_to_read, 0)) < BUF_LENGTH)
+	pthread_mutex_unlock(&mutex);
+	if (capture != NULL)
+		traceId = trace_connect(capture);
+
+	// the threads take the CPUs in turn, before they allocate their buffers
+	if (cpu >= 0 && affinity_pin(cpu) < 0)
+		cpu = -1;
+
+	rbuf = malloc(RECV_BUFLEN);
+	if ((n = recv(socket, rbuf, RECV_BUFLEN, 0)) <= 0)
+		received = 0;
+	else if (strncmp(rbuf, "request", n < 7 ? n : 7) == 0 ||
+		strncmp(rbuf, "quit", n < 4 ? n : 4) == 0 ||
+		strncmp(rbuf, "binary", n < 6 ? n : 6) == 0 ||
+		(cache != NULL && (strncmp(rbuf, "get ", n < 4 ? n : 4) == 0 ||
+		strncmp(rbuf, "set ", n < 4 ? n : 4) == 0 ||
+		strncmp(rbuf, "del ", n < 4 ? n : 4) == 0)))
+	{
+		received = serveRequests(socket, rbuf, n, traceId);
+	}
+	else
 	{
-		bp += n;
-		bytes_to_read -= n;
+		// echo the rest of the BUF_LENGTH message back, bytes past it are dropped
+		if (n > BUF_LENGTH)
+			n = BUF_LENGTH;
+		memcpy(buf, rbuf, n);
+		bp = buf + n;
+		bytes_to_read = BUF_LENGTH - n;
+		while (bytes_to_read > 0 && (n = recv (socket, bp, bytes_to_read, 0)) > 0)
+		{
+			bp += n;
+			bytes_to_read -= n;
+		}
+		received = BUF_LENGTH - bytes_to_read;
+		__sync_fetch_and_add(&totalRequests, 1);
+		// send data on socket
+		send (socket, buf, BUF_LENGTH, 0);
 	}
+	free(rbuf);
+	if (capture != NULL)
+		trace_event(capture, traceId, TRACE_CLOSE, 0);
 
-	host[arrayPos].numOfConnections++;
-	host[arrayPos].numOfBytesSent += n;
-        printf ("Total Host Connections: %d\n", totalHosts);
-	printf ("Client IP: %s\n", host[arrayPos].ip);
-	printf ("Number of Connections by Client: %d\n", host[arrayPos].numOfConnections);
-	printf ("Number of Bytes Recieved: %d\n", host[arrayPos].numOfBytesSent);
-	// send data on socket
-	send (socket, buf, BUF_LENGTH, 0);
+	pthread_mutex_lock(&mutex);
+	host[arrayPos].numOfBytesSent += received;
+	if ((cpu = sched_getcpu()) >= 0 && cpu < CPU_SETSIZE)
+		cpuConnections[cpu]++;
+	if (!quiet)
+	{
+		printf ("Total Host Connections: %d\n", totalHosts);
+		printf ("Client IP: %s\n", host[arrayPos].ip);
+		printf ("Number of Connections by Client: %d\n", host[arrayPos].numOfConnections);
+		printf ("Number of Bytes Recieved: %d\n", host[arrayPos].numOfBytesSent);
+	}
 	
 	close (socket);
 	free(client);
@@ -261,8 +452,222 @@ void* recieveFromClient(void *client)
 	return NULL;
 }
 
+/*
+ * Function to serve newline terminated requests until the client quits or
+ * disconnects. Every "request [N]" is answered with N bytes from the reply
+ * cache, or BUFLEN bytes without N. After "binary 1" the requests are
+ * frames and every reply is preceded by a header carrying the request id.
+ * Every command is recorded with -R under the connection's traceId.
+ * Returns the number of bytes recieved.
+ */
+int serveRequests(int socket, char *rbuf, int rlen, uint32_t traceId)
+{
+	int	off, used, chunk, depth, received = rlen;
+	bool	binary = false;
+	char	hdr[FRAME_HDR_LEN], kvOut[KV_REPLY_MAX];
+	const char	*reply;
+	proto_req	r;
+	uint64_t	nextSample = 0;
+
+	while (1)
+	{
+		off = 0;
+		depth = 0;
+		while ((used = proto_next_req(binary, rbuf + off, rlen - off, &r)) > 0)
+		{
+			off += used;
+			if (r.type == CMD_NONE)
+				break;
+
+			// the requests read with this one were sent before their replies
+			if (capture != NULL && r.type != CMD_INVALID)
+				trace_request(capture, traceId, &r, binary,
+					proto_wire_len(binary, rbuf + off, rlen - off, used), depth++);
+
+			switch (r.type)
+			{
+				case CMD_REQUEST:
+					// the lag is sampled as threads start, without new
+					// connections it decays here
+					if (load != NULL && load->shedding)
+					{
+						pthread_mutex_lock(&mutex);
+						overload_idle(load, overload_now());
+						pthread_mutex_unlock(&mutex);
+					}
+					// a shed request costs a five byte reply, or a bare header
+					if (load != NULL && overload_busy(load))
+					{
+						if (sendStatus(socket, binary, OP_BUSY, r.id) == -1)
+							return received;
+						break;
+					}
+					__sync_fetch_and_add(&totalRequests, 1);
+					if (binary)
+					{
+						proto_frame_hdr(hdr, OP_REPLY, r.arg == 0 ? BUFLEN : r.arg, r.id);
+						// the header waits to go out in one packet with the data
+						if (sendFlags(socket, hdr, FRAME_HDR_LEN, MSG_MORE) == -1)
+							return received;
+					}
+					if (r.arg == 0 && sendAll(socket, client_msg, BUFLEN) == -1)
+						return received;
+					for (; r.arg > 0; r.arg -= chunk)
+					{
+						chunk = r.arg > REPLY_CLASS_MAX ? REPLY_CLASS_MAX : r.arg;
+						if (sendAll(socket, reply_cache_get(replies, chunk), chunk) == -1)
+							return received;
+					}
+				break;
+				case CMD_GET:
+				case CMD_SET:
+				case CMD_DEL:
+					// the value is copied out of the cache before it is sent,
+					// without the cache the command is answered as a bad one
+					if (cache == NULL)
+					{
+						if (sendStatus(socket, binary, OP_ERROR, r.id) == -1)
+							return received;
+						break;
+					}
+					__sync_fetch_and_add(&totalRequests, 1);
+					chunk = kv_reply(cache, &r, kvOut, &reply);
+					if (sendAll(socket, reply, chunk) == -1)
+						return received;
+				break;
+				case CMD_QUIT:
+					return received;
+				case CMD_BINARY:
+					// frames follow the acknowledgement
+					if (r.arg != PROTO_BIN_VERSION)
+					{
+						if (sendAll(socket, "error\n", 6) == -1)
+							return received;
+						break;
+					}
+					if (sendAll(socket, "binary 1\n", 9) == -1)
+						return received;
+					binary = true;
+				break;
+				case CMD_INVALID:
+					fprintf(stderr, "[%5d]Bad frame\n", socket);
+					return received;
+				default:
+					// every frame is answered, unknown text is ignored
+					if (binary && sendStatus(socket, binary, OP_ERROR, r.id) == -1)
+						return received;
+				break;
+			}
+		}
+
+		// keep the partial command and wait for the rest
+		rlen -= off;
+		memmove(rbuf, rbuf + off, rlen);
+		if (rlen == RECV_BUFLEN)
+			return received;
+
+		// every connection has its own thread, so each samples itself in turn
+		if (samples != NULL && overload_now() >= nextSample)
+		{
+			nextSample = overload_now() + samples->interval_ns;
+			tcp_sample_fd(samples, socket, &mutex);
+		}
+
+		if ((used = recv(socket, rbuf + rlen, RECV_BUFLEN - rlen, 0)) <= 0)
+			return received;
+		rlen += used;
+		received += used;
+	}
+}
+
+/*
+ * Function to send a reply without data: "busy" or "error" in the text
+ * framing, a header alone in the binary one.
+ */
+int sendStatus(int socket, bool binary, int opcode, uint32_t id)
+{
+	char	hdr[FRAME_HDR_LEN];
+
+	if (binary)
+	{
+		proto_frame_hdr(hdr, opcode, 0, id);
+		return sendAll(socket, hdr, FRAME_HDR_LEN);
+	}
+	if (opcode == OP_BUSY)
+		return sendAll(socket, OVERLOAD_BUSY_REPLY, OVERLOAD_BUSY_LEN);
+	return sendAll(socket, "error\n", 6);
+}
+
+/*
+ * Function to send a whole buffer on a blocking socket.
+ */
+int sendAll(int socket, const char *buf, int len)
+{
+	return sendFlags(socket, buf, len, 0);
+}
+
+/*
+ * Function to send a whole buffer on a blocking socket with send flags,
+ * MSG_MORE to hold it back for the data that follows.
+ */
+int sendFlags(int socket, const char *buf, int len, int flags)
+{
+	int	n;
+
+	while (len > 0)
+	{
+		if ((n = send(socket, buf, len, flags | MSG_NOSIGNAL)) == -1)
+			return -1;
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/*
+ * Function to print the server statistics, including the CPU cost per request
+ * when cost accounting is enabled.
+ */
+void printServerData()
+{
+	int i;
+
+	fprintf(stdout, "\n\n[===========================================]\n");
+	fprintf(stdout, "[ Total Clients Connected: %d\n", totalHosts);
+	fprintf(stdout, "[ Total Active Clients: %d\n", activeConnections);
+	for (i = 0; i < CPU_SETSIZE; i++)
+	{
+		if (cpuConnections[i] > 0)
+			fprintf(stdout, "[ CPU %3d (node %d): %d connections\n", i,
+				affinity_node(i), cpuConnections[i]);
+	}
+	if (load != NULL)
+		overload_print(load);
+	reply_cache_print(replies);
+	if (cache != NULL)
+		kv_print(cache);
+	if (samples != NULL)
+		tcp_sample_print(samples);
+	if (capture != NULL)
+		trace_print(capture);
+	if (cost != NULL)
+		cpu_cost_print(cost);
+	fprintf(stdout, "[===========================================]\n\n");
+}
+
+/*
+ * Function to handle CTRL-c, prints the statistics and exits.
+ */
+void signalHandler(int signo)
+{
+	fprintf(stderr, "\nReceived SIGINT signal\n");
+	unix_unlink(unixPath);
+	printServerData();
+	exit(EXIT_FAILURE);
+}
+
 // Prints the error stored in errno and aborts the program.
-static void SystemFatal(const char* message) 
+void SystemFatal(const char* message) 
 {
     perror (message);
     exit (EXIT_FAILURE);
@@ -18,6 +18,9 @@
 --                                server.
 --                              * Monitors number of connections made
 --                              * Gets total bytes of data sent
+--				October 2026
+--				* Results go to a shared memory-mapped log, converted
+--				  to thread_clnt.csv when every child has ended
 --
 --
 --	PROGRAMMERS:		Jivanjot Brar & Shan Bains
@@ -31,7 +34,6 @@
 ---------------------------------------------------------------------------------------*/
 
 #include "common.h"
-#include <semaphore.h>
 #include <sys/wait.h>
 
 #define EXEC 1500
@@ -40,8 +42,7 @@
 const char client_msg[MAXLINE] =
         "012345678901234567890123456789012345678901234567890123456789012\n";
 FILE *fp;
-char *data_file;
-sem_t mutex;
+reslog *results;
 
 /**
  * main
@@ -94,20 +95,13 @@ int main(int argc, char **argv) {
             exit(1);
     }
 
-    if (sem_init(&mutex, 1, 1) < 0) {
-        perror("sem_init(): semaphore initialization failed");
+    // the children inherit the shared mapping of the result log
+    unlink("./thread_clnt.dat");
+    if ((results = reslog_create("./thread_clnt.dat", EXEC)) == NULL) {
+        perror("reslog_create(): Unable to create the result log");
         exit(EXIT_FAILURE);
     }
 
-    data_file = malloc(sizeof (char *));
-    sprintf(data_file, "./thread_clnt.csv");
-    if ((fp = fopen(data_file, "a+")) == NULL) {
-        perror("fopen(): Unable to open the file");
-        exit(EXIT_FAILURE);
-    }
-    fprintf(fp, "ProcessID,Time(Seconds),Data(Bytes)\n");
-    fclose(fp);
-
 
     // run the server 10 times
     for (i = 0; i < EXEC; i++) {
@@ -124,7 +118,7 @@ int main(int argc, char **argv) {
         }
     }
 
-    if (pid[i] > 0) {
+    if (i == EXEC) { // PARENT, the children break out of the loop
         for (i = 0; i < EXEC; i++) {
             waitpid(pid[i], &status, 0);
         }
@@ -133,7 +127,14 @@ int main(int argc, char **argv) {
         fprintf(stderr, "   ############    Main(): Child Processes Ended    ############\n");
         fprintf(stderr, "   -------------------------------------------------------------\n\n");
 
-        free(data_file);
+        // convert the results of every child
+        if ((fp = fopen("./thread_clnt.csv", "w")) == NULL) {
+            perror("fopen(): Unable to open the file");
+            exit(EXIT_FAILURE);
+        }
+        reslog_to_csv(results, fp);
+        fclose(fp);
+        reslog_close(results);
     }
     return EXIT_SUCCESS;
 }
@@ -153,7 +154,7 @@ void connect_to_server(data *d, char * host, int port) {
     char *bp, rbuf[MAXLINE], **pptr;
     char str[16];
     double t1, t2;
-    pid_t pid;
+    reslog_rec *r;
 
 
     // Create the socket
@@ -210,14 +211,16 @@ void connect_to_server(data *d, char * host, int port) {
     // store time
     d->time = t2 - t1;
 
-    if ((fp = fopen(data_file, "a+")) == NULL) {
-        perror("fopen(): Unable to open the file");
+    // log the result in the shared record claimed for this child
+    if ((r = reslog_claim(results)) != NULL) {
+        memset(r, 0, sizeof (reslog_rec));
+        r->pid = getpid();
+        r->requests = r->replies = 1;
+        r->dataSent = d->dataSent;
+        r->dataReceived = MAXLINE;
+        r->time = d->time;
+        reslog_commit(r);
     }
-    sem_wait(&mutex);
-    pid = getpid();
-    fprintf(fp, "%d,%d,%lf\n", (int) pid, d->dataSent, d->time);
-    fclose(fp);
-    sem_post(&mutex);
 
     //print client information
     //printf("Number of Requests: %d\n", d->numOfRequests);
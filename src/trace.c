@@ -0,0 +1,241 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		trace.c - Capture of the traffic a server receives
+--
+--	FUNCTIONS:			fwrite, pthread_mutex_lock
+--
+--	DATE:				October 19, 2026
+--
+--	NOTES:
+--	With -R the servers write what their clients do to a trace file: when
+--	each connection arrives, every command it sends and when it goes away.
+--	replay_clnt plays a trace back against any server, so two builds can
+--	be compared on the same workload instead of on runs of the randomised
+--	clients.
+--
+--	A trace is a header and fixed size binary records, 20 bytes each. A
+--	record holds the microseconds since the one before it, the connection
+--	it belongs to, numbered from 0 in order of arrival, and what happened.
+--	A command's record holds its type, its framing, the reply length of a
+--	"request N" or the version of a "binary N", its length on the wire
+--	with the NUL padding of fixed size requests, and how many earlier
+--	requests of the connection the server had not answered when it read
+--	it, which tells the replay the client pipelined it. The text of a get,
+--	set, del, publish or unknown command follows in text records, each a
+--	record of the same 20 bytes carrying 12 bytes of the text. The loops
+--	of a server share the trace; a record is stamped and written under its
+--	lock, so the records are in order of time. They are buffered by stdio
+--	and flushed when the server prints its statistics.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+
+#define TRACE_STDIO_BUF (1 << 20)
+
+static const char *trace_kinds[] = {"connect", "request", "close", "text"};
+
+/**
+ * trace_now_us
+ *
+ * @return the monotonic clock in microseconds
+ */
+static uint64_t trace_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * trace_new
+ *
+ * Creates a trace file, replacing any file of the name.
+ *
+ * @param path the trace file
+ * @return the trace, NULL on failure
+ */
+trace* trace_new(const char *path) {
+    trace_hdr hdr;
+    trace *t;
+
+    if ((t = calloc(1, sizeof (trace))) == NULL)
+        return NULL;
+    if ((t->f = fopen(path, "w")) == NULL) {
+        free(t);
+        return NULL;
+    }
+    setvbuf(t->f, NULL, _IOFBF, TRACE_STDIO_BUF);
+    if (pthread_mutex_init(&t->lock, NULL) != 0) {
+        fclose(t->f);
+        free(t);
+        return NULL;
+    }
+
+    bzero(&hdr, sizeof (hdr));
+    hdr.magic = TRACE_MAGIC;
+    hdr.record_size = sizeof (trace_rec);
+    if (fwrite(&hdr, sizeof (hdr), 1, t->f) != 1) {
+        fclose(t->f);
+        free(t);
+        return NULL;
+    }
+    t->path = path;
+    t->last_us = trace_now_us();
+    return t;
+}
+
+/**
+ * trace_event
+ *
+ * Records what a connection did, stamped with the time now.
+ *
+ * @param t the trace
+ * @param conn the connection's number
+ * @param kind TRACE_CONNECT or TRACE_CLOSE
+ * @param arg 0
+ */
+void trace_event(trace *t, uint32_t conn, int kind, uint32_t arg) {
+    trace_rec rec;
+    uint64_t now;
+
+    bzero(&rec, sizeof (rec));
+    rec.conn = conn;
+    rec.kind = kind;
+    rec.arg = arg;
+    pthread_mutex_lock(&t->lock);
+    now = trace_now_us();
+    rec.delta_us = now - t->last_us;
+    t->last_us = now;
+    if (fwrite(&rec, sizeof (rec), 1, t->f) == 1)
+        t->n_records[kind]++;
+    else
+        t->n_failed++;
+    pthread_mutex_unlock(&t->lock);
+}
+
+/**
+ * trace_request
+ *
+ * Records a command a connection sent, stamped with the time now, and its
+ * text if the replay cannot make it up from the record.
+ *
+ * @param t the trace
+ * @param conn the connection's number
+ * @param r the command
+ * @param binary true if it is a frame
+ * @param len its bytes on the wire, see proto_wire_len
+ * @param depth earlier requests of the connection not answered yet
+ */
+void trace_request(trace *t, uint32_t conn, const proto_req *r, bool binary, int len, int depth) {
+    trace_rec rec, text;
+    bool ok;
+    int i;
+    uint64_t now;
+
+    bzero(&rec, sizeof (rec));
+    rec.conn = conn;
+    rec.kind = TRACE_REQUEST;
+    rec.cmd = r->type;
+    rec.arg = r->type == CMD_REQUEST || r->type == CMD_BINARY ? r->arg : 0;
+    rec.len = len < UINT16_MAX ? len : UINT16_MAX;
+    rec.depth = depth < UINT8_MAX ? depth : UINT8_MAX;
+    rec.binary = binary;
+    bzero(&text, sizeof (text));
+    text.kind = TRACE_TEXT;
+
+    /* the text records follow the command's without a record between */
+    pthread_mutex_lock(&t->lock);
+    now = trace_now_us();
+    rec.delta_us = now - t->last_us;
+    t->last_us = now;
+    ok = fwrite(&rec, sizeof (rec), 1, t->f) == 1;
+
+    /* "request N", "binary N", "subscribe" and "quit" are made up again */
+    if (r->type != CMD_REQUEST && r->type != CMD_BINARY && r->type != CMD_SUBSCRIBE &&
+            r->type != CMD_QUIT) {
+        for (i = 0; ok && i < r->cmd_len; i += text.len) {
+            text.len = r->cmd_len - i < (int) sizeof (text.text) ?
+                    r->cmd_len - i : (int) sizeof (text.text);
+            memcpy(text.text, r->cmd + i, text.len);
+            if ((ok = fwrite(&text, sizeof (text), 1, t->f) == 1))
+                t->n_records[TRACE_TEXT]++;
+        }
+    }
+    if (ok)
+        t->n_records[TRACE_REQUEST]++;
+    else
+        t->n_failed++;
+    pthread_mutex_unlock(&t->lock);
+}
+
+/**
+ * trace_connect
+ *
+ * Records a connection's arrival.
+ *
+ * @param t the trace
+ * @return the number the connection's records carry
+ */
+uint32_t trace_connect(trace *t) {
+    uint32_t conn = __atomic_fetch_add(&t->next_conn, 1, __ATOMIC_RELAXED);
+
+    trace_event(t, conn, TRACE_CONNECT, 0);
+    return conn;
+}
+
+/**
+ * trace_load
+ *
+ * Reads a whole trace file.
+ *
+ * @param path the trace file
+ * @param n receives the number of records
+ * @return the records, NULL if the file is not a trace
+ */
+trace_rec* trace_load(const char *path, long *n) {
+    trace_hdr hdr;
+    trace_rec *recs;
+    FILE *f;
+    long size;
+
+    if ((f = fopen(path, "r")) == NULL)
+        return NULL;
+    if (fread(&hdr, sizeof (hdr), 1, f) != 1 || hdr.magic != TRACE_MAGIC ||
+            hdr.record_size != sizeof (trace_rec) || fseek(f, 0, SEEK_END) < 0 ||
+            (size = ftell(f)) < 0) {
+        fclose(f);
+        return NULL;
+    }
+
+    /* a trace cut short by a crash ends at its last whole record */
+    *n = (size - (long) sizeof (hdr)) / (long) sizeof (trace_rec);
+    if ((recs = malloc((*n + 1) * sizeof (trace_rec))) == NULL ||
+            fseek(f, sizeof (hdr), SEEK_SET) < 0 ||
+            (long) fread(recs, sizeof (trace_rec), *n, f) != *n) {
+        free(recs);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    return recs;
+}
+
+/**
+ * trace_print
+ *
+ * Flushes the trace and prints what it holds. The lock is only tried, as
+ * the servers print from their SIGINT handler, which may interrupt a loop
+ * holding it.
+ *
+ * @param t the trace
+ */
+void trace_print(trace *t) {
+    bool locked = pthread_mutex_trylock(&t->lock) == 0;
+    int i;
+
+    fflush(t->f);
+    fprintf(stdout, "[ Trace: %s,", t->path);
+    for (i = TRACE_CONNECT; i <= TRACE_CLOSE; i++)
+        fprintf(stdout, " %lu %s", t->n_records[i], trace_kinds[i]);
+    fprintf(stdout, ", %lu not written\n", t->n_failed);
+    if (locked)
+        pthread_mutex_unlock(&t->lock);
+}
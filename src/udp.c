@@ -0,0 +1,319 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		udp.c - Request datagrams in batches for e_svr
+--
+--	FUNCTIONS:			recvmmsg, sendmmsg
+--
+--	DATE:				October 19, 2026
+--
+--	NOTES:
+--	With -D every reactor binds a UDP socket on the server's port, with
+--	SO_REUSEPORT so the kernel spreads the senders over the reactors. A
+--	datagram holds one or more "request [N]\n" commands, each answered by
+--	a datagram of N bytes, BUFLEN without N, from the reply cache; an N
+--	over UDP_REPLY_MAX does not fit in a datagram and is answered
+--	"error\n". The socket is drained with recvmmsg, UDP_BATCH datagrams a
+--	call, and the replies to a batch go out with sendmmsg, up to UDP_BATCH
+--	a call. UDP makes no promise of delivery: a reply the socket buffer
+--	has no room for is dropped and counted, the client sees it as lost.
+--
+--	With -G the socket also sets UDP_GRO, so the kernel may hand over
+--	several datagrams of one sender in one buffer, and equal replies to one
+--	sender are sent as one buffer that UDP_SEGMENT splits into datagrams,
+--	which crosses the stack once instead of once per datagram.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+#include <netinet/udp.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+#define UDP_RCVBUF (4 * 1024 * 1024) // room for bursts while the loop is busy
+
+/**
+ * udp_new
+ *
+ * Binds a non-blocking UDP socket on a port and allocates its batches.
+ *
+ * @param port the server's port
+ * @param gso true to receive with UDP_GRO and send with UDP_SEGMENT
+ * @return the socket and batches, exits on failure
+ */
+udp_server* udp_new(int port, bool gso) {
+    struct sockaddr_in addr;
+    udp_server *u;
+    int i, on = 1, rcvbuf = UDP_RCVBUF;
+
+    if ((u = calloc(1, sizeof (udp_server))) == NULL)
+        SystemFatal("UDP Malloc() Failed\n");
+    if ((u->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0)) < 0)
+        SystemFatal("UDP Socket Creation Failed\n");
+    setsockopt(u->fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof (on));
+    setsockopt(u->fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof (on));
+    setsockopt(u->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof (rcvbuf));
+    if (gso && setsockopt(u->fd, SOL_UDP, UDP_GRO, &on, sizeof (on)) < 0) {
+        fprintf(stderr, "> UDP_GRO not supported, sending single datagrams\n");
+        gso = false;
+    }
+    u->gso = gso;
+
+    bzero(&addr, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(u->fd, (struct sockaddr *) &addr, sizeof (addr)) < 0)
+        SystemFatal("Failed to bind UDP socket\n");
+
+    /* a GRO buffer holds up to 64 KB of coalesced datagrams */
+    u->rx_buflen = gso ? 65536 : UDP_SEG_MAX + 1;
+    u->rx = calloc(UDP_BATCH, sizeof (struct mmsghdr));
+    u->rx_iov = calloc(UDP_BATCH, sizeof (struct iovec));
+    u->names = calloc(UDP_BATCH, sizeof (struct sockaddr_in));
+    u->rx_bufs = malloc((size_t) UDP_BATCH * u->rx_buflen);
+    u->rx_ctl = calloc(UDP_BATCH, CMSG_SPACE(sizeof (int)));
+    u->tx = calloc(UDP_BATCH, sizeof (struct mmsghdr));
+    u->tx_iov = calloc(UDP_BATCH * UDP_MAX_SEGS, sizeof (struct iovec));
+    u->tx_ctl = calloc(UDP_BATCH, CMSG_SPACE(sizeof (uint16_t)));
+    if (u->rx == NULL || u->rx_iov == NULL || u->names == NULL || u->rx_bufs == NULL ||
+            u->rx_ctl == NULL || u->tx == NULL || u->tx_iov == NULL || u->tx_ctl == NULL)
+        SystemFatal("UDP Malloc() Failed\n");
+
+    for (i = 0; i < UDP_BATCH; i++) {
+        u->rx_iov[i].iov_base = u->rx_bufs + (size_t) i * u->rx_buflen;
+        u->rx_iov[i].iov_len = u->rx_buflen;
+    }
+    return u;
+}
+
+/**
+ * udp_datagrams
+ *
+ * @param m a batched reply message
+ * @return the datagrams it goes out as, one per segment with UDP_SEGMENT
+ */
+static int udp_datagrams(struct mmsghdr *m) {
+    return m->msg_hdr.msg_controllen > 0 ? (int) m->msg_hdr.msg_iovlen : 1;
+}
+
+/**
+ * udp_flush
+ *
+ * Sends the batched replies. Replies the socket refuses are dropped, and
+ * both counts are in datagrams.
+ *
+ * @param u the socket
+ */
+static void udp_flush(udp_server *u) {
+    int sent = 0, n;
+
+    while (sent < u->n_tx) {
+        n = sendmmsg(u->fd, u->tx + sent, u->n_tx - sent, 0);
+        u->stats.n_tx_calls++;
+        if (n > 0) {
+            for (; n > 0; n--)
+                u->stats.n_tx += udp_datagrams(&u->tx[sent++]);
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)) {
+            for (; sent < u->n_tx; sent++)
+                u->stats.n_dropped += udp_datagrams(&u->tx[sent]);
+            break;
+        }
+        /* a message the kernel will not take at all, skip it */
+        u->stats.n_dropped += udp_datagrams(&u->tx[sent++]);
+    }
+    u->n_tx = 0;
+    u->n_tx_iov = 0;
+}
+
+/**
+ * udp_reply
+ *
+ * Batches a reply. With UDP_SEGMENT a reply equal to the one before it to
+ * the same sender joins that message as one more segment.
+ *
+ * @param u the socket
+ * @param name the sender
+ * @param buf the reply data
+ * @param len the reply length
+ */
+static void udp_reply(udp_server *u, struct sockaddr_in *name, const char *buf, int len) {
+    struct sockaddr_in *prev;
+    struct msghdr *m;
+    struct cmsghdr *cm;
+    char *ctl;
+
+    if (u->n_tx > 0 && u->gso) {
+        m = &u->tx[u->n_tx - 1].msg_hdr;
+        prev = m->msg_name;
+        if (prev->sin_port == name->sin_port && prev->sin_addr.s_addr == name->sin_addr.s_addr &&
+                len <= UDP_SEG_MAX && m->msg_iovlen < UDP_MAX_SEGS &&
+                (int) m->msg_iov[0].iov_len == len && (m->msg_iovlen + 1) * len <= UDP_REPLY_MAX) {
+            u->tx_iov[u->n_tx_iov].iov_base = (void *) buf;
+            u->tx_iov[u->n_tx_iov++].iov_len = len;
+            if (m->msg_iovlen++ == 1) {
+                /* the second segment makes it a UDP_SEGMENT message */
+                ctl = u->tx_ctl + (u->n_tx - 1) * CMSG_SPACE(sizeof (uint16_t));
+                m->msg_control = ctl;
+                m->msg_controllen = CMSG_SPACE(sizeof (uint16_t));
+                cm = CMSG_FIRSTHDR(m);
+                cm->cmsg_level = SOL_UDP;
+                cm->cmsg_type = UDP_SEGMENT;
+                cm->cmsg_len = CMSG_LEN(sizeof (uint16_t));
+                *(uint16_t *) CMSG_DATA(cm) = len;
+                u->stats.n_gso++;
+            }
+            return;
+        }
+    }
+
+    if (u->n_tx == UDP_BATCH)
+        udp_flush(u);
+    u->tx_iov[u->n_tx_iov].iov_base = (void *) buf;
+    u->tx_iov[u->n_tx_iov].iov_len = len;
+    m = &u->tx[u->n_tx++].msg_hdr;
+    m->msg_name = name;
+    m->msg_namelen = sizeof (struct sockaddr_in);
+    m->msg_iov = &u->tx_iov[u->n_tx_iov++];
+    m->msg_iovlen = 1;
+    m->msg_control = NULL;
+    m->msg_controllen = 0;
+    m->msg_flags = 0;
+}
+
+/**
+ * udp_segment
+ *
+ * Answers the commands of one datagram.
+ *
+ * @param s the reactor
+ * @param u its socket
+ * @param name the sender
+ * @param buf the datagram
+ * @param len its length
+ */
+static void udp_segment(server *s, udp_server *u, struct sockaddr_in *name, char *buf, int len) {
+    int off = 0, used, cmd_len;
+    long arg;
+    char *cmd;
+
+    while ((used = proto_next_cmd(buf + off, len - off, &cmd, &cmd_len)) > 0 && cmd != NULL) {
+        off += used;
+        if (proto_parse_cmd(cmd, cmd_len, &arg) != CMD_REQUEST)
+            continue;
+        if (s->load != NULL && overload_busy(s->load)) {
+            udp_reply(u, name, OVERLOAD_BUSY_REPLY, OVERLOAD_BUSY_LEN);
+            continue;
+        }
+        /* a reply larger than a datagram cannot be sent */
+        if (arg > UDP_REPLY_MAX) {
+            udp_reply(u, name, "error\n", 6);
+            continue;
+        }
+        s->n_requests++;
+        if (arg == 0)
+            udp_reply(u, name, s->replies->legacy, BUFLEN);
+        else
+            udp_reply(u, name, reply_cache_get(s->replies, arg), arg);
+    }
+}
+
+/**
+ * udp_serve
+ *
+ * Drains the socket a batch at a time and answers every request in it.
+ *
+ * @param s the reactor
+ * @param u its socket
+ */
+void udp_serve(server *s, udp_server *u) {
+    struct cmsghdr *cm;
+    int i, n, seg, off, len;
+    char *buf;
+
+    for (;;) {
+        for (i = 0; i < UDP_BATCH; i++) {
+            u->rx[i].msg_hdr.msg_name = &u->names[i];
+            u->rx[i].msg_hdr.msg_namelen = sizeof (struct sockaddr_in);
+            u->rx[i].msg_hdr.msg_iov = &u->rx_iov[i];
+            u->rx[i].msg_hdr.msg_iovlen = 1;
+            u->rx[i].msg_hdr.msg_control = u->gso ?
+                    u->rx_ctl + i * CMSG_SPACE(sizeof (int)) : NULL;
+            u->rx[i].msg_hdr.msg_controllen = u->gso ? CMSG_SPACE(sizeof (int)) : 0;
+            u->rx[i].msg_hdr.msg_flags = 0;
+        }
+        n = recvmmsg(u->fd, u->rx, UDP_BATCH, MSG_DONTWAIT, NULL);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR)
+                continue;
+            break;
+        }
+        u->stats.n_rx_calls++;
+
+        for (i = 0; i < n; i++) {
+            buf = u->rx_iov[i].iov_base;
+            len = u->rx[i].msg_len;
+
+            /* a GRO buffer is a run of datagrams of gso_size, the last may
+             * be shorter */
+            seg = len;
+            for (cm = CMSG_FIRSTHDR(&u->rx[i].msg_hdr); u->gso && cm != NULL;
+                    cm = CMSG_NXTHDR(&u->rx[i].msg_hdr, cm)) {
+                if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO)
+                    seg = *(int *) CMSG_DATA(cm);
+            }
+            if (seg <= 0)
+                seg = len;
+            if (seg < len)
+                u->stats.n_gro++;
+            for (off = 0; off < len; off += seg) {
+                u->stats.n_rx++;
+                udp_segment(s, u, &u->names[i], buf + off, len - off < seg ? len - off : seg);
+            }
+        }
+
+        /* the replies point at this batch's senders */
+        udp_flush(u);
+        if (n < UDP_BATCH)
+            break;
+    }
+}
+
+/**
+ * udp_merge
+ *
+ * @param total the counters to add to
+ * @param w a reactor's or worker's counters
+ */
+void udp_merge(udp_stats *total, const udp_stats *w) {
+    total->n_rx += w->n_rx;
+    total->n_tx += w->n_tx;
+    total->n_rx_calls += w->n_rx_calls;
+    total->n_tx_calls += w->n_tx_calls;
+    total->n_gro += w->n_gro;
+    total->n_gso += w->n_gso;
+    total->n_dropped += w->n_dropped;
+}
+
+/**
+ * udp_print
+ *
+ * @param st the counters
+ * @param gso true if UDP_GRO and UDP_SEGMENT were on
+ */
+void udp_print(udp_stats *st, bool gso) {
+    fprintf(stdout, "[ UDP Datagrams: %lu in, %lu out, %lu replies dropped\n",
+            st->n_rx, st->n_tx, st->n_dropped);
+    fprintf(stdout, "[ UDP Datagrams/Call: %.2lf recvmmsg, %.2lf sendmmsg\n",
+            st->n_rx_calls ? (double) st->n_rx / st->n_rx_calls : 0.0,
+            st->n_tx_calls ? (double) st->n_tx / st->n_tx_calls : 0.0);
+    if (gso)
+        fprintf(stdout, "[ UDP Offload: %lu GRO buffers, %lu UDP_SEGMENT sends\n",
+                st->n_gro, st->n_gso);
+}
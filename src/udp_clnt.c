@@ -0,0 +1,290 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		udp_clnt.c - UDP request load generator
+--
+--	PROGRAM:			udp_clnt
+--						./udp_clnt [-r rate] [-m max_rate] [-f factor] [-s seconds]
+--						[-n size] [-b batch] [-c sockets] [-G] HOST PORT
+--
+--	FUNCTIONS:			sendmmsg, recvmmsg, poll
+--
+--	DATE:				October 19, 2026
+--
+--	PROGRAMMERS:		Jivanjot Brar & Shan Bains
+--
+--	NOTES:
+--	Sends "request [N]\n" datagrams to e_svr -D at a fixed rate for -s
+--	seconds, then at -f times that rate, and so on up to -m datagrams per
+--	second. The datagrams go out in sendmmsg batches of -b and the replies
+--	are read with recvmmsg. Each step waits a moment for late replies and
+--	reports the rate it sent and received at and the share of requests that
+--	got no reply, lost on the way, dropped by a full socket buffer on
+--	either side, or never sent by a server that fell behind. Busy replies
+--	of a server shedding load are counted apart. -c spreads the datagrams
+--	over several sockets, which the kernel spreads over the server's
+--	SO_REUSEPORT sockets by their source ports. -G sends each batch as one
+--	buffer that UDP_SEGMENT splits into datagrams, which on loopback reach
+--	a server with UDP_GRO, e_svr -G, still as one buffer.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+#include <poll.h>
+#include <netinet/udp.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+#define USAGE "Usage: %s [-r rate] [-m max_rate] [-f factor] [-s seconds] [-n size] [-b batch] [-c sockets] [-G] HOST PORT\n"
+
+#define UDP_CLNT_GRACE_MS 200 // time for the replies of a step to come in
+#define UDP_CLNT_RCVBUF (4 * 1024 * 1024)
+
+typedef struct {
+    unsigned long n_tx;
+    unsigned long n_rx;
+    unsigned long n_busy;
+    unsigned long n_errors;
+} udp_step;
+
+struct mmsghdr rx[UDP_BATCH];
+bool gso = false;
+struct iovec rx_iov[UDP_BATCH];
+char *rx_bufs;
+int reply_len;
+
+/**
+ * now_us
+ *
+ * @return the monotonic clock in microseconds
+ */
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * drain
+ *
+ * Reads every reply waiting on the sockets.
+ *
+ * @param sds the sockets
+ * @param n_sds their number
+ * @param st the step's counters
+ */
+static void drain(int *sds, int n_sds, udp_step *st) {
+    int i, j, n;
+
+    for (i = 0; i < n_sds; i++) {
+        do {
+            n = recvmmsg(sds[i], rx, UDP_BATCH, MSG_DONTWAIT, NULL);
+            for (j = 0; j < n; j++) {
+                if (rx[j].msg_len == OVERLOAD_BUSY_LEN &&
+                        memcmp(rx_iov[j].iov_base, OVERLOAD_BUSY_REPLY, OVERLOAD_BUSY_LEN) == 0)
+                    st->n_busy++;
+                else
+                    st->n_rx++;
+            }
+        } while (n == UDP_BATCH);
+    }
+}
+
+/**
+ * run_step
+ *
+ * Sends at one rate for a number of seconds.
+ *
+ * @param sds the sockets
+ * @param n_sds their number
+ * @param tx the request batch
+ * @param batch the datagrams per sendmmsg
+ * @param rate datagrams per second
+ * @param seconds the length of the step
+ * @param st receives the step's counters
+ * @return the seconds spent sending
+ */
+static double run_step(int *sds, int n_sds, struct mmsghdr *tx, int batch, unsigned long rate,
+        int seconds, udp_step *st) {
+    struct pollfd pfd[n_sds];
+    uint64_t start, now, end, due;
+    int i, n, k = 0;
+
+    for (i = 0; i < n_sds; i++) {
+        pfd[i].fd = sds[i];
+        pfd[i].events = POLLIN;
+    }
+    bzero(st, sizeof (udp_step));
+    start = now_us();
+    end = start + (uint64_t) seconds * 1000000;
+    while ((now = now_us()) < end) {
+        /* send what the rate owes by now, a batch at a time */
+        due = (now - start) * rate / 1000000;
+        while (st->n_tx < due) {
+            n = due - st->n_tx < (uint64_t) batch ? due - st->n_tx : batch;
+            if (gso) {
+                /* one message of n segments */
+                tx[0].msg_hdr.msg_iovlen = n;
+                n = sendmsg(sds[k], &tx[0].msg_hdr, MSG_DONTWAIT) > 0 ? n : -1;
+            } else {
+                n = sendmmsg(sds[k], tx, n, MSG_DONTWAIT);
+            }
+            if (n <= 0) {
+                /* a full send buffer, or an ICMP error from a closed port */
+                st->n_errors++;
+                break;
+            }
+            st->n_tx += n;
+            k = (k + 1) % n_sds;
+        }
+        drain(sds, n_sds, st);
+        if (st->n_tx >= due)
+            poll(pfd, n_sds, 1);
+    }
+    end = now_us();
+
+    /* replies still on the way belong to this step */
+    while ((now = now_us()) < end + UDP_CLNT_GRACE_MS * 1000) {
+        poll(pfd, n_sds, UDP_CLNT_GRACE_MS);
+        drain(sds, n_sds, st);
+    }
+    return (end - start) / 1e6;
+}
+
+/**
+ * main
+ *
+ * @param argc
+ * @param argv
+ * @return
+ */
+int main(int argc, char **argv) {
+    int i, opt, seconds = 2, size = 0, batch = 32, n_sds = 1, len, rcvbuf = UDP_CLNT_RCVBUF;
+    unsigned long rate = 10000, max_rate = 160000, best = 0;
+    double factor = 2.0, secs, lost;
+    struct sockaddr_in server_addr;
+    struct mmsghdr tx[UDP_BATCH];
+    struct iovec tx_iov[UDP_BATCH];
+    char ctl[CMSG_SPACE(sizeof (uint16_t))];
+    struct cmsghdr *cm;
+    struct hostent *hp;
+    char request[32];
+    udp_step st;
+    int *sds;
+
+    while ((opt = getopt(argc, argv, "r:m:f:s:n:b:c:G")) != -1) {
+        switch (opt) {
+            case 'r':
+                rate = strtoul(optarg, NULL, 10); // datagrams per second of the first step
+                break;
+            case 'm':
+                max_rate = strtoul(optarg, NULL, 10); // rate of the last step
+                break;
+            case 'f':
+                factor = atof(optarg); // rate of a step over the one before
+                break;
+            case 's':
+                seconds = atoi(optarg); // length of a step
+                break;
+            case 'n':
+                size = atoi(optarg); // reply size, BUFLEN without
+                break;
+            case 'b':
+                batch = atoi(optarg); // datagrams per sendmmsg
+                break;
+            case 'c':
+                n_sds = atoi(optarg); // sockets, each its own source port
+                break;
+            case 'G':
+                gso = true; // batches as UDP_SEGMENT buffers
+                break;
+            default:
+                fprintf(stderr, USAGE, argv[0]);
+                exit(1);
+        }
+    }
+    if (argc - optind != 2 || rate < 1 || max_rate < rate || factor <= 1.0 || seconds < 1 ||
+            size < 0 || size > UDP_REPLY_MAX || batch < 1 || batch > UDP_BATCH || n_sds < 1) {
+        fprintf(stderr, USAGE, argv[0]);
+        exit(1);
+    }
+
+    bzero((char *) &server_addr, sizeof (struct sockaddr_in));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(atoi(argv[optind + 1]));
+    if ((hp = gethostbyname(argv[optind])) == NULL) {
+        fprintf(stderr, "Unknown server address\n");
+        exit(1);
+    }
+    bcopy(hp->h_addr, (char *) &server_addr.sin_addr, hp->h_length);
+
+    sds = malloc(n_sds * sizeof (int));
+    for (i = 0; i < n_sds; i++) {
+        if ((sds[i] = socket(AF_INET, SOCK_DGRAM, 0)) < 0)
+            SystemFatal("Cannot Create Socket!");
+        setsockopt(sds[i], SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof (rcvbuf));
+        if (connect(sds[i], (struct sockaddr *) &server_addr, sizeof (server_addr)) < 0)
+            SystemFatal("Can't connect to server");
+    }
+
+    /* every datagram of a batch is the same request */
+    len = size ? snprintf(request, sizeof (request), "request %d\n", size) :
+            snprintf(request, sizeof (request), "request\n");
+    bzero(tx, sizeof (tx));
+    for (i = 0; i < UDP_BATCH; i++) {
+        tx_iov[i].iov_base = request;
+        tx_iov[i].iov_len = len;
+        tx[i].msg_hdr.msg_iov = gso ? tx_iov : &tx_iov[i];
+        tx[i].msg_hdr.msg_iovlen = 1;
+    }
+    if (gso) {
+        tx[0].msg_hdr.msg_control = ctl;
+        tx[0].msg_hdr.msg_controllen = sizeof (ctl);
+        cm = CMSG_FIRSTHDR(&tx[0].msg_hdr);
+        cm->cmsg_level = SOL_UDP;
+        cm->cmsg_type = UDP_SEGMENT;
+        cm->cmsg_len = CMSG_LEN(sizeof (uint16_t));
+        *(uint16_t *) CMSG_DATA(cm) = len;
+    }
+
+    reply_len = (size ? size : BUFLEN) + 1;
+    if ((rx_bufs = malloc((size_t) UDP_BATCH * reply_len)) == NULL)
+        SystemFatal("malloc(): Failed");
+    bzero(rx, sizeof (rx));
+    for (i = 0; i < UDP_BATCH; i++) {
+        rx_iov[i].iov_base = rx_bufs + (size_t) i * reply_len;
+        rx_iov[i].iov_len = reply_len;
+        rx[i].msg_hdr.msg_iov = &rx_iov[i];
+        rx[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    fprintf(stdout, "[ %d byte replies, %d datagrams/%s, %d sockets\n",
+            size ? size : BUFLEN, batch, gso ? "UDP_SEGMENT" : "sendmmsg", n_sds);
+    for (; rate <= max_rate; rate = rate * factor > rate ? rate * factor : rate + 1) {
+        secs = run_step(sds, n_sds, tx, batch, rate, seconds, &st);
+        lost = st.n_tx ? 100.0 * ((double) st.n_tx - st.n_rx - st.n_busy) / st.n_tx : 0.0;
+        fprintf(stdout, "[ Rate %8lu/s: sent %10.0lf/s, received %10.0lf/s, "
+                "loss %6.2lf%%, %lu busy, %lu send errors\n", rate, st.n_tx / secs,
+                st.n_rx / secs, lost, st.n_busy, st.n_errors);
+        if (st.n_rx / secs > best)
+            best = st.n_rx / secs;
+    }
+    fprintf(stdout, "[ Max Received: %lu/s\n", best);
+
+    for (i = 0; i < n_sds; i++)
+        close(sds[i]);
+    free(sds);
+    free(rx_bufs);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * SystemFatal
+ *
+ * Displays a perror message and exits the program.
+ *
+ * @param message takes in a string message
+ */
+void SystemFatal(const char* message) {
+    perror(message);
+    exit(EXIT_FAILURE);
+}
@@ -0,0 +1,177 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		unix_sock.c - Unix domain stream sockets for servers and clients
+--
+--	FUNCTIONS:			socket, bind, listen, connect, lstat, unlink
+--
+--	DATE:				October 19, 2026
+--
+--	NOTES:
+--	A client on the same machine can reach a server through a Unix stream
+--	socket instead of TCP over loopback, which skips the TCP/IP stack: no
+--	segments, checksums, ACKs or congestion window, the data goes from one
+--	socket buffer to the other. A name that starts with '@' is in the
+--	abstract namespace, which leaves nothing in the file system and goes
+--	away with the socket; any other name is a path, which the server
+--	replaces when it starts and removes when it stops. Only a socket is
+--	ever removed, a server given the path of any other file fails to
+--	start. The clients take a name containing a '/' or starting with '@'
+--	in place of the host and ignore the port.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+#include <stddef.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/**
+ * unix_name
+ *
+ * @param name a host argument
+ * @return true if it names a Unix socket rather than a host
+ */
+bool unix_name(const char *name) {
+    return name[0] == '@' || strchr(name, '/') != NULL;
+}
+
+/**
+ * unix_addr
+ *
+ * @param name a path, or '@' and an abstract name
+ * @param sun receives the address
+ * @param len receives its length
+ * @return 0, -1 if the name does not fit
+ */
+static int unix_addr(const char *name, struct sockaddr_un *sun, socklen_t *len) {
+    size_t n = strlen(name);
+
+    if (n >= sizeof (sun->sun_path))
+        return -1;
+    bzero(sun, sizeof (*sun));
+    sun->sun_family = AF_UNIX;
+    memcpy(sun->sun_path, name, n);
+
+    /* an abstract name is its bytes after a leading NUL, not a string */
+    if (name[0] == '@') {
+        sun->sun_path[0] = '\0';
+        *len = offsetof(struct sockaddr_un, sun_path) + n;
+    } else {
+        *len = offsetof(struct sockaddr_un, sun_path) + n + 1;
+    }
+    return 0;
+}
+
+/**
+ * unix_stale
+ *
+ * Removes the socket file of a path name, and nothing else.
+ *
+ * @param name the socket's name
+ * @return 0 if nothing is left at the path, -1 with errno EADDRINUSE if a
+ * file other than a socket is
+ */
+static int unix_stale(const char *name) {
+    struct stat st;
+
+    if (name[0] == '@' || lstat(name, &st) < 0)
+        return 0;
+    if (!S_ISSOCK(st.st_mode)) {
+        errno = EADDRINUSE;
+        return -1;
+    }
+    return unlink(name);
+}
+
+/**
+ * unix_listen
+ *
+ * Creates a listening Unix stream socket. A stale socket file of an
+ * earlier run is removed first, any other file at the path is left alone
+ * and fails the call.
+ *
+ * @param name the socket's name
+ * @return the socket, -1 on failure
+ */
+int unix_listen(const char *name) {
+    struct sockaddr_un sun;
+    socklen_t len;
+    int sd;
+
+    if (unix_addr(name, &sun, &len) < 0) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if (unix_stale(name) < 0)
+        return -1;
+    if ((sd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        return -1;
+    if (bind(sd, (struct sockaddr *) &sun, len) < 0 || listen(sd, LISTENQ) < 0) {
+        close(sd);
+        return -1;
+    }
+    return sd;
+}
+
+/**
+ * unix_connect
+ *
+ * @param name the server's socket name
+ * @return the connected socket, -1 on failure
+ */
+int unix_connect(const char *name) {
+    struct sockaddr_un sun;
+    socklen_t len;
+    int sd;
+
+    if (unix_addr(name, &sun, &len) < 0) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if ((sd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        return -1;
+    if (connect(sd, (struct sockaddr *) &sun, len) < 0) {
+        close(sd);
+        return -1;
+    }
+    return sd;
+}
+
+/**
+ * unix_connect_start
+ *
+ * Starts connecting a non-blocking Unix stream socket, for a client that
+ * waits for the connection on epoll. A server with a full listen queue
+ * refuses the connection with EAGAIN instead of holding it, as TCP would,
+ * so that fails the call.
+ *
+ * @param name the server's socket name
+ * @return the non-blocking socket, -1 on failure
+ */
+int unix_connect_start(const char *name) {
+    struct sockaddr_un sun;
+    socklen_t len;
+    int sd;
+
+    if (unix_addr(name, &sun, &len) < 0) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if ((sd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0)) < 0)
+        return -1;
+    if (connect(sd, (struct sockaddr *) &sun, len) < 0 && errno != EINPROGRESS) {
+        close(sd);
+        return -1;
+    }
+    return sd;
+}
+
+/**
+ * unix_unlink
+ *
+ * Removes the socket file of a path name when the server stops.
+ *
+ * @param name the socket's name, NULL for none
+ */
+void unix_unlink(const char *name) {
+    if (name != NULL)
+        unix_stale(name);
+}
@@ -0,0 +1,380 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		workload.c - Seeded workload profiles for the client launcher
+--
+--	FUNCTIONS:			log, pow, sin
+--
+--	DATE:				October 19, 2026
+--
+--	NOTES:
+--	A profile describes the sessions clnt runs: when they arrive, how long
+--	they last, how fast they send requests and how large the replies are.
+--	It is read from a file of "key = value" lines, # starting a comment,
+--	and the same lines given with -p override it:
+--
+--	seed = 1               every random draw follows from it
+--	duration = 0           seconds of arrivals, 0 until stopped
+--	arrival = const 6.67   sessions per second over time:
+--	          ramp FROM TO SECONDS, step BEFORE AFTER AT_SECONDS,
+--	          sine MEAN AMPLITUDE PERIOD, or burst BASE PEAK GAP LENGTH,
+--	          bursts at PEAK of LENGTH seconds with GAP seconds between
+--	          them on average
+--	arrivals = fixed       evenly spaced at the rate, or poisson
+--	session = uniform 1 10 seconds: fixed S, uniform MIN MAX, exp MEAN
+--	          or pareto MIN ALPHA
+--	session_max = 0        cap of a session's length, 0 for none
+--	rate = 4               requests per second per session, which sends
+--	          its length times the rate; 0 unpaced, sending until its
+--	          length is up
+--	size = fixed 0         reply bytes of each request, drawn the same
+--	          way; 0 is the plain "request" of BUFLEN bytes
+--	payload = 1024         bytes of each request, NUL padded as tcp_clnt
+--	          -s pads them, up to WORKLOAD_PAYLOAD_MAX; 0 unpadded
+--
+--	The defaults are the sessions the launcher used to fork: one every
+--	150 ms lasting 1 to 10 seconds, each a tcp_clnt sending 4 requests a
+--	second. The arrivals draw from one random stream and every session
+--	from its own, seeded by its number, so the same seed gives the same
+--	sessions with the same requests however fast the server answers.
+---------------------------------------------------------------------------------------*/
+
+#include "common.h"
+#include <math.h>
+
+static const char *dist_names[] = {"fixed", "uniform", "exp", "pareto"};
+static const char *curve_names[] = {"const", "ramp", "step", "sine", "burst"};
+static const int curve_args[] = {1, 3, 3, 3, 4};
+
+/**
+ * workload_init
+ *
+ * Sets the default profile.
+ *
+ * @param wl the profile
+ */
+void workload_init(workload *wl) {
+    bzero(wl, sizeof (workload));
+    wl->seed = 1;
+    wl->curve = CURVE_CONST;
+    wl->c[0] = 1 / 0.15;
+    wl->session.kind = DIST_UNIFORM;
+    wl->session.a = 1;
+    wl->session.b = 10;
+    wl->rate = 4;
+    wl->size.kind = DIST_FIXED;
+    wl->payload = BUFLEN;
+}
+
+/**
+ * workload_seed
+ *
+ * @param seed a seed
+ * @param n a stream number
+ * @return the state of the n-th random stream of the seed (splitmix64)
+ */
+uint64_t workload_seed(uint64_t seed, uint64_t n) {
+    uint64_t z = seed + (n + 1) * 0x9E3779B97F4A7C15ULL;
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return z != 0 ? z : 1;
+}
+
+/**
+ * workload_uniform
+ *
+ * @param rng a random stream (xorshift64*)
+ * @return a draw in (0, 1]
+ */
+double workload_uniform(uint64_t *rng) {
+    *rng ^= *rng >> 12;
+    *rng ^= *rng << 25;
+    *rng ^= *rng >> 27;
+    return (((*rng * 0x2545F4914F6CDD1DULL) >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * dist_sample
+ *
+ * @param d a distribution
+ * @param rng the random stream to draw from
+ * @return a draw
+ */
+double dist_sample(const dist *d, uint64_t *rng) {
+    switch (d->kind) {
+        case DIST_UNIFORM:
+            return d->a + (d->b - d->a) * workload_uniform(rng);
+        case DIST_EXP:
+            return -d->a * log(workload_uniform(rng));
+        case DIST_PARETO:
+            return d->a / pow(workload_uniform(rng), 1 / d->b);
+        default:
+            return d->a;
+    }
+}
+
+/**
+ * workload_rate
+ *
+ * @param wl the profile
+ * @param t seconds since the start
+ * @return the arrival rate at t in sessions per second
+ */
+double workload_rate(workload *wl, double t) {
+    double *c = wl->c, r;
+
+    switch (wl->curve) {
+        case CURVE_RAMP:
+            return t >= c[2] ? c[1] : c[0] + (c[1] - c[0]) * t / c[2];
+        case CURVE_STEP:
+            return t < c[2] ? c[0] : c[1];
+        case CURVE_SINE:
+            r = c[0] + c[1] * sin(2 * M_PI * t / c[2]);
+            return r > 0 ? r : 0;
+        case CURVE_BURST:
+            /* the gaps between bursts are exponential, the bursts a
+             * Poisson process of their own */
+            while (t >= wl->burst_end) {
+                wl->burst_start = wl->burst_end - c[2] * log(workload_uniform(&wl->rng));
+                wl->burst_end = wl->burst_start + c[3];
+            }
+            return t >= wl->burst_start ? c[1] : c[0];
+        default:
+            return c[0];
+    }
+}
+
+/**
+ * workload_peak
+ *
+ * @param wl the profile
+ * @return the highest rate of its curve
+ */
+static double workload_peak(const workload *wl) {
+    const double *c = wl->c;
+
+    switch (wl->curve) {
+        case CURVE_RAMP:
+        case CURVE_STEP:
+        case CURVE_BURST:
+            return c[0] > c[1] ? c[0] : c[1];
+        case CURVE_SINE:
+            return c[0] + fabs(c[1]);
+        default:
+            return c[0];
+    }
+}
+
+/**
+ * workload_start
+ *
+ * Starts the arrivals at time 0.
+ *
+ * @param wl the profile
+ */
+void workload_start(workload *wl) {
+    wl->rng = workload_seed(wl->seed, 0);
+    wl->t = 0;
+    wl->burst_start = wl->burst_end = 0;
+}
+
+/**
+ * workload_next_arrival
+ *
+ * Draws the time of the next session. Poisson arrivals follow the curve
+ * by thinning: candidates come at its peak rate and each is kept with
+ * the ratio of the rate at its time to the peak.
+ *
+ * @param wl the profile
+ * @return seconds since the start, or a negative number if no session
+ * will ever arrive
+ */
+double workload_next_arrival(workload *wl) {
+    double peak = workload_peak(wl), r;
+
+    if (peak <= 0)
+        return -1;
+    for (;;) {
+        if (wl->poisson) {
+            wl->t -= log(workload_uniform(&wl->rng)) / peak;
+            if (workload_uniform(&wl->rng) * peak <= workload_rate(wl, wl->t))
+                return wl->t;
+        } else if ((r = workload_rate(wl, wl->t)) > 0) {
+            wl->t += 1 / r;
+            return wl->t;
+        } else {
+            /* wait out a stretch of the curve without arrivals */
+            wl->t += 0.01;
+        }
+        if (wl->duration > 0 && wl->t >= wl->duration)
+            return wl->t;
+    }
+}
+
+/**
+ * dist_parse
+ *
+ * @param d receives the distribution, unchanged if the value is malformed
+ * @param v "fixed X", "uniform MIN MAX", "exp MEAN" or "pareto MIN ALPHA"
+ * @return 0, -1 if malformed
+ */
+static int dist_parse(dist *d, const char *v) {
+    char name[16];
+    double a, b = 0;
+    int i, n;
+
+    n = sscanf(v, "%15s %lf %lf", name, &a, &b);
+    for (i = DIST_FIXED; i <= DIST_PARETO; i++) {
+        if (n >= 2 && strcmp(name, dist_names[i]) == 0)
+            break;
+    }
+    if (i > DIST_PARETO || a < 0 || ((i == DIST_UNIFORM || i == DIST_PARETO) && n != 3) ||
+            (i == DIST_UNIFORM && b < a) || (i == DIST_PARETO && (a <= 0 || b <= 0)))
+        return -1;
+    d->kind = i;
+    d->a = a;
+    d->b = b;
+    return 0;
+}
+
+/**
+ * workload_set
+ *
+ * Sets one key of a profile. A malformed value leaves the profile as it
+ * was.
+ *
+ * @param wl the profile
+ * @param line "key = value" or "key=value"
+ * @return 0, -1 for an unknown key or a malformed value
+ */
+int workload_set(workload *wl, const char *line) {
+    char key[32], name[16];
+    const char *v;
+    double x, c[4] = {0};
+    uint64_t seed;
+    int i, n;
+
+    if ((v = strchr(line, '=')) == NULL || sscanf(line, " %31[a-z_]", key) != 1)
+        return -1;
+    for (v++; *v == ' ' || *v == '\t'; v++)
+        ;
+
+    if (strcmp(key, "seed") == 0) {
+        if (sscanf(v, "%lu", &seed) != 1)
+            return -1;
+        wl->seed = seed;
+        return 0;
+    }
+    if (strcmp(key, "duration") == 0) {
+        if (sscanf(v, "%lf", &x) != 1 || x < 0)
+            return -1;
+        wl->duration = x;
+        return 0;
+    }
+    if (strcmp(key, "session_max") == 0) {
+        if (sscanf(v, "%lf", &x) != 1 || x < 0)
+            return -1;
+        wl->session_max = x;
+        return 0;
+    }
+    if (strcmp(key, "rate") == 0) {
+        if (sscanf(v, "%lf", &x) != 1 || x < 0)
+            return -1;
+        wl->rate = x;
+        return 0;
+    }
+    if (strcmp(key, "session") == 0)
+        return dist_parse(&wl->session, v);
+    if (strcmp(key, "size") == 0)
+        return dist_parse(&wl->size, v);
+    if (strcmp(key, "payload") == 0) {
+        if (sscanf(v, "%d", &n) != 1 || n < 0 || n > WORKLOAD_PAYLOAD_MAX)
+            return -1;
+        wl->payload = n;
+        return 0;
+    }
+    if (strcmp(key, "arrivals") == 0) {
+        if (strncmp(v, "poisson", 7) != 0 && strncmp(v, "fixed", 5) != 0)
+            return -1;
+        wl->poisson = v[0] == 'p';
+        return 0;
+    }
+    if (strcmp(key, "arrival") == 0) {
+        n = sscanf(v, "%15s %lf %lf %lf %lf", name, &c[0], &c[1], &c[2], &c[3]);
+        for (i = CURVE_CONST; i <= CURVE_BURST; i++) {
+            if (n >= 1 && strcmp(name, curve_names[i]) == 0)
+                break;
+        }
+        if (i > CURVE_BURST || n != curve_args[i] + 1 || c[0] < 0 ||
+                (i != CURVE_CONST && i != CURVE_SINE && c[1] < 0) ||
+                (i != CURVE_CONST && i != CURVE_STEP && c[2] <= 0) ||
+                (i == CURVE_BURST && c[3] <= 0))
+            return -1;
+        wl->curve = i;
+        memcpy(wl->c, c, sizeof (c));
+        return 0;
+    }
+    return -1;
+}
+
+/**
+ * workload_load
+ *
+ * Reads a profile file.
+ *
+ * @param wl the profile
+ * @param path the file
+ * @return 0, the number of the first malformed line, or -1 if the file
+ * cannot be read
+ */
+int workload_load(workload *wl, const char *path) {
+    char line[256], *p;
+    int n = 0;
+    FILE *f;
+
+    if ((f = fopen(path, "r")) == NULL)
+        return -1;
+    while (fgets(line, sizeof (line), f) != NULL) {
+        n++;
+        if ((p = strchr(line, '#')) != NULL)
+            *p = '\0';
+        for (p = line; *p == ' ' || *p == '\t'; p++)
+            ;
+        if (*p == '\n' || *p == '\0')
+            continue;
+        if (workload_set(wl, p) < 0) {
+            fclose(f);
+            return n;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+/**
+ * workload_print
+ *
+ * Prints a profile in the form it is read in, so a run can be repeated.
+ *
+ * @param wl the profile
+ * @param f where to
+ */
+void workload_print(const workload *wl, FILE *f) {
+    const dist *d[] = {&wl->session, &wl->size};
+    const char *keys[] = {"session", "size"};
+    int i, j;
+
+    fprintf(f, "seed = %lu\nduration = %g\narrival = %s", wl->seed, wl->duration,
+            curve_names[wl->curve]);
+    for (j = 0; j < curve_args[wl->curve]; j++)
+        fprintf(f, " %g", wl->c[j]);
+    fprintf(f, "\narrivals = %s\n", wl->poisson ? "poisson" : "fixed");
+    for (i = 0; i < 2; i++) {
+        fprintf(f, "%s = %s %g", keys[i], dist_names[d[i]->kind], d[i]->a);
+        if (d[i]->kind == DIST_UNIFORM || d[i]->kind == DIST_PARETO)
+            fprintf(f, " %g", d[i]->b);
+        fprintf(f, "\n");
+    }
+    fprintf(f, "session_max = %g\nrate = %g\npayload = %d\n", wl->session_max, wl->rate,
+            wl->payload);
+}